@@ -73,6 +73,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "global.h"
 #include "scanner.h"
 #include "line.h"
@@ -80,31 +81,71 @@
 #include "symbol.h"
 #include "code.h"
 #include "strtab.h"
+#include "batch.h"
+#include "daemon.h"
+#include "cache.h"
+#include "vm.h"
+#include "object.h"
+#include "peephole.h"
+#include "context.h"
+#include "sink.h"
+#include "compiler.h"
+#include "stats.h"
+#include "split.h"
+#include "tokarray.h"
 
 /*--------------------------------------------------------------------------*/
 /*                                                                          */
-/*  Global variables used by this compiler.                                 */
+/*  Parser state.  The files, the tokens ahead (see "tokarray.h"), the      */
+/*  error recovery sets, the scope and the next variable address are all    */
+/*  held in the CONTEXT which is passed to every routine (see "context.h"), */
+/*  so that independent compilations can share one process.                 */
 /*                                                                          */
 /*--------------------------------------------------------------------------*/
 
-PRIVATE FILE *InputFile;    /*  CPL source comes from here.          */
-PRIVATE FILE *ListFile;     /*  For nicely-formatted syntax errors.  */
-PRIVATE FILE *CodeFile;     /* File for the assembly code*/
-PRIVATE TOKEN CurrentToken; /*  Parser lookahead token.  Updated by  */
-                            /*  routine Accept (below).  Must be     */
-                            /*  initialised before parser starts.    */
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  PARSER_LOOKAHEAD: how far past the current token the parser Peeks.      */
+/*  None: the grammar is LL(1), so every choice is made on the current      */
+/*  token.  An identifier starting a statement, for one, is looked up and   */
+/*  accepted first, and the token after it then tells an assignment from a  */
+/*  procedure call, before any code for either is emitted.  Looking further */
+/*  would gain nothing, and would make every parse defer its listing (see   */
+/*  "tokarray.h").                                                          */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+#define PARSER_LOOKAHEAD 0
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  COMP_BUILD_ID: names this build of the compiler in the keys of the      */
+/*  compile cache (see "CachedResult").  The Makefile passes a checksum of  */
+/*  every source file; a build without it falls back on when Compiler.c     */
+/*  was compiled, which misses changes to the other modules.                */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
 
-PRIVATE SET StatementFS_aug;
-PRIVATE SET StatementFBS;
-PRIVATE SET DeclarationFS_aug;
-PRIVATE SET ProcDeclarationFS_aug;
-PRIVATE SET ProcDeclarationFBS;
+#ifndef COMP_BUILD_ID
+#define COMP_BUILD_ID __DATE__ " " __TIME__
+#endif
 
-PRIVATE int ErrorFlag;
-PRIVATE int scope;
-PRIVATE int varaddress;
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  PARTSTATE: the parse of one part of a split source (see "split.h" and   */
+/*             "ParseInParallel").                                          */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
 
-PRIVATE int scope; /*Variable to track the scope value of input code */
+typedef struct
+{
+    CONTEXT *ctx;   /* its own, with no messages               */
+    SINK listing;   /* of the part, to go into the whole one   */
+    SINK code;      /* not written, but InitCodeGenerator's    */
+    int base;       /* variable address the part starts at     */
+    int *addresses; /* of its outer procedures, within it      */
+    int valid;      /* parsed as it would be in the whole      */
+} PARTSTATE;
 
 /*--------------------------------------------------------------------------*/
 /*                                                                          */
@@ -112,63 +153,210 @@ PRIVATE int scope; /*Variable to track the scope value of input code */
 /*                                                                          */
 /*--------------------------------------------------------------------------*/
 
-PRIVATE int OpenFiles(int argc, char *argv[]);
-PRIVATE void ParseProgram(void);
-PRIVATE void ParseDeclarations(int loc_flag);
-PRIVATE void ParseProcDeclarations(void);
-PRIVATE void ParseParameterList(void);
-PRIVATE void ParseFormalParameter(void);
-PRIVATE void ParseBlock(void);
-PRIVATE void ParseStatement(void);
-PRIVATE void ParseSimpleStatement(void);
-PRIVATE void ParseRestofStatement(SYMBOL *target);
-PRIVATE void ParseProcCallList(SYMBOL *target);
-PRIVATE void ParseAssignment(void);
-PRIVATE void ParseActualParameter(int isRef_flag);
-PRIVATE void ParseWhileStatement(void);
-PRIVATE void ParseIfStatement(void);
-PRIVATE void ParseReadStatement(void);
-PRIVATE void ParseWriteStatement(void);
-PRIVATE void ParseExpression(void);
-PRIVATE void ParseCompoundTerm(void);
-PRIVATE void ParseTerm(void);
-PRIVATE void ParseSubTerm(void);
-PRIVATE void ParseBooleanExpression(void);
-PRIVATE void ParseRelOp(void);
-PRIVATE void ParseVariable(void);
-PRIVATE void ParseVarOrProcName(void);
-PRIVATE void Accept(int code);
+PRIVATE int OpenFiles(CONTEXT *ctx, int argc, char *argv[]);
+PRIVATE void Compile(CONTEXT *ctx, int optimise, int stream, int threads, int pipelined,
+                     COMPILESTATS *stats);
+PRIVATE void ReportCompileStats(COMPILESTATS *stats, char *name, char *jsonname);
+PRIVATE void Translate(CONTEXT *ctx, SINK *code, int optimise, int stream, int threads, int pipelined);
+PRIVATE int ParseInParallel(CONTEXT *ctx, int threads);
+PRIVATE void ParsePart(SOURCESPLIT *split, int part);
+PRIVATE void EnterOuterSymbols(CONTEXT *ctx, SOURCESPLIT *split, int part);
+PRIVATE void LinkParts(CONTEXT *ctx, SOURCESPLIT *split);
+PRIVATE int CompileUnit(BATCHUNIT *unit);
+PRIVATE int CompileRequest(DAEMONREQUEST *request);
+PRIVATE int CachedResult(COMPILECACHE *cache, char *argv[], int optimise);
+PRIVATE void RunProgram(CONTEXT *ctx);
+PRIVATE void WriteObject(CONTEXT *ctx, char *filename);
+PRIVATE void ParseProgram(CONTEXT *ctx);
+PRIVATE void ParseProgramHeading(CONTEXT *ctx);
+PRIVATE int ParseOuterProcedures(CONTEXT *ctx, int *addresses, int max);
+PRIVATE void ParseDeclarations(CONTEXT *ctx, int loc_flag);
+PRIVATE void ParseProcDeclarations(CONTEXT *ctx);
+PRIVATE void ParseParameterList(CONTEXT *ctx);
+PRIVATE void ParseFormalParameter(CONTEXT *ctx);
+PRIVATE void ParseBlock(CONTEXT *ctx);
+PRIVATE void ParseStatement(CONTEXT *ctx);
+PRIVATE void ParseSimpleStatement(CONTEXT *ctx);
+PRIVATE void ParseRestofStatement(CONTEXT *ctx, SYMBOL *target);
+PRIVATE void ParseProcCallList(CONTEXT *ctx, SYMBOL *target);
+PRIVATE void ParseAssignment(CONTEXT *ctx);
+PRIVATE void ParseActualParameter(CONTEXT *ctx, int isRef_flag);
+PRIVATE void ParseWhileStatement(CONTEXT *ctx);
+PRIVATE void ParseIfStatement(CONTEXT *ctx);
+PRIVATE void ParseReadStatement(CONTEXT *ctx);
+PRIVATE void ParseWriteStatement(CONTEXT *ctx);
+PRIVATE int ParseExpression(CONTEXT *ctx);
+PRIVATE int ParseCompoundTerm(CONTEXT *ctx);
+PRIVATE int ParseTerm(CONTEXT *ctx);
+PRIVATE int ParseSubTerm(CONTEXT *ctx);
+PRIVATE void ParseBooleanExpression(CONTEXT *ctx);
+PRIVATE void ParseRelOp(CONTEXT *ctx);
+PRIVATE void ParseVariable(CONTEXT *ctx);
+PRIVATE void ParseVarOrProcName(CONTEXT *ctx);
+PRIVATE int FoldOperation(CONTEXT *ctx, int opcode, int pos);
+PRIVATE void EmitOuterAccess(CONTEXT *ctx, int opcode, SYMBOL *var);
+PRIVATE void Accept(CONTEXT *ctx, int code);
+PRIVATE void NextToken(CONTEXT *ctx);
+PRIVATE void SkipTokens(CONTEXT *ctx, SET *S);
 /* Implements augmented S-Algol */
-PRIVATE void Synchronise(SET *F, SET *FB);
-PRIVATE void SetupSets(void);
-PRIVATE SYMBOL *MakeSymbolTableEntry(int symtype, int *varaddress);
-PRIVATE SYMBOL *LookupSymbol(void);
+PRIVATE void Synchronise(CONTEXT *ctx, SET *F, SET *S);
+PRIVATE void SetupSets(CONTEXT *ctx);
+PRIVATE SYMBOL *MakeSymbolTableEntry(CONTEXT *ctx, int symtype, int *varaddress);
+PRIVATE SYMBOL *LookupSymbol(CONTEXT *ctx);
 /*
 PRIVATE void ReadToEndOfFile(void);
 */
 
 /*--------------------------------------------------------------------------*/
 /*                                                                          */
-/*  Main: Smallparser entry point.  Sets up parser globals (opens input and */
-/*        output files, initialises current lookahead), then calls          */
-/*        "ParseProgram" to start the parse.                                */
+/*  Main: Smallparser entry point.  Creates a CONTEXT and sets up the       */
+/*        parser state in it (opens input and output files, initialises     */
+/*        current lookahead), then calls "ParseProgram" to start the parse. */
+/*        "comp -b ..." compiles a whole batch instead (see "batch.h"), and */
+/*        "comp -d ..." runs a compile server (see "daemon.h").             */
+/*        Before the file names, "-r" runs the program on the VM after      */
+/*        compiling it, "-o <objectfile>" also writes the code as a         */
+/*        binary object file (see "object.h") and "-O" runs the peephole    */
+/*        optimiser over the code before it is written (see "peephole.h").  */
+/*        "-s" streams the code file, writing each part of the code as soon */
+/*        as it is final; it is ignored with "-r", "-o" or "-O", which need */
+/*        the whole program in the code table.                              */
+/*        "-c[<megabytes>] <cachedir>" takes the listing and code from the  */
+/*        compile cache in <cachedir> if this source has been compiled      */
+/*        before (see "cache.h"), and enters them there if not; it is       */
+/*        ignored with "-r" or "-o".                                        */
+/*        "--stats" reports the time spent scanning, parsing, on symbol     */
+/*        operations and writing code, with the work done in each, on       */
+/*        stderr (see "stats.h"); "--stats=<jsonfile>" also appends them    */
+/*        to <jsonfile> as a line of JSON.                                  */
+/*        "-j[<threads>]" parses the outer procedures of a large source on  */
+/*        that many threads (one per core if no number is given), with the  */
+/*        same listing and code as a parse on one (see "ParseInParallel").  */
+/*        "-p" scans on a thread of its own, which passes the tokens to the */
+/*        parser through a ring (see "tokpipe.h"); the listing and code are */
+/*        the same.  With "-j" it applies if the source is not split.       */
 /*                                                                          */
 /*--------------------------------------------------------------------------*/
 
 PUBLIC int main(int argc, char *argv[])
 {
-    ErrorFlag = 0;
-    if (OpenFiles(argc, argv))
-    {
-        InitCharProcessor(InputFile, ListFile);
-        InitCodeGenerator(CodeFile);
-        SetupSets();
-        CurrentToken = GetToken();
-        ParseProgram();
-        WriteCodeFile();
-        fclose(InputFile);
-        fclose(ListFile);
-        if (ErrorFlag == 0)
+    CONTEXT *ctx;
+    COMPILECACHE *cache = NULL;
+    COMPILESTATS stats;
+    char *objname = NULL;
+    char *statsname = NULL;
+    char *cachename = NULL;
+    long cachelimit = 0;
+    clock_t start;
+    int status = EXIT_FAILURE;
+    int run = 0;
+    int optimise = 0;
+    int stream = 0;
+    int measure = 0;
+    int threads = 0;
+    int pipelined = 0;
+
+    if (argc > 1 && 0 == strcmp(argv[1], "-b"))
+    {
+        return CompileBatch(argc, argv, CompileUnit);
+    }
+    if (argc > 1 && 0 == strcmp(argv[1], "-d"))
+    {
+        return RunDaemon(argc, argv, CompileRequest);
+    }
+    for (;;)
+    {
+        if (argc > 1 && 0 == strcmp(argv[1], "-r"))
+        {
+            run = 1;
+            argv[1] = argv[0];
+            argc--;
+            argv++;
+        }
+        else if (argc > 1 && 0 == strcmp(argv[1], "-O"))
+        {
+            optimise = 1;
+            argv[1] = argv[0];
+            argc--;
+            argv++;
+        }
+        else if (argc > 1 && 0 == strcmp(argv[1], "-s"))
+        {
+            stream = 1;
+            argv[1] = argv[0];
+            argc--;
+            argv++;
+        }
+        else if (argc > 2 && 0 == strcmp(argv[1], "-o"))
+        {
+            objname = argv[2];
+            argv[2] = argv[0];
+            argc -= 2;
+            argv += 2;
+        }
+        else if (argc > 2 && 0 == strncmp(argv[1], "-c", 2))
+        {
+            cachename = argv[2];
+            cachelimit = atol(argv[1] + 2);
+            argv[2] = argv[0];
+            argc -= 2;
+            argv += 2;
+        }
+        else if (argc > 1 && 0 == strcmp(argv[1], "-p"))
+        {
+            pipelined = 1;
+            argv[1] = argv[0];
+            argc--;
+            argv++;
+        }
+        else if (argc > 1 && 0 == strncmp(argv[1], "-j", 2))
+        {
+            threads = ThreadCount(atoi(argv[1] + 2));
+            argv[1] = argv[0];
+            argc--;
+            argv++;
+        }
+        else if (argc > 1 && 0 == strncmp(argv[1], "--stats", 7) && (argv[1][7] == '\0' || argv[1][7] == '='))
+        {
+            measure = 1;
+            statsname = argv[1][7] == '=' ? argv[1] + 8 : NULL;
+            argv[1] = argv[0];
+            argc--;
+            argv++;
+        }
+        else
+            break;
+    }
+    if (stream && (run || objname != NULL || optimise))
+    {
+        fprintf(stderr, "Note: -s ignored, as %s needs the whole program in memory\n",
+                run ? "-r" : objname != NULL ? "-o" : "-O");
+        stream = 0;
+    }
+    if (cachename != NULL && !run && objname == NULL && argc == 4)
+    {
+        if (NULL == (cache = OpenCache(cachename, cachelimit)))
+        {
+            return EXIT_FAILURE;
+        }
+        if (CachedResult(cache, argv, optimise))
+        {
+            CloseCache(cache);
+            return EXIT_SUCCESS;
+        }
+    }
+    ctx = MakeCompilerContext();
+    ctx->ErrorFlag = 0;
+    if (OpenFiles(ctx, argc, argv))
+    {
+        start = clock();
+        Compile(ctx, optimise, stream, threads, pipelined, measure ? &stats : NULL);
+        if (cache != NULL)
+        {
+            CacheStore(cache, argv[2], argv[3], ctx->ErrorFlag == 0,
+                       (double)(clock() - start) / CLOCKS_PER_SEC);
+        }
+        if (ctx->ErrorFlag == 0)
         {
             printf("Valid syntax\n");
         }
@@ -176,10 +364,591 @@ PUBLIC int main(int argc, char *argv[])
         {
             printf("SYNTAX INVALID\n");
         }
-        return EXIT_SUCCESS;
+        if (cache != NULL)
+        {
+            fflush(stdout);
+            ReportCache(cache, stderr);
+        }
+        if (measure)
+        {
+            ReportCompileStats(&stats, argv[1], statsname);
+        }
+        if (objname != NULL)
+        {
+            WriteObject(ctx, objname);
+        }
+        if (run && ctx->ErrorFlag == 0)
+        {
+            RunProgram(ctx);
+        }
+        status = EXIT_SUCCESS;
+    }
+    FreeContext(ctx);
+    CloseCache(cache);
+    return status;
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  CachedResult: look up "comp <inputfile> <listfile> <CodeFile>" in the   */
+/*                compile cache.  On a hit the listing and code file have   */
+/*                been written, so report the result as Compile would have  */
+/*                and return 1.  The key covers the source, this build of   */
+/*                the compiler and "-O", the only option that changes the   */
+/*                output.                                                   */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE int CachedResult(COMPILECACHE *cache, char *argv[], int optimise)
+{
+    char options[64];
+    int valid;
+
+    sprintf(options, "comp %s%s", COMP_BUILD_ID, optimise ? " -O" : "");
+    if (!CacheLookup(cache, argv[1], options, argv[2], argv[3], &valid))
+    {
+        return 0;
+    }
+    if (valid)
+    {
+        printf("Valid syntax\n");
+    }
+    else
+    {
+        printf("SYNTAX INVALID\n");
+    }
+    fflush(stdout);
+    ReportCache(cache, stderr);
+    return 1;
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  ReportCompileStats: report the statistics of the compilation of "name"  */
+/*                      on stderr, after the status line, and append them   */
+/*                      to "jsonname" as JSON unless it is NULL.            */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void ReportCompileStats(COMPILESTATS *stats, char *name, char *jsonname)
+{
+    FILE *fp;
+
+    fflush(stdout);
+    ReportStats(stats, name, stderr);
+    if (jsonname == NULL)
+    {
+        return;
+    }
+    if (NULL == (fp = fopen(jsonname, "a")))
+    {
+        fprintf(stderr, "cannot open \"%s\" for output\n", jsonname);
+        return;
+    }
+    WriteStatsJSON(stats, name, fp);
+    fclose(fp);
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  Compile: parse the open input file of "ctx", writing the listing and    */
+/*           the code file, then close all three files.  The caller finds   */
+/*           out whether there were errors from "ctx->ErrorFlag".  If       */
+/*           "optimise" is set the code is put through "Peephole" first     */
+/*           and the number of instructions it removed reported on stderr.  */
+/*           If "stream" is set the code file is written as the parse goes  */
+/*           (see "FlushCode"), and the code table is not left holding the  */
+/*           program.  If "threads" is more than one a large source is      */
+/*           parsed on that many threads.  If "pipelined" is set the        */
+/*           scanner runs on a thread of its own (see "tokpipe.h").  If     */
+/*           "stats" is not NULL the compilation is measured into it (see   */
+/*           "stats.h").                                                    */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void Compile(CONTEXT *ctx, int optimise, int stream, int threads, int pipelined,
+                     COMPILESTATS *stats)
+{
+    SINK listing, code;
+
+    if (stats != NULL)
+    {
+        StartStats(ctx, stats);
+    }
+    InitFileSink(&listing, ctx->ListFile);
+    InitFileSink(&code, ctx->CodeFile);
+    InitCharProcessor(ctx, ctx->InputFile, &listing);
+    Translate(ctx, &code, optimise, stream, threads, pipelined);
+    fclose(ctx->InputFile);
+    fclose(ctx->ListFile);
+    fclose(ctx->CodeFile);
+    if (stats != NULL)
+    {
+        StopStats(ctx, stats);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  MakeCompilerContext: a new CONTEXT (see "MakeContext") with the error   */
+/*                       recovery sets formed, once, by SetupSets.  They    */
+/*                       survive ResetContext, so a CONTEXT used for one    */
+/*                       compilation after another keeps them.              */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PUBLIC CONTEXT *MakeCompilerContext(void)
+{
+    CONTEXT *ctx = MakeContext();
+
+    SetupSets(ctx);
+    return ctx;
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  CompileBuffer: compile the "length" bytes of source at "source"         */
+/*                 without touching the file system, writing the listing    */
+/*                 to "listing" (NULL for none) and the code to "code".     */
+/*                 "ctx" comes from MakeCompilerContext and may be used     */
+/*                 again for the next compilation.  Messages go only to     */
+/*                 "listing", not to stdout or stderr.  Returns 1 if the    */
+/*                 program is valid, 0 if it had errors.                    */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PUBLIC int CompileBuffer(CONTEXT *ctx, const char *source, size_t length, SINK *listing, SINK *code)
+{
+    ResetContext(ctx);
+    ctx->quiet = 1;
+    InitCharBuffer(ctx, source, length, listing);
+    Translate(ctx, code, 0, 0, 0, 0);
+    if (listing != NULL)
+    {
+        FlushSink(listing);
+    }
+    return ctx->ErrorFlag == 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  Translate: parse the source the character processor of "ctx" has been   */
+/*             given and write the code to "code", as set out for Compile.  */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void Translate(CONTEXT *ctx, SINK *code, int optimise, int stream, int threads, int pipelined)
+{
+    int before, removed;
+
+    InitCodeGenerator(ctx, code);
+    if (stream)
+    {
+        StreamCode(ctx);
+    }
+    ctx->phase = PHASE_PARSE;
+    if (threads < 2 || !ParseInParallel(ctx, threads))
+    {
+        StartTokens(ctx, PARSER_LOOKAHEAD, pipelined);
+        NextToken(ctx);
+        ParseProgram(ctx);
+        StopTokens(ctx);
+    }
+    ctx->phase = PHASE_OTHER;
+    if (optimise && !CodeGenerationKilled(ctx))
+    {
+        before = CurrentCodeAddress(ctx);
+        removed = Peephole(ctx);
+        fprintf(stderr, "Peephole: %d of %d instructions removed\n", removed, before);
+    }
+    WriteCodeFile(ctx);
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  ParseInParallel: parse the source of "ctx" in parts, on "threads"       */
+/*                   threads, and leave "ctx" as ParseProgram would have:   */
+/*                   the code in its code table, the outer symbols in its   */
+/*                   symbol table and the listing written.  Returns 0,      */
+/*                   having written nothing, if the source could not be     */
+/*                   split (see "SplitSource") or the parts did not parse   */
+/*                   as they would in the whole, and it must be parsed the  */
+/*                   usual way.                                             */
+/*                                                                          */
+/*                   Part 0, the heading, the globals and the first outer   */
+/*                   procedure, is parsed first; its symbols are entered    */
+/*                   into each of the other parts, with the names of the    */
+/*                   outer procedures before the part, which all are then   */
+/*                   parsed at once.  Each part's code starts at address 0, */
+/*                   and a call to an outer procedure of an earlier part is */
+/*                   to address -1 - <its index>.  The pre-scan's count of  */
+/*                   the variables of each part gives the address its       */
+/*                   variables start at, as "varaddress" is not reset from  */
+/*                   one procedure to the next.  A part is only taken if it */
+/*                   parsed with no errors or messages, declared exactly    */
+/*                   the outer procedures and variables the pre-scan found, */
+/*                   and ended at the end of its text; the parse of the     */
+/*                   whole would then have been the same, so the listing    */
+/*                   and, once linked, the code are too.  A program with    */
+/*                   errors is always parsed again the usual way, which     */
+/*                   reports them.                                          */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE int ParseInParallel(CONTEXT *ctx, int threads)
+{
+    SOURCESPLIT split;
+    PARTSTATE *parts;
+    const char *source;
+    size_t length;
+    int base, valid, k;
+
+    source = GetSource(ctx, &length);
+    if (LongLines(ctx) || !SplitSource(source, length, threads, &split))
+    {
+        return 0;
+    }
+    if (NULL == (parts = calloc(split.Count, sizeof(PARTSTATE))))
+    {
+        fprintf(stderr, "Fatal Error: ParseInParallel: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (k = 0; k < split.Count; k++)
+    {
+        split.Parts[k].State = &parts[k];
+    }
+    split.State = ctx;
+    ParsePart(&split, 0);
+    if ((valid = parts[0].valid))
+    {
+        base = parts[0].ctx->varaddress;
+        for (k = 1; k < split.Count; k++)
+        {
+            parts[k].base = base;
+            base += split.Parts[k].Variables;
+        }
+        ParseParts(&split, 1, threads, ParsePart);
+        for (k = 1; k < split.Count; k++)
+        {
+            valid = valid && parts[k].valid;
+        }
+    }
+    if (valid)
+    {
+        LinkParts(ctx, &split);
+    }
+    for (k = 0; k < split.Count; k++)
+    {
+        if (parts[k].ctx != NULL)
+        {
+            FreeContext(parts[k].ctx);
+            FreeSink(&parts[k].listing);
+            FreeSink(&parts[k].code);
+        }
+        free(parts[k].addresses);
+    }
+    free(parts);
+    FreeSplit(&split);
+    return valid;
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  ParsePart: the PARTPARSER for ParseInParallel.  Parses part "part" of   */
+/*             "split" in a CONTEXT of its own, and decides whether it is   */
+/*             valid.                                                       */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void ParsePart(SOURCESPLIT *split, int part)
+{
+    SOURCEPART *p = &split->Parts[part];
+    PARTSTATE *state = p->State;
+    CONTEXT *ctx;
+    LINESTATS lines;
+    SYMBOL *sptr;
+    int count = 0, k;
+
+    state->ctx = ctx = MakeCompilerContext();
+    ctx->speculative = 1;
+    InitBufferSink(&state->listing);
+    InitBufferSink(&state->code);
+    InitCharBuffer(ctx, p->Start, p->Length, &state->listing);
+    SetLineNumber(ctx, p->FirstLine);
+    SetTabWidth(ctx, GetTabWidth(split->State));
+    InitCodeGenerator(ctx, &state->code);
+    StartTokens(ctx, PARSER_LOOKAHEAD, 0);
+    if (NULL == (state->addresses = malloc((p->Procedures + 1) * sizeof(int))))
+    {
+        fprintf(stderr, "Fatal Error: ParsePart: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    if (part == 0)
+    {
+        NextToken(ctx);
+        ParseProgramHeading(ctx);
+        /* Synch SET 2 */
+        Synchronise(ctx, &ctx->ProcDeclarationFS_aug, &ctx->ProcDeclarationSync);
+        state->base = ctx->varaddress;
     }
     else
-        return EXIT_FAILURE;
+    {
+        EnterOuterSymbols(ctx, split, part);
+        ctx->display = ((PARTSTATE *)split->Parts[0].State)->ctx->display;
+        ctx->varaddress = state->base;
+        NextToken(ctx);
+    }
+    if (part < split->Count - 1)
+    {
+        count = ParseOuterProcedures(ctx, state->addresses, p->Procedures + 1);
+        state->valid = CurrentCode(ctx->lookahead) == ENDOFINPUT;
+    }
+    else
+    {
+        ParseBlock(ctx);
+        Emit(ctx, I_HALT, 0);
+        Accept(ctx, ENDOFPROGRAM);
+        state->valid = 1;
+    }
+    GetLineStats(ctx, &lines);
+    state->valid = state->valid && ctx->ErrorFlag == 0 && !CodeGenerationKilled(ctx) && lines.Errors == 0 &&
+                   count == p->Procedures && ctx->varaddress - state->base == p->Variables;
+    for (k = 0; state->valid && k < count; k++)
+    {
+        sptr = Probe(ctx, InternName(ctx, split->Names[p->FirstProcedure + k]));
+        state->valid = sptr != NULL && sptr->type == STYPE_PROCEDURE && sptr->scope == 0 &&
+                       sptr->address == state->addresses[k];
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  EnterOuterSymbols: enter into "ctx" the symbols a parse of the whole    */
+/*                     source would have at scope 0 when it reached part    */
+/*                     "part": the program name and globals, as part 0      */
+/*                     entered them, and the outer procedures before the    */
+/*                     part, at the addresses ParseInParallel stands in for */
+/*                     theirs.  Part 0 is only read.                        */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void EnterOuterSymbols(CONTEXT *ctx, SOURCESPLIT *split, int part)
+{
+    CONTEXT *first = ((PARTSTATE *)split->Parts[0].State)->ctx;
+    SYMBOL **table, *sptr;
+    int count, j;
+
+    count = GetSymbols(first, NULL, 0);
+    if (NULL == (table = malloc((count + 1) * sizeof(SYMBOL *))))
+    {
+        fprintf(stderr, "Fatal Error: EnterOuterSymbols: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    GetSymbols(first, table, count);
+    for (j = count - 1; j >= 0; j--)
+    {
+        if (table[j]->type != STYPE_PROCEDURE && NULL != (sptr = EnterSymbol(ctx, InternName(ctx, table[j]->s))))
+        {
+            sptr->scope = table[j]->scope;
+            sptr->type = table[j]->type;
+            sptr->address = table[j]->address;
+        }
+    }
+    free(table);
+    for (j = 0; j < split->Parts[part].FirstProcedure; j++)
+    {
+        if (NULL != (sptr = EnterSymbol(ctx, InternName(ctx, split->Names[j]))))
+        {
+            sptr->scope = 0;
+            sptr->type = STYPE_PROCEDURE;
+            sptr->address = -1 - j;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  LinkParts: put the code of the parts of "split", all valid, one after   */
+/*             the other into the code table of "ctx", moving the branches  */
+/*             and calls within each part to where it lands and pointing    */
+/*             the calls between parts at the procedures they name.  Then   */
+/*             enter the outer symbols, write the listings of the parts in  */
+/*             place of the source they cover and leave the parser state    */
+/*             as the parse of the whole would have.                        */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void LinkParts(CONTEXT *ctx, SOURCESPLIT *split)
+{
+    PARTSTATE *state;
+    SYMBOL *sptr;
+    LINESTATS lines;
+    char *listing;
+    size_t listlength;
+    int *entry, base, size, opcode, offset, addr, j, k;
+
+    if (NULL == (entry = malloc((split->Procedures + 1) * sizeof(int))))
+    {
+        fprintf(stderr, "Fatal Error: LinkParts: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (base = k = 0; k < split->Count; k++)
+    {
+        state = split->Parts[k].State;
+        for (j = 0; j < split->Parts[k].Procedures; j++)
+        {
+            entry[split->Parts[k].FirstProcedure + j] = base + state->addresses[j];
+        }
+        base += CurrentCodeAddress(state->ctx);
+    }
+    for (base = k = 0; k < split->Count; k++)
+    {
+        state = split->Parts[k].State;
+        size = CurrentCodeAddress(state->ctx);
+        for (addr = 0; addr < size; addr++)
+        {
+            opcode = GetInstruction(state->ctx, addr, &offset);
+            if (opcode == I_CALL && offset < 0)
+            {
+                offset = entry[-1 - offset];
+            }
+            else if (opcode >= I_BR && opcode <= I_CALL)
+            {
+                offset += base;
+            }
+            Emit(ctx, opcode, offset);
+        }
+        base += size;
+        ctx->tokens += state->ctx->tokens;
+    }
+
+    state = split->Parts[0].State;
+    EnterOuterSymbols(ctx, split, split->Count - 1);
+    for (j = 0; j < split->Procedures; j++)
+    {
+        sptr = Probe(ctx, InternName(ctx, split->Names[j]));
+        sptr->address = entry[j];
+    }
+    free(entry);
+    ctx->display = state->ctx->display;
+    for (k = 0; k < split->Count; k++)
+    {
+        state = split->Parts[k].State;
+        listing = TakeSinkBuffer(&state->listing, &listlength);
+        GetLineStats(state->ctx, &lines);
+        SkipSource(ctx, k < split->Count - 1 ? split->Parts[k].Length : (size_t)lines.BytesRead, listing,
+                   listlength);
+        free(listing);
+    }
+    ctx->varaddress = state->ctx->varaddress;
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  RunProgram: load the code table of "ctx" into a VM and run it, with     */
+/*              "Read" and "Write" on stdin and stdout.  Any run time       */
+/*              error and the instruction rate are reported on stderr.      */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void RunProgram(CONTEXT *ctx)
+{
+    VM *vm;
+    clock_t start;
+    double seconds;
+    int status;
+
+    if (NULL == (vm = LoadVM(ctx, VM_DEFAULT_MEMORY)))
+    {
+        return;
+    }
+    fflush(stdout);
+    start = clock();
+    status = RunVM(vm, stdin, stdout);
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (status != VM_HALTED)
+    {
+        fprintf(stderr, "Run time error: %s\n", VMErrorString(status));
+    }
+    fprintf(stderr, "%ld instructions in %.3fs, %.0f instructions/sec\n", VMInstructionCount(vm),
+            seconds, seconds > 0.0 ? VMInstructionCount(vm) / seconds : 0.0);
+    FreeVM(vm);
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  WriteObject: write the code and symbol tables of "ctx" to the object    */
+/*               file "filename".                                           */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void WriteObject(CONTEXT *ctx, char *filename)
+{
+    FILE *objfile;
+
+    if (NULL == (objfile = fopen(filename, "wb")))
+    {
+        fprintf(stderr, "cannot open \"%s\" for output\n", filename);
+        return;
+    }
+    if (!WriteObjectFile(ctx, objfile) | (0 != fclose(objfile)))
+    {
+        fprintf(stderr, "error writing \"%s\"\n", filename);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  CompileUnit: the BATCHCOMPILER for "comp -b".  Compiles one unit of a   */
+/*               batch in a CONTEXT of its own, so it may be called from    */
+/*               several worker threads at once.                            */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE int CompileUnit(BATCHUNIT *unit)
+{
+    CONTEXT *ctx;
+    char *argv[4];
+    int status = BATCH_FAILED;
+
+    argv[0] = "comp";
+    argv[1] = unit->InputName;
+    argv[2] = unit->ListName;
+    argv[3] = unit->CodeName;
+    ctx = MakeCompilerContext();
+    if (OpenFiles(ctx, 4, argv))
+    {
+        Compile(ctx, 0, 0, 0, 0, NULL);
+        status = ctx->ErrorFlag == 0 ? BATCH_VALID : BATCH_INVALID;
+    }
+    FreeContext(ctx);
+    return status;
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  CompileRequest: the DAEMONCOMPILER for "comp -d".  Compiles the source  */
+/*                  of one request into a listing and code held in memory   */
+/*                  (see "CompileBuffer").  The worker's CONTEXT is kept in */
+/*                  "request->State" and reused for each request.           */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE int CompileRequest(DAEMONREQUEST *request)
+{
+    SINK listing, code;
+    int valid;
+
+    if (request->State == NULL)
+    {
+        request->State = MakeCompilerContext();
+    }
+    InitBufferSink(&listing);
+    InitBufferSink(&code);
+    valid = CompileBuffer(request->State, request->Source, request->SourceLength, &listing, &code);
+    request->Listing = TakeSinkBuffer(&listing, &request->ListingLength);
+    request->Code = TakeSinkBuffer(&code, &request->CodeLength);
+    return valid ? DAEMON_VALID : DAEMON_INVALID;
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -204,27 +973,66 @@ PUBLIC int main(int argc, char *argv[])
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseProgram(void)
+PRIVATE void ParseProgram(CONTEXT *ctx)
 {
-    Accept(PROGRAM);
-    MakeSymbolTableEntry(STYPE_PROGRAM, &varaddress);
-    ParseVarOrProcName();
-    Accept(SEMICOLON);
-    /* Synch SET 1 */
-    Synchronise(&DeclarationFS_aug, &ProcDeclarationFBS);
-    if (CurrentToken.code == VAR)
-        ParseDeclarations(0);
+    ParseProgramHeading(ctx);
     /* Synch SET 2 */
-    Synchronise(&ProcDeclarationFS_aug, &ProcDeclarationFBS);
-    while (CurrentToken.code == PROCEDURE)
+    Synchronise(ctx, &ctx->ProcDeclarationFS_aug, &ctx->ProcDeclarationSync);
+    while (CurrentCode(ctx->lookahead) == PROCEDURE)
     {
-        ParseProcDeclarations();
+        ParseProcDeclarations(ctx);
         /* resynch */
-        Synchronise(&DeclarationFS_aug, &ProcDeclarationFBS);
+        Synchronise(ctx, &ctx->DeclarationFS_aug, &ctx->DeclarationSync);
     }
-    ParseBlock();
-    Emit(I_HALT, 0);
-    Accept(ENDOFPROGRAM); /* Token "." has name ENDOFPROGRAM */
+    ParseBlock(ctx);
+    Emit(ctx, I_HALT, 0);
+    Accept(ctx, ENDOFPROGRAM); /* Token "." has name ENDOFPROGRAM */
+}
+
+/*--------------------------------------------------------------------------------------------------------------*/
+/*                                                                                                              */
+/*  ParseProgramHeading: the part of ParseProgram before the procedures,                                        */
+/*                                                                                                              */
+/*      "PROGRAM" <ParseVariable> ";" [<ParseDeclarations>]                                                     */
+/*                                                                                                              */
+/*      which also places the display after the globals.                                                        */
+/*                                                                                                              */
+/*  ParseOuterProcedures: the outer procedures of one part of a split source (see "ParseInParallel"), up to     */
+/*      the end of the part.  Stores the address of each of the first "max" of them in "addresses" and returns  */
+/*      how many there were.                                                                                    */
+/*                                                                                                              */
+/*--------------------------------------------------------------------------------------------------------------*/
+
+PRIVATE void ParseProgramHeading(CONTEXT *ctx)
+{
+    Accept(ctx, PROGRAM);
+    MakeSymbolTableEntry(ctx, STYPE_PROGRAM, &ctx->varaddress);
+    ParseVarOrProcName(ctx);
+    Accept(ctx, SEMICOLON);
+    /* Synch SET 1 */
+    Synchronise(ctx, &ctx->DeclarationFS_aug, &ctx->DeclarationSync);
+    if (CurrentCode(ctx->lookahead) == VAR)
+        ParseDeclarations(ctx, 0);
+    ctx->display = ctx->varaddress;
+}
+
+PRIVATE int ParseOuterProcedures(CONTEXT *ctx, int *addresses, int max)
+{
+    int count = 0;
+
+    while (CurrentCode(ctx->lookahead) == PROCEDURE)
+    {
+        /* the procedure's entry is just after the branch around it */
+        if (count < max)
+            addresses[count] = CurrentCodeAddress(ctx) + 1;
+        count++;
+        ParseProcDeclarations(ctx);
+        if (CurrentCode(ctx->lookahead) == ENDOFINPUT)
+            break;
+        /* resynch */
+        Synchronise(ctx, &ctx->DeclarationFS_aug, &ctx->DeclarationSync);
+    }
+    return count;
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -252,34 +1060,34 @@ PRIVATE void ParseProgram(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseDeclarations(int loc_flag)
+PRIVATE void ParseDeclarations(CONTEXT *ctx, int loc_flag)
 {
 
-    Accept(VAR);
+    Accept(ctx, VAR);
     if (loc_flag != 1)
     {
-        MakeSymbolTableEntry(STYPE_VARIABLE, &varaddress);
-        ParseVariable();
-        while (CurrentToken.code == COMMA)
+        MakeSymbolTableEntry(ctx, STYPE_VARIABLE, &ctx->varaddress);
+        ParseVariable(ctx);
+        while (CurrentCode(ctx->lookahead) == COMMA)
         {
-            Accept(COMMA);
-            MakeSymbolTableEntry(STYPE_VARIABLE, &varaddress);
-            ParseVariable();
+            Accept(ctx, COMMA);
+            MakeSymbolTableEntry(ctx, STYPE_VARIABLE, &ctx->varaddress);
+            ParseVariable(ctx);
         }
     }
     else
     {
-        MakeSymbolTableEntry(STYPE_LOCALVAR, &varaddress);
-        ParseVariable();
-        while (CurrentToken.code == COMMA)
+        MakeSymbolTableEntry(ctx, STYPE_LOCALVAR, &ctx->varaddress);
+        ParseVariable(ctx);
+        while (CurrentCode(ctx->lookahead) == COMMA)
         {
-            Accept(COMMA);
-            MakeSymbolTableEntry(STYPE_LOCALVAR, &varaddress);
-            ParseVariable();
+            Accept(ctx, COMMA);
+            MakeSymbolTableEntry(ctx, STYPE_LOCALVAR, &ctx->varaddress);
+            ParseVariable(ctx);
         }
     }
 
-    Accept(SEMICOLON);
+    Accept(ctx, SEMICOLON);
 }
 /*--------------------------------------------------------------------------------------------------------------*/
 /*                                                                                                              */
@@ -304,58 +1112,77 @@ PRIVATE void ParseDeclarations(int loc_flag)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseProcDeclarations(void)
+PRIVATE void ParseProcDeclarations(CONTEXT *ctx)
 {
-    int backpatch_addr, loc_flag;
+    int backpatch_addr, loc_flag, frame, nested = 0;
     /* int ptype[];  pcount,*/
     SYMBOL *procedure;
 
-    Accept(PROCEDURE);
+    Accept(ctx, PROCEDURE);
 
-    procedure = MakeSymbolTableEntry(STYPE_PROCEDURE, NULL);
+    procedure = MakeSymbolTableEntry(ctx, STYPE_PROCEDURE, NULL);
 
-    ParseVarOrProcName();
+    ParseVarOrProcName(ctx);
 
-    backpatch_addr = CurrentCodeAddress();
-    Emit(I_BR, 9999);
+    backpatch_addr = CurrentCodeAddress(ctx);
+    Emit(ctx, I_BR, 9999);
 
-    procedure->address = CurrentCodeAddress();
-    scope++;
+    if (procedure != NULL)
+        procedure->address = CurrentCodeAddress(ctx);
+    ctx->scope++;
 
-    if (CurrentToken.code == LEFTPARENTHESIS)
+    if (CurrentCode(ctx->lookahead) == LEFTPARENTHESIS)
     {
-        ParseParameterList();
+        ParseParameterList(ctx);
     }
-    Accept(SEMICOLON);
+    Accept(ctx, SEMICOLON);
     /* Synch SET 1 */
-    Synchronise(&DeclarationFS_aug, &ProcDeclarationFBS);
-    if (CurrentToken.code == VAR)
+    Synchronise(ctx, &ctx->DeclarationFS_aug, &ctx->DeclarationSync);
+    if (CurrentCode(ctx->lookahead) == VAR)
     {
         loc_flag = 1;
-        ParseDeclarations(loc_flag);
+        ParseDeclarations(ctx, loc_flag);
     }
-    if (varaddress > 0)
+    frame = ctx->varaddress;
+    if (frame > 0)
     {
 
-        Emit(I_INC, varaddress);
+        Emit(ctx, I_INC, frame);
     }
     /* Synch SET 2 */
-    Synchronise(&ProcDeclarationFS_aug, &ProcDeclarationFBS);
-    while (CurrentToken.code == PROCEDURE)
+    Synchronise(ctx, &ctx->ProcDeclarationFS_aug, &ctx->ProcDeclarationSync);
+    while (CurrentCode(ctx->lookahead) == PROCEDURE)
     {
-        ParseProcDeclarations();
+        ParseProcDeclarations(ctx);
+        nested = 1;
         /* resynch */
-        Synchronise(&ProcDeclarationFS_aug, &ProcDeclarationFBS);
+        Synchronise(ctx, &ctx->ProcDeclarationFS_aug, &ctx->ProcDeclarationSync);
+    }
+    /* only procedures declared in this one read its display entry */
+    if (nested)
+    {
+        Emit(ctx, I_LOADA, ctx->display + ctx->scope - 1);
+        _Emit(ctx, I_PUSHFP);
+        Emit(ctx, I_STOREA, ctx->display + ctx->scope - 1);
     }
-    ParseBlock();
-    Accept(SEMICOLON);
+    ParseBlock(ctx);
+    Accept(ctx, SEMICOLON);
 
     /* cleanup */
-    Emit(I_DEC, varaddress);
-    _Emit(I_RET);
-    BackPatch(backpatch_addr, CurrentCodeAddress());
-    RemoveSymbols(scope);
-    scope--;
+    if (nested)
+    {
+        Emit(ctx, I_STOREA, ctx->display + ctx->scope - 1);
+    }
+    Emit(ctx, I_DEC, frame);
+    _Emit(ctx, I_RET);
+    BackPatch(ctx, backpatch_addr, CurrentCodeAddress(ctx));
+    /* with the outermost branch patched, none of the code so far will change */
+    if (ctx->scope == 1)
+    {
+        FlushCode(ctx);
+    }
+    RemoveSymbols(ctx, ctx->scope);
+    ctx->scope--;
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -380,17 +1207,17 @@ PRIVATE void ParseProcDeclarations(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseParameterList(void)
+PRIVATE void ParseParameterList(CONTEXT *ctx)
 {
-    Accept(LEFTPARENTHESIS);
-    ParseFormalParameter();
-    while (CurrentToken.code == COMMA)
+    Accept(ctx, LEFTPARENTHESIS);
+    ParseFormalParameter(ctx);
+    while (CurrentCode(ctx->lookahead) == COMMA)
     {
 
-        Accept(COMMA);
-        ParseFormalParameter();
+        Accept(ctx, COMMA);
+        ParseFormalParameter(ctx);
     }
-    Accept(RIGHTPARENTHESIS);
+    Accept(ctx, RIGHTPARENTHESIS);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -416,19 +1243,19 @@ PRIVATE void ParseParameterList(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseFormalParameter(void)
+PRIVATE void ParseFormalParameter(CONTEXT *ctx)
 {
-    if (CurrentToken.code == REF)
+    if (CurrentCode(ctx->lookahead) == REF)
     {
-        Accept(REF);
-        MakeSymbolTableEntry(STYPE_REFPAR, &varaddress);
+        Accept(ctx, REF);
+        MakeSymbolTableEntry(ctx, STYPE_REFPAR, &ctx->varaddress);
     }
     else
     {
-        MakeSymbolTableEntry(STYPE_VALUEPAR, &varaddress);
+        MakeSymbolTableEntry(ctx, STYPE_VALUEPAR, &ctx->varaddress);
     }
 
-    ParseVariable();
+    ParseVariable(ctx);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -453,20 +1280,26 @@ PRIVATE void ParseFormalParameter(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseBlock(void)
+PRIVATE void ParseBlock(CONTEXT *ctx)
 {
     int token;
-    Accept(BEGIN);
+    Accept(ctx, BEGIN);
     /* Synch SET */
-    Synchronise(&StatementFS_aug, &StatementFBS);
-    while ((token = CurrentToken.code) == IDENTIFIER || token == WHILE || token == IF || token == READ || token == WRITE)
+    Synchronise(ctx, &ctx->StatementFS_aug, &ctx->StatementSync);
+    while ((token = CurrentCode(ctx->lookahead)) == IDENTIFIER || token == WHILE || token == IF || token == READ ||
+           token == WRITE)
     {
-        ParseStatement();
-        Accept(SEMICOLON);
+        ParseStatement(ctx);
+        Accept(ctx, SEMICOLON);
+        /* the main program's statements are final once parsed */
+        if (ctx->scope == 0)
+        {
+            FlushCode(ctx);
+        }
         /* reSynch SET  */
-        Synchronise(&StatementFS_aug, &StatementFBS);
+        Synchronise(ctx, &ctx->StatementFS_aug, &ctx->StatementSync);
     }
-    Accept(END);
+    Accept(ctx, END);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -492,26 +1325,26 @@ PRIVATE void ParseBlock(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseStatement(void)
+PRIVATE void ParseStatement(CONTEXT *ctx)
 {
 
-    switch (CurrentToken.code)
+    switch (CurrentCode(ctx->lookahead))
     {
 
     case IDENTIFIER:
-        ParseSimpleStatement();
+        ParseSimpleStatement(ctx);
         break;
     case WHILE:
-        ParseWhileStatement();
+        ParseWhileStatement(ctx);
         break;
     case IF:
-        ParseIfStatement();
+        ParseIfStatement(ctx);
         break;
     case READ:
-        ParseReadStatement();
+        ParseReadStatement(ctx);
         break;
     case WRITE:
-        ParseWriteStatement();
+        ParseWriteStatement(ctx);
         break;
     default:
         break;
@@ -541,13 +1374,13 @@ PRIVATE void ParseStatement(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseSimpleStatement(void)
+PRIVATE void ParseSimpleStatement(CONTEXT *ctx)
 {
     SYMBOL *target;
-    target = LookupSymbol();
-    ParseVarOrProcName();
+    target = LookupSymbol(ctx);
+    ParseVarOrProcName(ctx);
 
-    ParseRestofStatement(target);
+    ParseRestofStatement(ctx, target);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -572,80 +1405,69 @@ PRIVATE void ParseSimpleStatement(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseRestofStatement(SYMBOL *target)
+PRIVATE void ParseRestofStatement(CONTEXT *ctx, SYMBOL *target)
 {
-    int i;
     int dS;
 
-    switch (CurrentToken.code)
+    switch (CurrentCode(ctx->lookahead))
     {
     case LEFTPARENTHESIS:
-        ParseProcCallList(target);
+        ParseProcCallList(ctx, target);
     case SEMICOLON:
         if (target != NULL && target->type == STYPE_PROCEDURE)
         {
-            _Emit(I_PUSHFP);
-            _Emit(I_BSF);
-            Emit(I_CALL, target->address);
-            _Emit(I_RSF);
+            _Emit(ctx, I_PUSHFP);
+            _Emit(ctx, I_BSF);
+            Emit(ctx, I_CALL, target->address);
+            _Emit(ctx, I_RSF);
         }
         else
         {
-            printf("Not a Procedure \n");
-            KillCodeGeneration();
+            if (!ctx->speculative && !ctx->quiet)
+                printf("Not a Procedure \n");
+            KillCodeGeneration(ctx);
         }
         break;
     case ASSIGNMENT:
     default:
-        ParseAssignment();
+        ParseAssignment(ctx);
         if (target != NULL)
         {
             switch (target->type)
             {
             case STYPE_VARIABLE:
-                Emit(I_STOREA, target->address);
+                Emit(ctx, I_STOREA, target->address);
                 break;
             case STYPE_LOCALVAR:
-                dS = scope - target->scope;
+                dS = ctx->scope - target->scope;
                 if (dS == 0)
                 {
-                    Emit(I_STOREFP, target->address);
+                    Emit(ctx, I_STOREFP, target->address);
                 }
                 else
                 {
-                    _Emit(I_STOREFP);
-                    for (i = 0; i < dS; i++)
-                    {
-                        _Emit(I_STORESP);
-                    }
-                    Emit(I_STORESP, target->address);
+                    EmitOuterAccess(ctx, I_STORESP, target);
                 }
                 break;
             case STYPE_VALUEPAR:
-                Emit(I_STOREA, target->address);
+                Emit(ctx, I_STOREA, target->address);
                 break;
             case STYPE_REFPAR:
-                dS = scope - target->scope;
+                dS = ctx->scope - target->scope;
                 if (dS == 0)
                 {
-                    Emit(I_STOREFP, target->address);
+                    Emit(ctx, I_STOREFP, target->address);
                 }
                 else
                 {
-
-                    _Emit(I_STOREFP);
-                    for (i = 0; i < dS; i++)
-                    {
-                        _Emit(I_STORESP);
-                    }
-                    Emit(I_STORESP, target->address);
+                    EmitOuterAccess(ctx, I_STORESP, target);
                 }
                 break;
             }
         }
         else
         {
-            Error("ERROR: UNDECLARED VARIABLE", CurrentToken.pos);
+            Error(ctx, "ERROR: UNDECLARED VARIABLE", CurrentPos(ctx->lookahead));
         }
         break;
     }
@@ -673,16 +1495,16 @@ PRIVATE void ParseRestofStatement(SYMBOL *target)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseProcCallList(SYMBOL *target)
+PRIVATE void ParseProcCallList(CONTEXT *ctx, SYMBOL *target)
 {
-    Accept(LEFTPARENTHESIS);
-    ParseActualParameter(0);
-    while (CurrentToken.code == COMMA)
+    Accept(ctx, LEFTPARENTHESIS);
+    ParseActualParameter(ctx, 0);
+    while (CurrentCode(ctx->lookahead) == COMMA)
     {
-        Accept(COMMA);
-        ParseActualParameter(0);
+        Accept(ctx, COMMA);
+        ParseActualParameter(ctx, 0);
     }
-    Accept(RIGHTPARENTHESIS);
+    Accept(ctx, RIGHTPARENTHESIS);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -705,10 +1527,10 @@ PRIVATE void ParseProcCallList(SYMBOL *target)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseAssignment(void)
+PRIVATE void ParseAssignment(CONTEXT *ctx)
 {
-    Accept(ASSIGNMENT);
-    ParseExpression();
+    Accept(ctx, ASSIGNMENT);
+    ParseExpression(ctx);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -733,18 +1555,22 @@ PRIVATE void ParseAssignment(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseActualParameter(int isRef_flag)
+PRIVATE void ParseActualParameter(CONTEXT *ctx, int isRef_flag)
 {
     SYMBOL *var;
 
-    var = LookupSymbol();
+    var = LookupSymbol(ctx);
 
-    if (isRef_flag)
-        var->type = STYPE_REFPAR;
-    else
-        var->type = STYPE_VALUEPAR;
+    /* "var" is NULL if the identifier was not declared (already reported) */
+    if (var != NULL)
+    {
+        if (isRef_flag)
+            var->type = STYPE_REFPAR;
+        else
+            var->type = STYPE_VALUEPAR;
+    }
 
-    ParseExpression();
+    ParseExpression(ctx);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -768,12 +1594,12 @@ PRIVATE void ParseActualParameter(int isRef_flag)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseWhileStatement(void)
+PRIVATE void ParseWhileStatement(CONTEXT *ctx)
 {
-    Accept(WHILE);
-    ParseBooleanExpression();
-    Accept(DO);
-    ParseBlock();
+    Accept(ctx, WHILE);
+    ParseBooleanExpression(ctx);
+    Accept(ctx, DO);
+    ParseBlock(ctx);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -797,17 +1623,17 @@ PRIVATE void ParseWhileStatement(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseIfStatement(void)
+PRIVATE void ParseIfStatement(CONTEXT *ctx)
 {
-    Accept(IF);
-    ParseBooleanExpression();
-    Accept(THEN);
-    ParseBlock();
+    Accept(ctx, IF);
+    ParseBooleanExpression(ctx);
+    Accept(ctx, THEN);
+    ParseBlock(ctx);
 
-    if (CurrentToken.code == ELSE)
+    if (CurrentCode(ctx->lookahead) == ELSE)
     {
-        Accept(ELSE);
-        ParseBlock();
+        Accept(ctx, ELSE);
+        ParseBlock(ctx);
     }
 }
 
@@ -832,18 +1658,18 @@ PRIVATE void ParseIfStatement(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseReadStatement(void)
+PRIVATE void ParseReadStatement(CONTEXT *ctx)
 {
-    Accept(READ);
-    Accept(LEFTPARENTHESIS);
-    ParseVarOrProcName();
-    while (CurrentToken.code == COMMA)
+    Accept(ctx, READ);
+    Accept(ctx, LEFTPARENTHESIS);
+    ParseVarOrProcName(ctx);
+    while (CurrentCode(ctx->lookahead) == COMMA)
     {
-        Accept(COMMA);
-        ParseVarOrProcName();
+        Accept(ctx, COMMA);
+        ParseVarOrProcName(ctx);
     }
-    Accept(RIGHTPARENTHESIS);
-    _Emit(I_READ);
+    Accept(ctx, RIGHTPARENTHESIS);
+    _Emit(ctx, I_READ);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -867,18 +1693,18 @@ PRIVATE void ParseReadStatement(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseWriteStatement(void)
+PRIVATE void ParseWriteStatement(CONTEXT *ctx)
 {
-    Accept(WRITE);
-    Accept(LEFTPARENTHESIS);
-    ParseExpression();
-    while (CurrentToken.code == COMMA)
+    Accept(ctx, WRITE);
+    Accept(ctx, LEFTPARENTHESIS);
+    ParseExpression(ctx);
+    while (CurrentCode(ctx->lookahead) == COMMA)
     {
-        Accept(COMMA);
-        ParseExpression();
+        Accept(ctx, COMMA);
+        ParseExpression(ctx);
     }
-    Accept(RIGHTPARENTHESIS);
-    _Emit(I_WRITE);
+    Accept(ctx, RIGHTPARENTHESIS);
+    _Emit(ctx, I_WRITE);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -897,33 +1723,35 @@ PRIVATE void ParseWriteStatement(void)
 /*                                                                                                              */
 /*      Outputs:      1) If Add is processed from the "inputFile"  "ADD" is loaded to the "CodeFile"            */
 /*                    2) if Subtract is processed from the "inputFile" "SUB" is loaded to the "CodeFile"        */
-/*      Returns:      Nothing                                                                                   */
+/*                    Operations on two constants are folded into a single "Load #" (see "FoldOperation")       */
+/*      Returns:      1 if the code emitted is a single "Load #", 0 if not                                      */
 /*                                                                                                              */
 /*      Side Effects: Lookahead token advanced.                                                                 */
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseExpression(void)
+PRIVATE int ParseExpression(CONTEXT *ctx)
 {
-    int token;
-    ParseCompoundTerm();
-    while ((token = CurrentToken.code) == ADD || token == SUBTRACT)
+    int token, pos;
+    int constant = ParseCompoundTerm(ctx);
+    while ((token = CurrentCode(ctx->lookahead)) == ADD || token == SUBTRACT)
     {
-
+        pos = CurrentPos(ctx->lookahead);
         switch (token)
         {
         case ADD:
-            Accept(token);
-            ParseCompoundTerm();
-            _Emit(I_ADD);
+            Accept(ctx, token);
+            constant = ParseCompoundTerm(ctx) && constant;
+            constant = constant ? FoldOperation(ctx, I_ADD, pos) : (_Emit(ctx, I_ADD), 0);
             break;
         case SUBTRACT:
-            Accept(token);
-            ParseCompoundTerm();
-            _Emit(I_SUB);
+            Accept(ctx, token);
+            constant = ParseCompoundTerm(ctx) && constant;
+            constant = constant ? FoldOperation(ctx, I_SUB, pos) : (_Emit(ctx, I_SUB), 0);
             break;
         }
     }
+    return constant;
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -941,33 +1769,36 @@ PRIVATE void ParseExpression(void)
 /*      Outputs:      1) If a Multipicaltion is processed from the "InputFile" then "Mult" is added to          */
 /*                    the "CodeFile"                                                                            */
 /*                    2) If a Division is processed from the "InputFile" then "Div" is added tp the "CodeFile"  */
+/*                    Operations on two constants are folded into a single "Load #" (see "FoldOperation")       */
 /*                                                                                                              */
-/*      Returns:      Nothing                                                                                   */
+/*      Returns:      1 if the code emitted is a single "Load #", 0 if not                                      */
 /*                                                                                                              */
 /*      Side Effects: Lookahead token advanced.                                                                 */
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseCompoundTerm(void)
+PRIVATE int ParseCompoundTerm(CONTEXT *ctx)
 {
-    int token2;
-    ParseTerm();
-    while ((token2 = CurrentToken.code) == MULTIPLY || token2 == DIVIDE)
+    int token2, pos;
+    int constant = ParseTerm(ctx);
+    while ((token2 = CurrentCode(ctx->lookahead)) == MULTIPLY || token2 == DIVIDE)
     {
+        pos = CurrentPos(ctx->lookahead);
         switch (token2)
         {
         case MULTIPLY:
-            Accept(token2);
-            ParseTerm();
-            _Emit(I_MULT);
+            Accept(ctx, token2);
+            constant = ParseTerm(ctx) && constant;
+            constant = constant ? FoldOperation(ctx, I_MULT, pos) : (_Emit(ctx, I_MULT), 0);
             break;
         case DIVIDE:
-            Accept(token2);
-            ParseTerm();
-            _Emit(I_DIV);
+            Accept(ctx, token2);
+            constant = ParseTerm(ctx) && constant;
+            constant = constant ? FoldOperation(ctx, I_DIV, pos) : (_Emit(ctx, I_DIV), 0);
             break;
         }
     }
+    return constant;
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -985,26 +1816,35 @@ PRIVATE void ParseCompoundTerm(void)
 /*      Inputs:       None                                                                                      */
 /*                                                                                                              */
 /*      Outputs:      If a negitive value is processed from the "inputFile" Then a Neg is loaded to             */
-/*                    the "CodeFile"                                                                            */
+/*                    the "CodeFile", unless the value is a constant, which is negated in place                 */
 /*                                                                                                              */
-/*      Returns:      Nothing                                                                                   */
+/*      Returns:      1 if the code emitted is a single "Load #", 0 if not                                      */
 /*                                                                                                              */
 /*      Side Effects: Lookahead token advanced.                                                                 */
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseTerm(void)
+PRIVATE int ParseTerm(CONTEXT *ctx)
 {
-    int TokenCheck = CurrentToken.code;
-    if (CurrentToken.code == SUBTRACT)
-        Accept(SUBTRACT);
+    int TokenCheck = CurrentCode(ctx->lookahead);
+    int constant, addr, value;
+    if (CurrentCode(ctx->lookahead) == SUBTRACT)
+        Accept(ctx, SUBTRACT);
 
-    ParseSubTerm();
+    constant = ParseSubTerm(ctx);
     if (TokenCheck == SUBTRACT)
     {
-        _Emit(I_NEG);
+        if (constant)
+        {
+            addr = CurrentCodeAddress(ctx) - 1;
+            GetInstruction(ctx, addr, &value);
+            SetInstruction(ctx, addr, I_LOADI, (int)(0u - (unsigned)value));
+        }
+        else
+            _Emit(ctx, I_NEG);
         TokenCheck = 0;
     }
+    return constant;
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -1024,33 +1864,35 @@ PRIVATE void ParseTerm(void)
 /*      Outputs:      1) if IDENTIFIER: Loads the  pre-declared identifier to "codeFile"                        */
 /*                    2) if INCONST: Loads the constant to the "codeFile"                                       */
 /*                                                                                                              */
-/*      Returns:      Nothing                                                                                   */
+/*      Returns:      1 if the code emitted is a single "Load #", 0 if not                                      */
 /*                                                                                                              */
 /*      Side Effects: Lookahead token advanced.                                                                 */
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseSubTerm(void)
+PRIVATE int ParseSubTerm(CONTEXT *ctx)
 {
 
-    int i, dS;
+    int dS;
+    int constant = 0;
 
     SYMBOL *var;
 
-    switch (CurrentToken.code)
+    switch (CurrentCode(ctx->lookahead))
     {
     case INTCONST:
-        Emit(I_LOADI, CurrentToken.value);
-        Accept(INTCONST);
+        Emit(ctx, I_LOADI, CurrentValue(ctx->lookahead));
+        Accept(ctx, INTCONST);
+        constant = 1;
         break;
     case LEFTPARENTHESIS:
-        Accept(LEFTPARENTHESIS);
-        ParseExpression();
-        Accept(RIGHTPARENTHESIS);
+        Accept(ctx, LEFTPARENTHESIS);
+        constant = ParseExpression(ctx);
+        Accept(ctx, RIGHTPARENTHESIS);
         break;
     case IDENTIFIER:
     default:
-        var = LookupSymbol();
+        var = LookupSymbol(ctx);
         if (var != NULL)
         {
 
@@ -1058,51 +1900,38 @@ PRIVATE void ParseSubTerm(void)
             {
 
             case STYPE_VARIABLE:
-                Emit(I_LOADA, var->address);
+                Emit(ctx, I_LOADA, var->address);
                 break;
             case STYPE_LOCALVAR:
-                dS = scope - var->scope;
+                dS = ctx->scope - var->scope;
                 if (dS == 0)
-                    Emit(I_LOADFP, var->address);
+                    Emit(ctx, I_LOADFP, var->address);
                 else
-                {
-                    _Emit(I_LOADFP);
-                    for (i = 0; i < dS; i++)
-                    {
-                        _Emit(I_LOADSP);
-                    }
-                    Emit(I_LOADSP, var->address);
-                }
+                    EmitOuterAccess(ctx, I_LOADSP, var);
                 break;
             case STYPE_VALUEPAR:
-                Emit(I_LOADA, var->address);
+                Emit(ctx, I_LOADA, var->address);
                 break;
             case STYPE_REFPAR:
-                dS = scope - var->scope;
+                dS = ctx->scope - var->scope;
                 if (dS == 0)
-                    Emit(I_LOADI, var->address);
+                    Emit(ctx, I_LOADI, var->address);
                 else
-                {
-
-                    _Emit(I_LOADFP);
-                    for (i = 0; i < dS; i++)
-                    {
-                        _Emit(I_LOADSP);
-                    }
-                    Emit(I_LOADSP, var->address);
-                }
+                    EmitOuterAccess(ctx, I_LOADSP, var);
                 break;
             }
         }
         else
         {
-            printf("Error: undeclared variable");
-            KillCodeGeneration();
+            if (!ctx->speculative && !ctx->quiet)
+                printf("Error: undeclared variable");
+            KillCodeGeneration(ctx);
         }
-        Accept(IDENTIFIER);
+        Accept(ctx, IDENTIFIER);
 
         break;
     }
+    return constant;
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -1127,11 +1956,11 @@ PRIVATE void ParseSubTerm(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseBooleanExpression(void)
+PRIVATE void ParseBooleanExpression(CONTEXT *ctx)
 {
-    ParseExpression();
-    ParseRelOp();
-    ParseExpression();
+    ParseExpression(ctx);
+    ParseRelOp(ctx);
+    ParseExpression(ctx);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -1156,24 +1985,24 @@ PRIVATE void ParseBooleanExpression(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseRelOp(void)
+PRIVATE void ParseRelOp(CONTEXT *ctx)
 {
-    switch (CurrentToken.code)
+    switch (CurrentCode(ctx->lookahead))
     {
     case EQUALITY:
-        Accept(EQUALITY);
+        Accept(ctx, EQUALITY);
         break;
     case LESSEQUAL:
-        Accept(LESSEQUAL);
+        Accept(ctx, LESSEQUAL);
         break;
     case GREATEREQUAL:
-        Accept(GREATEREQUAL);
+        Accept(ctx, GREATEREQUAL);
         break;
     case LESS:
-        Accept(LESS);
+        Accept(ctx, LESS);
         break;
     case GREATER:
-        Accept(GREATER);
+        Accept(ctx, GREATER);
         break;
     default:
         break;
@@ -1201,10 +2030,10 @@ PRIVATE void ParseRelOp(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseVariable(void)
+PRIVATE void ParseVariable(CONTEXT *ctx)
 {
     /* MakeSymbolTableEntry(STYPE_VARIABLE, &varaddress); */
-    Accept(IDENTIFIER);
+    Accept(ctx, IDENTIFIER);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -1229,15 +2058,71 @@ PRIVATE void ParseVariable(void)
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void ParseVarOrProcName(void)
+PRIVATE void ParseVarOrProcName(CONTEXT *ctx)
 {
 
-    Accept(IDENTIFIER);
+    Accept(ctx, IDENTIFIER);
 }
 /*--------------------------------------------------------------------------*/
 /*                                                                          */
 /*  End of parser.  Support routines follow.                                */
 /*                                                                          */
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  EmitOuterAccess: load ("opcode" I_LOADSP) or store (I_STORESP) "var",   */
+/*                   a local or parameter of an enclosing procedure.  The   */
+/*                   frame pointer of each procedure level that has         */
+/*                   procedures nested in it is kept in a display in        */
+/*                   memory, one word per level from "ctx->display" up,     */
+/*                   saved and set on entry to the procedure and restored   */
+/*                   on exit, so every outer access is two instructions     */
+/*                   whatever the distance in scopes:                       */
+/*                                                                          */
+/*                       Load  <display + level - 1>                        */
+/*                       Load  [SP]+<address>    or    Store [SP]+<address> */
+/*                                                                          */
+/*                   The VM's own display ("Ldp"/"Rdp") cannot be read by   */
+/*                   any instruction, hence the words in memory.            */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void EmitOuterAccess(CONTEXT *ctx, int opcode, SYMBOL *var)
+{
+    Emit(ctx, I_LOADA, ctx->display + var->scope - 1);
+    Emit(ctx, opcode, var->address);
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  FoldOperation: replace the two "Load #" instructions at the end of the  */
+/*                 code by one loading the result of "opcode" (I_ADD ..     */
+/*                 I_DIV) on their constants.  A constant division by zero  */
+/*                 is reported with "Error" at "pos" and the "Div" emitted  */
+/*                 as it stands.                                            */
+/*                                                                          */
+/*                 Returns 1 if the operation was folded, 0 if not.         */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE int FoldOperation(CONTEXT *ctx, int opcode, int pos)
+{
+    int addr = CurrentCodeAddress(ctx) - 2;
+    int a, b, result;
+
+    GetInstruction(ctx, addr, &a);
+    GetInstruction(ctx, addr + 1, &b);
+    if (!ConstantArithmetic(opcode, a, b, &result))
+    {
+        Error(ctx, "Division by zero", pos);
+        KillCodeGeneration(ctx);
+        _Emit(ctx, opcode);
+        return 0;
+    }
+    TruncateCode(ctx, addr);
+    Emit(ctx, I_LOADI, result);
+    return 1;
+}
+
 /*--------------------------------------------------------------------------*/
 /*                                                                          */
 /*  Accept:  Takes an expected token name as argument, and if the current   */
@@ -1258,31 +2143,71 @@ PRIVATE void ParseVarOrProcName(void)
 /*                                                                          */
 /*    Returns:      Nothing                                                 */
 /*                                                                          */
-/*    Side Effects: If successful, advances the current lookahead token     */
-/*                  "CurrentToken".                                         */
+/*    Side Effects: If successful, advances to the next token (see          */
+/*                  "NextToken").                                           */
 /*                                                                          */
 /*--------------------------------------------------------------------------*/
 
-PRIVATE void Accept(int ExpectedToken)
+PRIVATE void Accept(CONTEXT *ctx, int ExpectedToken)
 {
-    static int recovering = 0;
+    SET Expected;
 
-    if (recovering)
+    if (ctx->recovering)
     {
-        while (CurrentToken.code != ExpectedToken && CurrentToken.code != ENDOFINPUT)
-            CurrentToken = GetToken();
-        recovering = 0;
+        ClearSet(&Expected);
+        AddElement(&Expected, ExpectedToken);
+        SkipTokens(ctx, &Expected);
+        ctx->recovering = 0;
     }
 
-    if (CurrentToken.code != ExpectedToken)
+    if (CurrentCode(ctx->lookahead) != ExpectedToken)
     {
 
-        SyntaxError(ExpectedToken, CurrentToken);
-        recovering = 1;
-        ErrorFlag = 1;
+        SyntaxError(ctx, ExpectedToken, PeekToken(ctx->lookahead, 0));
+        ctx->recovering = 1;
+        ctx->ErrorFlag = 1;
     }
     else
-        CurrentToken = GetToken();
+        NextToken(ctx);
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  NextToken:  Advances to the next token, which the "Current..." macros   */
+/*              of "tokarray.h" then give, counting it, with the phase of   */
+/*              the CONTEXT set to scanning meanwhile (see "stats.h").      */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void NextToken(CONTEXT *ctx)
+{
+    int was;
+
+    EnterPhase(ctx, was, PHASE_SCAN);
+    Advance(ctx->lookahead);
+    ctx->tokens++;
+    LeavePhase(ctx, was);
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  SkipTokens: Skips to the next token in "S" (or to the end of the        */
+/*              input) in one call of "SkipTo" (see "tokarray.h"), and      */
+/*              counts the tokens skipped, with the phase of the CONTEXT    */
+/*              set to error recovery meanwhile.                            */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void SkipTokens(CONTEXT *ctx, SET *S)
+{
+    long skipped;
+    int was;
+
+    EnterPhase(ctx, was, PHASE_RECOVER);
+    skipped = SkipTo(ctx->lookahead, S);
+    ctx->tokens += skipped;
+    ctx->skipped += skipped;
+    LeavePhase(ctx, was);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -1290,10 +2215,10 @@ PRIVATE void Accept(int ExpectedToken)
 /*  OpenFiles:  Reads strings from the command-line and opens the           */
 /*              associated input and listing files.                         */
 /*                                                                          */
-/*    Note that this routine mmodifies the globals "InputFile" and          */
-/*    "ListingFile".  It returns 1 ("true" in C-speak) if the input and     */
-/*    listing files are successfully opened, 0 if not, allowing the caller  */
-/*    to make a graceful exit if the opening process failed.                */
+/*    Note that this routine mmodifies "InputFile" and "ListFile" in the    */
+/*    CONTEXT.  It returns 1 ("true" in C-speak) if the input and listing   */
+/*    files are successfully opened, 0 if not, allowing the caller to make  */
+/*    a graceful exit if the opening process failed.                        */
 /*                                                                          */
 /*                                                                          */
 /*    Inputs:       1) Integer argument count (standard C "argc").          */
@@ -1304,36 +2229,39 @@ PRIVATE void Accept(int ExpectedToken)
 /*                                                                          */
 /*    Returns:      Boolean success flag (i.e., an "int":  1 or 0)          */
 /*                                                                          */
-/*    Side Effects: If successful, modifies globals "InputFile" and         */
-/*                  "ListingFile".                                          */
+/*    Side Effects: If successful, sets "InputFile", "ListFile" and         */
+/*                  "CodeFile" in the CONTEXT.                              */
 /*                                                                          */
 /*--------------------------------------------------------------------------*/
 
-PRIVATE int OpenFiles(int argc, char *argv[])
+PRIVATE int OpenFiles(CONTEXT *ctx, int argc, char *argv[])
 {
 
     if (argc != 4)
     {
         fprintf(stderr, "%s <inputfile> <listfile> <CodeFile>\n", argv[0]);
+        fprintf(stderr, "%s [-r] [-O] [-s] [-o <objectfile>] [-j[<threads>]] [-p] [-c[<megabytes>] <cachedir>] [--stats[=<jsonfile>]] <inputfile> <listfile> <CodeFile>\n", argv[0]);
+        fprintf(stderr, "%s -b [-j<threads>] <manifest|directory> [<outdir>]\n", argv[0]);
+        fprintf(stderr, "%s -d [-j<threads>] <socket>\n", argv[0]);
         return 0;
     }
 
-    if (NULL == (InputFile = fopen(argv[1], "r")))
+    if (NULL == (ctx->InputFile = fopen(argv[1], "r")))
     {
         fprintf(stderr, "cannot open \"%s\" for input\n", argv[1]);
         return 0;
     }
 
-    if (NULL == (ListFile = fopen(argv[2], "w")))
+    if (NULL == (ctx->ListFile = fopen(argv[2], "w")))
     {
         fprintf(stderr, "cannot open \"%s\" for output\n", argv[2]);
-        fclose(InputFile);
+        fclose(ctx->InputFile);
         return 0;
     }
-    if (NULL == (CodeFile = fopen(argv[3], "w")))
+    if (NULL == (ctx->CodeFile = fopen(argv[3], "w")))
     {
         fprintf(stderr, "cannot open \"%s\" for output\n", argv[2]);
-        fclose(InputFile);
+        fclose(ctx->InputFile);
         return 0;
     }
 
@@ -1361,20 +2289,43 @@ PRIVATE int OpenFiles(int argc, char *argv[])
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void SetupSets(void)
+PRIVATE void SetupSets(CONTEXT *ctx)
 {
     /* init for Program */
     /* SET 1 */
-    InitSet(&DeclarationFS_aug, 3, VAR, PROCEDURE, BEGIN);
+    ClearSet(&ctx->DeclarationFS_aug);
+    AddElement(&ctx->DeclarationFS_aug, VAR);
+    AddElement(&ctx->DeclarationFS_aug, PROCEDURE);
+    AddElement(&ctx->DeclarationFS_aug, BEGIN);
     /* SET 2 */
-    InitSet(&ProcDeclarationFS_aug, 2, PROCEDURE, BEGIN);
+    ClearSet(&ctx->ProcDeclarationFS_aug);
+    AddElement(&ctx->ProcDeclarationFS_aug, PROCEDURE);
+    AddElement(&ctx->ProcDeclarationFS_aug, BEGIN);
 
-    InitSet(&ProcDeclarationFBS, 3, ENDOFINPUT, ENDOFPROGRAM, END);
+    ClearSet(&ctx->ProcDeclarationFBS);
+    AddElement(&ctx->ProcDeclarationFBS, ENDOFINPUT);
+    AddElement(&ctx->ProcDeclarationFBS, ENDOFPROGRAM);
+    AddElement(&ctx->ProcDeclarationFBS, END);
 
     /* Init for statement found in block*/
-    InitSet(&StatementFS_aug, 6, IDENTIFIER, WHILE, IF, READ, WRITE, END);
-
-    InitSet(&StatementFBS, 4, SEMICOLON, ELSE, ENDOFPROGRAM, ENDOFINPUT);
+    ClearSet(&ctx->StatementFS_aug);
+    AddElement(&ctx->StatementFS_aug, IDENTIFIER);
+    AddElement(&ctx->StatementFS_aug, WHILE);
+    AddElement(&ctx->StatementFS_aug, IF);
+    AddElement(&ctx->StatementFS_aug, READ);
+    AddElement(&ctx->StatementFS_aug, WRITE);
+    AddElement(&ctx->StatementFS_aug, END);
+
+    ClearSet(&ctx->StatementFBS);
+    AddElement(&ctx->StatementFBS, SEMICOLON);
+    AddElement(&ctx->StatementFBS, ELSE);
+    AddElement(&ctx->StatementFBS, ENDOFPROGRAM);
+    AddElement(&ctx->StatementFBS, ENDOFINPUT);
+
+    /* the sets Synchronise skips to, formed once here */
+    SetUnion(&ctx->DeclarationSync, &ctx->DeclarationFS_aug, &ctx->ProcDeclarationFBS);
+    SetUnion(&ctx->ProcDeclarationSync, &ctx->ProcDeclarationFS_aug, &ctx->ProcDeclarationFBS);
+    SetUnion(&ctx->StatementSync, &ctx->StatementFS_aug, &ctx->StatementFBS);
 }
 
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -1391,28 +2342,24 @@ PRIVATE void SetupSets(void)
 /*                                                                                                              */
 /*      Inputs:       Takes 2 sets declared in SetupSets                                                        */
 /*                    1) Augmented first set                                                                    */
-/*                    2) Follow U Beacons                                                                       */
+/*                    2) Augmented first set U Follow U Beacons, formed once by SetupSets                       */
 /*                                                                                                              */
 /*      Outputs:      None                                                                                      */
 /*                                                                                                              */
 /*      Returns:      Nothing                                                                                   */
 /*                                                                                                              */
-/*      Side Effects: Skips tokens until token within set is matched                                            */
+/*      Side Effects: Skips tokens until token within set is matched (see SkipTokens)                           */
 /*                                                                                                              */
 /*--------------------------------------------------------------------------------------------------------------*/
 
-PRIVATE void Synchronise(SET *F, SET *FB)
+PRIVATE void Synchronise(CONTEXT *ctx, SET *F, SET *S)
 {
 
-    SET S;
-    S = Union(2, F, FB);
-    if (!InSet(F, CurrentToken.code))
+    if (!InSet(F, CurrentCode(ctx->lookahead)))
     {
-        SyntaxError2(*F, CurrentToken);
-        while (!InSet(&S, CurrentToken.code))
-        {
-            CurrentToken = GetToken();
-        }
+        SyntaxError2(ctx, *F, PeekToken(ctx->lookahead, 0));
+        ctx->recoveries++;
+        SkipTokens(ctx, S);
     }
 }
 
@@ -1441,33 +2388,26 @@ PRIVATE void Synchronise(SET *F, SET *FB)
 /*                                                                          */
 /*--------------------------------------------------------------------------*/
 
-PRIVATE SYMBOL *MakeSymbolTableEntry(int symtype, int *varaddress)
+PRIVATE SYMBOL *MakeSymbolTableEntry(CONTEXT *ctx, int symtype, int *varaddress)
 {
 
     SYMBOL *oldsptr, *newsptr = NULL;
-    char *cptr;
-    int hashindex;
 
-    if (CurrentToken.code == IDENTIFIER)
+    if (CurrentCode(ctx->lookahead) == IDENTIFIER)
     {
-        if (NULL == (oldsptr = Probe(CurrentToken.s, &hashindex)) || oldsptr->scope < scope)
+        if (NULL == (oldsptr = Probe(ctx, CurrentAtom(ctx->lookahead))) || oldsptr->scope < ctx->scope)
         {
 
-            if (oldsptr == NULL)
-                cptr = CurrentToken.s;
-            else
-                cptr = oldsptr->s;
-            if (NULL == (newsptr = EnterSymbol(cptr, hashindex)))
+            if (NULL == (newsptr = EnterSymbol(ctx, CurrentAtom(ctx->lookahead))))
             {
-                printf("Error: SYMBOL ENTRY FAILED\n");
-                KillCodeGeneration();
+                if (!ctx->speculative && !ctx->quiet)
+                    printf("Error: SYMBOL ENTRY FAILED\n");
+                KillCodeGeneration(ctx);
             }
             else
             {
 
-                if (oldsptr == NULL)
-                    PreserveString();
-                newsptr->scope = scope;
+                newsptr->scope = ctx->scope;
                 newsptr->type = symtype;
                 if (symtype == STYPE_VARIABLE || symtype == STYPE_LOCALVAR || symtype == STYPE_REFPAR)
                 {
@@ -1476,14 +2416,13 @@ PRIVATE SYMBOL *MakeSymbolTableEntry(int symtype, int *varaddress)
                 }
                 else
                     newsptr->address = -1;
-                hashindex++;
             }
         }
         else
         {
 
-            Error("ERROR IN SYMBOL CREATION :::::", CurrentToken.pos);
-            KillCodeGeneration();
+            Error(ctx, "ERROR IN SYMBOL CREATION :::::", CurrentPos(ctx->lookahead));
+            KillCodeGeneration(ctx);
         }
     }
     return newsptr;
@@ -1513,16 +2452,16 @@ PRIVATE SYMBOL *MakeSymbolTableEntry(int symtype, int *varaddress)
 /*                                                                          */
 /*--------------------------------------------------------------------------*/
 
-PRIVATE SYMBOL *LookupSymbol(void)
+PRIVATE SYMBOL *LookupSymbol(CONTEXT *ctx)
 {
     SYMBOL *sptr;
-    if (CurrentToken.code == IDENTIFIER)
+    if (CurrentCode(ctx->lookahead) == IDENTIFIER)
     {
-        sptr = Probe(CurrentToken.s, NULL);
+        sptr = Probe(ctx, CurrentAtom(ctx->lookahead));
         if (sptr == NULL)
         {
-            Error("Identifier not declared", CurrentToken.pos);
-            KillCodeGeneration();
+            Error(ctx, "Identifier not declared", CurrentPos(ctx->lookahead));
+            KillCodeGeneration(ctx);
         }
     }
     else
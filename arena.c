@@ -0,0 +1,182 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      arena.c                                                              */
+/*                                                                           */
+/*      Arena allocator for the CPL compiler.  Memory is handed out by       */
+/*      bumping a pointer through large blocks got from malloc, and is only  */
+/*      given back in bulk: "ArenaRelease" drops everything allocated since  */
+/*      a mark, in time proportional to the blocks emptied, and              */
+/*      "FreeArena" drops the lot.  Emptied blocks are kept for reuse, so a  */
+/*      scope that is entered and left many times does not call malloc.      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "global.h"
+#include "arena.h"
+
+typedef union  {                        /* strictest alignment needed        */
+    long   l;
+    double d;
+    void   *p;
+}
+    ALIGN;
+
+#define  ROUND_UP(n)  ( ( (n) + sizeof( ALIGN ) - 1 ) / sizeof( ALIGN ) * sizeof( ALIGN ) )
+
+typedef struct block  {
+    struct block *next;                 /* older block (or next spare)       */
+    size_t size;                        /* bytes of data                     */
+    size_t used;                        /* bytes of data handed out          */
+    ALIGN  data[1];                     /* data starts here                  */
+}
+    BLOCK;
+
+#define  BLOCK_HEADER  ( offsetof( BLOCK, data ) )
+#define  DATA(b)       ( (char *) (b)->data )
+
+struct arena  {
+    BLOCK      *Blocks;                 /* block being filled, then older    */
+    BLOCK      *Spare;                  /* emptied blocks                    */
+    size_t     BlockSize;
+    ARENASTATS Stats;
+};
+
+PRIVATE BLOCK *NewBlock( ARENA *arena, size_t size );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      MakeArena / FreeArena: create an empty arena whose blocks hold       */
+/*      "blocksize" bytes (more for a larger single allocation), and         */
+/*      release one together with everything allocated from it.              */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC ARENA *MakeArena( size_t blocksize )
+{
+    ARENA *arena;
+
+    if ( NULL == ( arena = calloc( 1, sizeof( ARENA ) ) ) )  {
+        fprintf( stderr, "Fatal Error: MakeArena: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    arena->BlockSize = ROUND_UP( blocksize );
+    return arena;
+}
+
+PUBLIC void FreeArena( ARENA *arena )
+{
+    BLOCK *b;
+
+    if ( arena != NULL )  {
+        ArenaRelease( arena, NULL );
+        while ( NULL != ( b = arena->Spare ) )  {
+            arena->Spare = b->next;
+            free( b );
+        }
+        free( arena );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ArenaAlloc: "size" bytes, suitably aligned for any object, or NULL   */
+/*      if no memory is available.  The memory is not cleared.               */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void *ArenaAlloc( ARENA *arena, size_t size )
+{
+    BLOCK *b = arena->Blocks;
+    void *p;
+
+    size = ROUND_UP( size );
+    if ( b == NULL || b->size - b->used < size )  {
+        if ( NULL == ( b = NewBlock( arena, size ) ) )  return NULL;
+    }
+    p = DATA( b ) + b->used;
+    b->used += size;
+    arena->Stats.Allocations++;
+    arena->Stats.Bytes += (long) size;
+    arena->Stats.InUse += (long) size;
+    if ( arena->Stats.InUse > arena->Stats.Peak )  arena->Stats.Peak = arena->Stats.InUse;
+    return p;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ArenaMark: the arena's current position, for a later ArenaRelease.   */
+/*                                                                           */
+/*      ArenaRelease: give back everything allocated since "mark", which is  */
+/*      either a value of ArenaMark or a pointer returned by ArenaAlloc (in  */
+/*      which case that allocation goes too).  Marks must be released in     */
+/*      the reverse of the order they were made in; a NULL mark releases     */
+/*      everything.                                                          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void *ArenaMark( ARENA *arena )
+{
+    return arena->Blocks == NULL ? NULL : DATA( arena->Blocks ) + arena->Blocks->used;
+}
+
+PUBLIC void ArenaRelease( ARENA *arena, void *mark )
+{
+    BLOCK *b;
+    char *m = mark;
+
+    while ( NULL != ( b = arena->Blocks ) &&
+            ( m == NULL || m < DATA( b ) || m > DATA( b ) + b->used ) )  {
+        arena->Stats.InUse -= (long) b->used;
+        b->used = 0;
+        arena->Blocks = b->next;
+        b->next = arena->Spare;
+        arena->Spare = b;
+    }
+    if ( b != NULL )  {
+        arena->Stats.InUse -= (long) ( DATA( b ) + b->used - m );
+        b->used = (size_t) ( m - DATA( b ) );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetArenaStats: copy the allocation statistics of "arena" (see        */
+/*      ARENASTATS) into "stats".                                            */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void GetArenaStats( ARENA *arena, ARENASTATS *stats )
+{
+    *stats = arena->Stats;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  Start filling a block with room for "size" bytes: a spare one if it is   */
+/*  big enough, else a new one.  What is left of the old block is wasted.    */
+
+PRIVATE BLOCK *NewBlock( ARENA *arena, size_t size )
+{
+    BLOCK *b, **link;
+
+    for ( link = &arena->Spare; *link != NULL; link = &( *link )->next )
+        if ( ( *link )->size >= size )  break;
+    if ( NULL != ( b = *link ) )  *link = b->next;
+    else  {
+        if ( size < arena->BlockSize )  size = arena->BlockSize;
+        if ( NULL == ( b = malloc( BLOCK_HEADER + size ) ) )  return NULL;
+        b->size = size;
+        arena->Stats.Blocks++;
+        arena->Stats.Reserved += (long) size;
+    }
+    b->used = 0;
+    b->next = arena->Blocks;
+    arena->Blocks = b;
+    return b;
+}
@@ -0,0 +1,388 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      batch.c                                                              */
+/*                                                                           */
+/*      Batch compilation driver.  The units of a batch are split into one   */
+/*      contiguous run per worker thread.  A worker takes units from the     */
+/*      front of its own run; once that is empty it steals the back half of  */
+/*      another worker's run, so a few large sources cannot leave the other  */
+/*      threads idle.  The units are compiled by the caller's BATCHCOMPILER  */
+/*      and reported in batch order once every worker has finished.          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "global.h"
+#include "batch.h"
+
+#define  MAX_THREADS        256     /* upper limit on the pool size          */
+#define  MAX_MANIFEST_LINE  4096    /* longest path accepted in a manifest   */
+#define  SOURCE_SUFFIX      ".prog"
+#define  LIST_SUFFIX        ".lst"  /* not ".errs": tests/ has sources so    */
+                                    /* named                                 */
+#define  CODE_SUFFIX        ".asm"
+
+typedef struct pool  POOL;
+
+typedef struct  {
+    pthread_t       Thread;
+    pthread_mutex_t Lock;           /* guards Top, Bottom and Steals         */
+    int             Top;            /* next unit this worker will compile    */
+    int             Bottom;         /* one past the last unit in its run     */
+    long            Steals;         /* runs taken from other workers         */
+    int             Id;
+    POOL            *Pool;
+}
+    WORKER;
+
+struct pool  {
+    BATCHUNIT       *Units;
+    int             UnitCount;
+    int             UnitCapacity;
+    WORKER          *Workers;
+    int             WorkerCount;
+    BATCHCOMPILER   Compile;
+};
+
+PRIVATE int    GetUnits( POOL *pool, char *source, char *outdir );
+PRIVATE int    ReadDirectory( POOL *pool, char *dirname, char *outdir );
+PRIVATE int    ReadManifest( POOL *pool, char *filename, char *outdir );
+PRIVATE void   AddUnit( POOL *pool, char *inputname, char *outdir );
+PRIVATE char   *OutputName( char *outdir, char *base, int length, char *suffix );
+PRIVATE int    CompareUnits( const void *a, const void *b );
+PRIVATE void   RunPool( POOL *pool, int threads );
+PRIVATE void   *Work( void *arg );
+PRIVATE int    NextUnit( WORKER *self );
+PRIVATE int    Steal( WORKER *self );
+PRIVATE int    CoreCount( void );
+PRIVATE double Elapsed( struct timespec *start );
+PRIVATE void   *Allocate( size_t size );
+PRIVATE void   FreeUnits( POOL *pool );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      CompileBatch: entry point for "comp -b".  The arguments are          */
+/*                                                                           */
+/*          -b [-j<threads>] <manifest|directory> [<outdir>]                 */
+/*                                                                           */
+/*      The ".lst" and ".asm" files of a unit are written beside its         */
+/*      source, or into <outdir> if one is given.  The pool has one thread   */
+/*      per online core unless "-j" says otherwise.  Units with errors are   */
+/*      listed on stdout, followed by the totals and the throughput.         */
+/*      Returns EXIT_FAILURE if the batch could not be read or any unit      */
+/*      could not be compiled, otherwise EXIT_SUCCESS.                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int CompileBatch( int argc, char *argv[], BATCHCOMPILER compile )
+{
+    POOL pool;
+    struct timespec start;
+    char *outdir = NULL;
+    int arg = 2, threads = 0, i, count[3];
+    long bytes = 0, steals = 0;
+    double seconds;
+
+    if ( arg < argc && 0 == strncmp( argv[arg], "-j", 2 ) )  {
+        if ( ( threads = atoi( argv[arg] + 2 ) ) < 1 )  threads = -1;
+        else if ( threads > MAX_THREADS )  threads = MAX_THREADS;
+        arg++;
+    }
+    if ( threads < 0 || argc - arg < 1 || argc - arg > 2 )  {
+        fprintf( stderr, "%s -b [-j<threads>] <manifest|directory> [<outdir>]\n",
+                 argv[0] );
+        return EXIT_FAILURE;
+    }
+    if ( argc - arg == 2 )  outdir = argv[arg+1];
+
+    memset( &pool, 0, sizeof( pool ) );
+    pool.Compile = compile;
+    if ( !GetUnits( &pool, argv[arg], outdir ) )  {
+        FreeUnits( &pool );
+        return EXIT_FAILURE;
+    }
+    if ( pool.UnitCount == 0 )  {
+        fprintf( stderr, "no source files in \"%s\"\n", argv[arg] );
+        FreeUnits( &pool );
+        return EXIT_FAILURE;
+    }
+    if ( threads == 0 )  threads = CoreCount();
+    if ( threads > pool.UnitCount )  threads = pool.UnitCount;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    RunPool( &pool, threads );
+    seconds = Elapsed( &start );
+
+    count[BATCH_VALID] = count[BATCH_INVALID] = count[BATCH_FAILED] = 0;
+    for ( i = 0; i < pool.UnitCount; i++ )  {
+        count[pool.Units[i].Status]++;
+        bytes += pool.Units[i].Size;
+        if ( pool.Units[i].Status == BATCH_INVALID )
+            printf( "%s: SYNTAX INVALID\n", pool.Units[i].InputName );
+        else if ( pool.Units[i].Status == BATCH_FAILED )
+            printf( "%s: not compiled\n", pool.Units[i].InputName );
+    }
+    for ( i = 0; i < pool.WorkerCount; i++ )  steals += pool.Workers[i].Steals;
+    printf( "%d units (%d valid, %d invalid, %d failed) on %d threads, %ld steals\n",
+            pool.UnitCount, count[BATCH_VALID], count[BATCH_INVALID],
+            count[BATCH_FAILED], pool.WorkerCount, steals );
+    printf( "%ld bytes in %.3fs: %.1f units/sec, %.1f KB/sec\n", bytes, seconds,
+            seconds > 0.0 ? pool.UnitCount / seconds : 0.0,
+            seconds > 0.0 ? bytes / 1024.0 / seconds : 0.0 );
+
+    FreeUnits( &pool );
+    return count[BATCH_FAILED] == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE int GetUnits( POOL *pool, char *source, char *outdir )
+{
+    struct stat sb;
+
+    if ( 0 != stat( source, &sb ) )  {
+        fprintf( stderr, "cannot open \"%s\" for input\n", source );
+        return 0;
+    }
+    if ( S_ISDIR( sb.st_mode ) )  return ReadDirectory( pool, source, outdir );
+    else  return ReadManifest( pool, source, outdir );
+}
+
+/*  Every "*.prog" file in the directory, sorted by name so that the order   */
+/*  of the report does not depend on the file system.                        */
+
+PRIVATE int ReadDirectory( POOL *pool, char *dirname, char *outdir )
+{
+    DIR *dir;
+    struct dirent *entry;
+    char *path;
+    size_t length, suffix = strlen( SOURCE_SUFFIX );
+
+    if ( NULL == ( dir = opendir( dirname ) ) )  {
+        fprintf( stderr, "cannot open \"%s\" for input\n", dirname );
+        return 0;
+    }
+    while ( NULL != ( entry = readdir( dir ) ) )  {
+        length = strlen( entry->d_name );
+        if ( length > suffix &&
+             0 == strcmp( entry->d_name + length - suffix, SOURCE_SUFFIX ) )  {
+            path = Allocate( strlen( dirname ) + length + 2 );
+            sprintf( path, "%s/%s", dirname, entry->d_name );
+            AddUnit( pool, path, outdir );
+            free( path );
+        }
+    }
+    closedir( dir );
+    qsort( pool->Units, pool->UnitCount, sizeof( BATCHUNIT ), CompareUnits );
+    return 1;
+}
+
+/*  One source file per line.  Leading and trailing blanks are ignored, as   */
+/*  are empty lines and lines starting with '#'.                             */
+
+PRIVATE int ReadManifest( POOL *pool, char *filename, char *outdir )
+{
+    FILE *fp;
+    char line[MAX_MANIFEST_LINE], *p, *end;
+
+    if ( NULL == ( fp = fopen( filename, "r" ) ) )  {
+        fprintf( stderr, "cannot open \"%s\" for input\n", filename );
+        return 0;
+    }
+    while ( NULL != fgets( line, sizeof( line ), fp ) )  {
+        for ( p = line; *p == ' ' || *p == '\t'; p++ )  ;
+        end = p + strlen( p );
+        while ( end > p && ( end[-1] == '\n' || end[-1] == '\r' ||
+                             end[-1] == ' ' || end[-1] == '\t' ) )  end--;
+        *end = '\0';
+        if ( *p != '\0' && *p != '#' )  AddUnit( pool, p, outdir );
+    }
+    fclose( fp );
+    return 1;
+}
+
+PRIVATE void AddUnit( POOL *pool, char *inputname, char *outdir )
+{
+    BATCHUNIT *unit;
+    struct stat sb;
+    char *base = inputname;
+    int length;
+
+    if ( pool->UnitCount == pool->UnitCapacity )  {
+        pool->UnitCapacity = pool->UnitCapacity == 0 ? 64 : 2 * pool->UnitCapacity;
+        if ( NULL == ( unit = realloc( pool->Units,
+                                       pool->UnitCapacity * sizeof( BATCHUNIT ) ) ) )  {
+            fprintf( stderr, "Fatal Error: CompileBatch: out of memory\n" );
+            exit( EXIT_FAILURE );
+        }
+        pool->Units = unit;
+    }
+    if ( outdir != NULL && NULL != strrchr( inputname, '/' ) )
+        base = strrchr( inputname, '/' ) + 1;
+    length = (int) strlen( base );
+    if ( length > (int) strlen( SOURCE_SUFFIX ) &&
+         0 == strcmp( base + length - strlen( SOURCE_SUFFIX ), SOURCE_SUFFIX ) )
+        length -= (int) strlen( SOURCE_SUFFIX );
+
+    unit = &pool->Units[pool->UnitCount++];
+    unit->InputName = OutputName( NULL, inputname, (int) strlen( inputname ), "" );
+    unit->ListName = OutputName( outdir, base, length, LIST_SUFFIX );
+    unit->CodeName = OutputName( outdir, base, length, CODE_SUFFIX );
+    unit->Size = 0 == stat( inputname, &sb ) ? (long) sb.st_size : 0L;
+    unit->Status = BATCH_FAILED;
+}
+
+PRIVATE char *OutputName( char *outdir, char *base, int length, char *suffix )
+{
+    char *name;
+
+    if ( outdir == NULL )  {
+        name = Allocate( length + strlen( suffix ) + 1 );
+        sprintf( name, "%.*s%s", length, base, suffix );
+    }
+    else  {
+        name = Allocate( strlen( outdir ) + length + strlen( suffix ) + 2 );
+        sprintf( name, "%s/%.*s%s", outdir, length, base, suffix );
+    }
+    return name;
+}
+
+PRIVATE int CompareUnits( const void *a, const void *b )
+{
+    return strcmp( ( (BATCHUNIT *) a )->InputName, ( (BATCHUNIT *) b )->InputName );
+}
+
+/*  The calling thread is worker 0.  If a thread cannot be started its run   */
+/*  is simply stolen by the workers that were.                               */
+
+PRIVATE void RunPool( POOL *pool, int threads )
+{
+    WORKER *w;
+    int i;
+
+    pool->Workers = Allocate( threads * sizeof( WORKER ) );
+    pool->WorkerCount = threads;
+    for ( i = 0; i < threads; i++ )  {
+        w = &pool->Workers[i];
+        pthread_mutex_init( &w->Lock, NULL );
+        w->Top = (int) ( (long) pool->UnitCount * i / threads );
+        w->Bottom = (int) ( (long) pool->UnitCount * ( i + 1 ) / threads );
+        w->Steals = 0;
+        w->Id = i;
+        w->Pool = pool;
+    }
+    for ( i = 1; i < threads; i++ )
+        if ( 0 != pthread_create( &pool->Workers[i].Thread, NULL, Work,
+                                  &pool->Workers[i] ) )
+            pool->Workers[i].Id = -1;
+    Work( &pool->Workers[0] );
+    for ( i = 1; i < threads; i++ )
+        if ( pool->Workers[i].Id != -1 )  pthread_join( pool->Workers[i].Thread, NULL );
+    for ( i = 0; i < threads; i++ )  pthread_mutex_destroy( &pool->Workers[i].Lock );
+}
+
+PRIVATE void *Work( void *arg )
+{
+    WORKER *self = arg;
+    BATCHUNIT *unit;
+    int i;
+
+    while ( -1 != ( i = NextUnit( self ) ) )  {
+        unit = &self->Pool->Units[i];
+        unit->Status = self->Pool->Compile( unit );
+    }
+    return NULL;
+}
+
+PRIVATE int NextUnit( WORKER *self )
+{
+    int i = -1;
+
+    pthread_mutex_lock( &self->Lock );
+    if ( self->Top < self->Bottom )  i = self->Top++;
+    pthread_mutex_unlock( &self->Lock );
+    return i != -1 ? i : Steal( self );
+}
+
+/*  Units are never added once the pool is running, so a worker that finds   */
+/*  every other run empty can stop: whatever is left is already being        */
+/*  compiled by somebody.                                                    */
+
+PRIVATE int Steal( WORKER *self )
+{
+    POOL *pool = self->Pool;
+    WORKER *victim;
+    int n, half, top, bottom;
+
+    for ( n = 1; n < pool->WorkerCount; n++ )  {
+        victim = &pool->Workers[( self->Id + n ) % pool->WorkerCount];
+        pthread_mutex_lock( &victim->Lock );
+        bottom = victim->Bottom;
+        half = ( victim->Bottom - victim->Top + 1 ) / 2;
+        top = victim->Bottom -= half;
+        pthread_mutex_unlock( &victim->Lock );
+        if ( half > 0 )  {
+            pthread_mutex_lock( &self->Lock );
+            self->Top = top + 1;
+            self->Bottom = bottom;
+            self->Steals++;
+            pthread_mutex_unlock( &self->Lock );
+            return top;
+        }
+    }
+    return -1;
+}
+
+PRIVATE int CoreCount( void )
+{
+    long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+    if ( n < 1 )  return 1;
+    return n > MAX_THREADS ? MAX_THREADS : (int) n;
+}
+
+PRIVATE double Elapsed( struct timespec *start )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (double) ( now.tv_sec - start->tv_sec ) +
+           (double) ( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
+
+PRIVATE void *Allocate( size_t size )
+{
+    void *p;
+
+    if ( NULL == ( p = malloc( size ) ) )  {
+        fprintf( stderr, "Fatal Error: CompileBatch: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    return p;
+}
+
+PRIVATE void FreeUnits( POOL *pool )
+{
+    int i;
+
+    for ( i = 0; i < pool->UnitCount; i++ )  {
+        free( pool->Units[i].InputName );
+        free( pool->Units[i].ListName );
+        free( pool->Units[i].CodeName );
+    }
+    free( pool->Units );
+    free( pool->Workers );
+}
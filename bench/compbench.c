@@ -0,0 +1,250 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      compbench.c                                                          */
+/*                                                                           */
+/*      Compiler benchmark suite.  Usage:                                    */
+/*                                                                           */
+/*          compbench [-c compiler] [-g generator] [-d directory]            */
+/*                    [-k scale] [-n runs] [-o results] [-b baseline]        */
+/*                                                                           */
+/*      For each program shape in "Shapes" writes a program with the         */
+/*      generator (default "bench/cplgen", see "cplgen.c"), its outer        */
+/*      procedures multiplied by "scale" (default 1), and compiles it        */
+/*      "runs" times (default 3) with "compiler --stats=..." (default        */
+/*      "./comp").  From the run that took least CPU time it reports the     */
+/*      tokens/sec and lines/sec (of CPU time), the peak RSS, the            */
+/*      instructions emitted and the CPU time of each phase.  A shape        */
+/*      generated with errors must give an invalid program, the others a     */
+/*      valid one.                                                           */
+/*                                                                           */
+/*      "-o" appends the figures to "results", one line of JSON per shape,   */
+/*      and "-b" compares them with those in "baseline", a results file of   */
+/*      an earlier run, so a change to the scanner, the symbol table or the  */
+/*      code generator can be judged against the compiler before it.  The    */
+/*      files are made in "directory" (default ".") and removed afterwards.  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+
+#define  MAX_PATH    4096
+#define  MAX_LINE    4096           /* of JSON                               */
+
+typedef struct  {
+    char *Name;
+    int  Procedures;                /* outer procedures, times the scale     */
+    char *Options;                  /* the rest of the generator's options   */
+    int  Valid;                     /* the program should be valid           */
+}
+    SHAPE;
+
+PRIVATE SHAPE Shapes[] =  {
+    { "flat",     400, "-n 1 -v 8 -e 2 -s 40 -l 10",         1 },
+    { "deep",      40, "-n 16 -v 4 -e 2 -s 20 -l 10",        1 },
+    { "wide",     100, "-n 2 -v 200 -e 2 -s 40 -l 10",       1 },
+    { "exprs",    100, "-n 1 -v 8 -e 7 -s 40 -l 5",          1 },
+    { "loops",     80, "-n 2 -v 8 -e 2 -s 20 -l 40",         1 },
+    { "errors",   200, "-n 2 -v 8 -e 2 -s 40 -l 10 -x 0.1",  0 }
+};
+
+#define  SHAPES  ( (int) ( sizeof( Shapes ) / sizeof( Shapes[0] ) ) )
+
+typedef struct  {
+    double Cpu;                     /* seconds                               */
+    double PhaseCpu[4];             /* scan, parse, symbols, write           */
+    long   Lines;
+    long   Tokens;
+    long   PeakRSS;                 /* kilobytes                             */
+    long   Instructions;
+    int    Valid;
+}
+    RESULT;
+
+PRIVATE char *Phases[4] = { "scan", "parse", "symbols", "write" };
+
+PRIVATE void   Usage( char *name );
+PRIVATE int    Compile( char *command, char *jsonname, RESULT *result );
+PRIVATE double Field( char *json, char *object, char *key );
+PRIVATE int    Baseline( char *filename, char *shape, double *tokenrate, long *rss );
+PRIVATE double Rate( long count, double seconds );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    char *comp = "./comp", *gen = "bench/cplgen", *dir = ".";
+    char *resultsname = NULL, *basename = NULL;
+    char progname[MAX_PATH], listname[MAX_PATH], codename[MAX_PATH];
+    char jsonname[MAX_PATH], errname[MAX_PATH], command[6 * MAX_PATH + 128];
+    RESULT best, result;
+    FILE *results = NULL;
+    double baserate;
+    long baserss;
+    int scale = 1, runs = 3, s, r, p, failed = 0;
+
+    for ( r = 1; r + 1 < argc; r += 2 )  {
+        if ( argv[r][0] != '-' || argv[r][1] == '\0' || argv[r][2] != '\0' )  Usage( argv[0] );
+        switch ( argv[r][1] )  {
+            case 'c':  comp = argv[r + 1];                 break;
+            case 'g':  gen = argv[r + 1];                  break;
+            case 'd':  dir = argv[r + 1];                  break;
+            case 'k':  scale = atoi( argv[r + 1] );        break;
+            case 'n':  runs = atoi( argv[r + 1] );         break;
+            case 'o':  resultsname = argv[r + 1];          break;
+            case 'b':  basename = argv[r + 1];             break;
+            default:   Usage( argv[0] );
+        }
+    }
+    if ( r < argc )  Usage( argv[0] );
+    if ( scale < 1 )  scale = 1;
+    if ( runs < 1 )  runs = 1;
+    if ( strlen( dir ) + 16 > MAX_PATH || strlen( comp ) > MAX_PATH || strlen( gen ) > MAX_PATH )  {
+        fprintf( stderr, "%s: name too long\n", argv[0] );
+        exit( EXIT_FAILURE );
+    }
+    if ( resultsname != NULL && NULL == ( results = fopen( resultsname, "a" ) ) )  {
+        fprintf( stderr, "%s: cannot open \"%s\"\n", argv[0], resultsname );
+        exit( EXIT_FAILURE );
+    }
+    sprintf( progname, "%s/compbench.prog", dir );
+    sprintf( listname, "%s/compbench.lst", dir );
+    sprintf( codename, "%s/compbench.code", dir );
+    sprintf( jsonname, "%s/compbench.json", dir );
+    sprintf( errname, "%s/compbench.err", dir );
+
+    printf( "shape       lines    tokens  Ktok/s  Klines/s  RSS KB  instructions"
+            "   scan  parse   syms  write (cpu ms)\n" );
+    for ( s = 0; s < SHAPES; s++ )  {
+        sprintf( command, "%s -p %d %s %s 2>%s", gen, Shapes[s].Procedures * scale,
+                 Shapes[s].Options, progname, errname );
+        if ( 0 != system( command ) )  {
+            fprintf( stderr, "%s: \"%s\" failed\n", argv[0], command );
+            exit( EXIT_FAILURE );
+        }
+        sprintf( command, "%s --stats=%s %s %s %s >/dev/null 2>%s",
+                 comp, jsonname, progname, listname, codename, errname );
+        for ( r = 0; r < runs; r++ )  {
+            if ( !Compile( command, jsonname, &result ) )  {
+                fprintf( stderr, "%s: \"%s\" failed\n", argv[0], command );
+                exit( EXIT_FAILURE );
+            }
+            if ( r == 0 || result.Cpu < best.Cpu )  best = result;
+        }
+
+        printf( "%-8s %8ld %9ld %7.0f %9.0f %7ld %13ld", Shapes[s].Name, best.Lines, best.Tokens,
+                Rate( best.Tokens, best.Cpu ) / 1000.0, Rate( best.Lines, best.Cpu ) / 1000.0,
+                best.PeakRSS, best.Instructions );
+        for ( p = 0; p < 4; p++ )  printf( " %6.1f", 1000.0 * best.PhaseCpu[p] );
+        if ( best.Valid != Shapes[s].Valid )  {
+            printf( "  %s, expected %s", best.Valid ? "VALID" : "INVALID",
+                    Shapes[s].Valid ? "valid" : "invalid" );
+            failed = 1;
+        }
+        putchar( '\n' );
+        if ( basename != NULL && Baseline( basename, Shapes[s].Name, &baserate, &baserss ) )  {
+            printf( "%-8s %18s %7.2fx %9s %6.2fx\n", "", "vs baseline",
+                    baserate > 0.0 ? Rate( best.Tokens, best.Cpu ) / baserate : 0.0, "",
+                    baserss > 0 ? (double) best.PeakRSS / baserss : 0.0 );
+        }
+        if ( results != NULL )  {
+            fprintf( results, "{\"shape\":\"%s\",\"scale\":%d,\"lines\":%ld,\"tokens\":%ld,",
+                     Shapes[s].Name, scale, best.Lines, best.Tokens );
+            fprintf( results, "\"tokens_per_sec\":%.0f,\"lines_per_sec\":%.0f,",
+                     Rate( best.Tokens, best.Cpu ), Rate( best.Lines, best.Cpu ) );
+            fprintf( results, "\"peak_rss_kb\":%ld,\"instructions\":%ld,\"cpu_seconds\":%.6f}\n",
+                     best.PeakRSS, best.Instructions, best.Cpu );
+        }
+    }
+
+    if ( results != NULL )  fclose( results );
+    remove( progname );
+    remove( listname );
+    remove( codename );
+    remove( jsonname );
+    remove( errname );
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void Usage( char *name )
+{
+    fprintf( stderr, "usage: %s [-c compiler] [-g generator] [-d directory] [-k scale]\n", name );
+    fprintf( stderr, "       [-n runs] [-o results] [-b baseline]\n" );
+    exit( EXIT_FAILURE );
+}
+
+/*  Run "command", a compilation with --stats=<jsonname>, and read the       */
+/*  figures it wrote into "result".  Returns 0 if it failed.                 */
+
+PRIVATE int Compile( char *command, char *jsonname, RESULT *result )
+{
+    char json[MAX_LINE];
+    FILE *fp;
+    int p;
+
+    remove( jsonname );
+    if ( 0 != system( command ) || NULL == ( fp = fopen( jsonname, "r" ) ) )  return 0;
+    if ( NULL == fgets( json, MAX_LINE, fp ) )  {
+        fclose( fp );
+        return 0;
+    }
+    fclose( fp );
+    result->Cpu = Field( json, NULL, "cpu_seconds" );
+    for ( p = 0; p < 4; p++ )  result->PhaseCpu[p] = Field( json, Phases[p], "cpu_seconds" );
+    result->Lines = (long) Field( json, NULL, "lines" );
+    result->Tokens = (long) Field( json, NULL, "tokens" );
+    result->PeakRSS = (long) Field( json, NULL, "peak_rss_kb" );
+    result->Instructions = (long) Field( json, NULL, "instructions_emitted" );
+    result->Valid = NULL != strstr( json, "\"valid\":true" );
+    return result->Cpu >= 0.0;
+}
+
+/*  The number after "key" in a line of JSON, inside "object" if that is     */
+/*  not NULL; -1 if it is not there.                                         */
+
+PRIVATE double Field( char *json, char *object, char *key )
+{
+    char pattern[64];
+    char *p = json;
+
+    if ( object != NULL )  {
+        sprintf( pattern, "\"%s\":{", object );
+        if ( NULL == ( p = strstr( json, pattern ) ) )  return -1.0;
+    }
+    sprintf( pattern, "\"%s\":", key );
+    if ( NULL == ( p = strstr( p, pattern ) ) )  return -1.0;
+    return strtod( p + strlen( pattern ), NULL );
+}
+
+/*  The tokens/sec and peak RSS of "shape" in the results file "filename",   */
+/*  from its last line for that shape.  Returns 0 if there is none.          */
+
+PRIVATE int Baseline( char *filename, char *shape, double *tokenrate, long *rss )
+{
+    char json[MAX_LINE], pattern[64];
+    FILE *fp;
+    int found = 0;
+
+    if ( NULL == ( fp = fopen( filename, "r" ) ) )  return 0;
+    sprintf( pattern, "\"shape\":\"%.40s\"", shape );
+    while ( NULL != fgets( json, MAX_LINE, fp ) )  {
+        if ( NULL != strstr( json, pattern ) )  {
+            *tokenrate = Field( json, NULL, "tokens_per_sec" );
+            *rss = (long) Field( json, NULL, "peak_rss_kb" );
+            found = 1;
+        }
+    }
+    fclose( fp );
+    return found;
+}
+
+PRIVATE double Rate( long count, double seconds )
+{
+    return seconds > 0.0 ? count / seconds : 0.0;
+}
@@ -0,0 +1,323 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      cplgen.c                                                             */
+/*                                                                           */
+/*      Synthetic CPL program generator.  Usage:                             */
+/*                                                                           */
+/*          cplgen [-p procedures] [-n depth] [-v variables] [-e depth]      */
+/*                 [-s statements] [-l percent] [-x percent] [-r seed]       */
+/*                 [outputfile]                                              */
+/*                                                                           */
+/*      Writes a CPL program (to stdout if no file is named) with            */
+/*      "procedures" outer procedures (default 10), each the outermost of    */
+/*      a chain of procedures nested "depth" deep (default 1).  The program  */
+/*      and every procedure declare "variables" variables (default 4), and   */
+/*      each block has "statements" statements (default 20; blocks inside    */
+/*      WHILE and IF get a quarter as many).  "-l" is the percentage of      */
+/*      statements that are WHILE or IF statements (default 10), "-e" the    */
+/*      depth to which expressions nest (default 3).                         */
+/*                                                                           */
+/*      The statements are assignments, WRITEs, READs and calls, using only  */
+/*      the variables and procedures in scope, so the program is valid       */
+/*      unless "-x" asks for errors: that percentage of statements (default  */
+/*      0, may be fractional) then has one injected (a missing semicolon or  */
+/*      THEN, an undeclared variable, a stray operator, ...).  The same      */
+/*      options and seed (default 1) always give the same program.           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+
+#define  MAX_BLOCK_DEPTH     3      /* WHILE and IF nest no deeper than this */
+#define  MAX_NESTING       256      /* procedures nested inside one another  */
+#define  INDENT              4
+
+typedef struct  {
+    int  Procedures;
+    int  Depth;
+    int  Variables;
+    int  ExpressionDepth;
+    int  Statements;
+    int  LoopPercent;
+    double ErrorPercent;
+}
+    SHAPE;
+
+typedef struct  {                   /* the scopes the generator is inside    */
+    int  Levels;                    /* 0 is the program's                    */
+    long Procedure[MAX_NESTING];    /* number of the procedure at each level */
+}
+    SCOPE;
+
+PRIVATE FILE *Out;
+PRIVATE SHAPE Shape;
+PRIVATE unsigned long Seed = 1;
+PRIVATE long Procedures = 0;        /* numbered in order of declaration      */
+PRIVATE long Errors = 0;
+
+PRIVATE void Usage( char *name );
+PRIVATE void Procedure( SCOPE *scope, int level, long *callable, long ncallable );
+PRIVATE void Declarations( SCOPE *scope, int indent );
+PRIVATE void Block( SCOPE *scope, long *callable, long ncallable, int statements,
+                    int depth, int indent );
+PRIVATE void Statement( SCOPE *scope, long *callable, long ncallable, int depth, int indent );
+PRIVATE void Expression( SCOPE *scope, int depth );
+PRIVATE void Operand( SCOPE *scope );
+PRIVATE void Condition( SCOPE *scope );
+PRIVATE void Variable( SCOPE *scope );
+PRIVATE void Indent( int indent );
+PRIVATE int  Chance( double percent );
+PRIVATE long Random( long n );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    SCOPE scope;
+    long *callable;
+    int i;
+
+    Shape.Procedures = 10;
+    Shape.Depth = 1;
+    Shape.Variables = 4;
+    Shape.ExpressionDepth = 3;
+    Shape.Statements = 20;
+    Shape.LoopPercent = 10;
+    Shape.ErrorPercent = 0.0;
+    Out = stdout;
+
+    for ( i = 1; i < argc; i++ )  {
+        if ( argv[i][0] != '-' )  {
+            if ( i != argc - 1 || NULL == ( Out = fopen( argv[i], "w" ) ) )  Usage( argv[0] );
+        }
+        else if ( i + 1 >= argc || argv[i][2] != '\0' )  Usage( argv[0] );
+        else  {
+            switch ( argv[i][1] )  {
+                case 'p':  Shape.Procedures = atoi( argv[++i] );       break;
+                case 'n':  Shape.Depth = atoi( argv[++i] );            break;
+                case 'v':  Shape.Variables = atoi( argv[++i] );        break;
+                case 'e':  Shape.ExpressionDepth = atoi( argv[++i] );  break;
+                case 's':  Shape.Statements = atoi( argv[++i] );       break;
+                case 'l':  Shape.LoopPercent = atoi( argv[++i] );      break;
+                case 'x':  Shape.ErrorPercent = atof( argv[++i] );     break;
+                case 'r':  Seed = strtoul( argv[++i], NULL, 10 );      break;
+                default:   Usage( argv[0] );
+            }
+        }
+    }
+    if ( Shape.Procedures < 0 || Shape.Depth < 1 || Shape.Depth > MAX_NESTING ||
+         Shape.Variables < 1 || Shape.ExpressionDepth < 0 || Shape.Statements < 1 )
+        Usage( argv[0] );
+
+    /* a procedure may call the outer procedures declared before it, those  */
+    /* enclosing it and those nested in it, so at most this many            */
+    if ( NULL == ( callable = malloc( ( Shape.Procedures + 2 * Shape.Depth + 1 ) *
+                                      sizeof( long ) ) ) )  {
+        fprintf( stderr, "%s: out of memory\n", argv[0] );
+        exit( EXIT_FAILURE );
+    }
+    scope.Levels = 1;
+    scope.Procedure[0] = 0;
+    fprintf( Out, "PROGRAM gen;\n" );
+    Declarations( &scope, 0 );
+    for ( i = 0; i < Shape.Procedures; i++ )  {
+        Procedure( &scope, 1, callable, i );
+        callable[i] = Procedures - Shape.Depth + 1;
+    }
+    fprintf( Out, "BEGIN\n" );
+    Block( &scope, callable, Shape.Procedures, Shape.Statements, 0, INDENT );
+    fprintf( Out, "END.\n" );
+
+    if ( Out != stdout )  fclose( Out );
+    if ( Errors > 0 )  fprintf( stderr, "%s: %ld errors injected\n", argv[0], Errors );
+    free( callable );
+    return EXIT_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void Usage( char *name )
+{
+    fprintf( stderr, "usage: %s [-p procedures] [-n depth] [-v variables] [-e depth]\n", name );
+    fprintf( stderr, "       [-s statements] [-l percent] [-x percent] [-r seed] [outputfile]\n" );
+    exit( EXIT_FAILURE );
+}
+
+/*  Procedure p<k> at nesting level "level", with the procedures nested in   */
+/*  it down to Shape.Depth.  The first "ncallable" entries of "callable"     */
+/*  are the outer procedures it may call; it may also call itself, the       */
+/*  procedures enclosing it and the one nested in it.                        */
+
+PRIVATE void Procedure( SCOPE *scope, int level, long *callable, long ncallable )
+{
+    long number = ++Procedures, n = ncallable;
+    int indent = ( level - 1 ) * INDENT, l;
+
+    Indent( indent );
+    fprintf( Out, "PROCEDURE p%ld;\n", number );
+    scope->Procedure[scope->Levels++] = number;
+    Declarations( scope, indent + INDENT );
+    if ( level < Shape.Depth )  {
+        Procedure( scope, level + 1, callable, ncallable );
+        callable[n++] = number + 1;
+    }
+    for ( l = 1; l < scope->Levels; l++ )  callable[n++] = scope->Procedure[l];
+    Indent( indent );
+    fprintf( Out, "BEGIN\n" );
+    Block( scope, callable, n, Shape.Statements, 0, indent + INDENT );
+    Indent( indent );
+    fprintf( Out, "END;\n" );
+    scope->Levels--;
+}
+
+/*  "VAR" and the variables of the innermost scope, named v<proc>x<i>.       */
+
+PRIVATE void Declarations( SCOPE *scope, int indent )
+{
+    int i;
+
+    Indent( indent );
+    fprintf( Out, "VAR " );
+    for ( i = 1; i <= Shape.Variables; i++ )  {
+        fprintf( Out, "v%ldx%d%s", scope->Procedure[scope->Levels - 1], i,
+                 i < Shape.Variables ? ", " : ";\n" );
+    }
+}
+
+/*  The statements of a block, each followed by ";" (the BEGIN and END are   */
+/*  the caller's).                                                           */
+
+PRIVATE void Block( SCOPE *scope, long *callable, long ncallable, int statements,
+                    int depth, int indent )
+{
+    int i;
+
+    for ( i = 0; i < statements; i++ )  {
+        Indent( indent );
+        Statement( scope, callable, ncallable, depth, indent );
+    }
+}
+
+PRIVATE void Statement( SCOPE *scope, long *callable, long ncallable, int depth, int indent )
+{
+    int error = Chance( Shape.ErrorPercent ) ? 1 + (int) Random( 5 ) : 0;
+    int inner = Shape.Statements / 4 > 0 ? Shape.Statements / 4 : 1, loop;
+    long r;
+
+    if ( error )  Errors++;
+    if ( depth < MAX_BLOCK_DEPTH && Chance( Shape.LoopPercent ) )  {
+        if ( error > 1 && error < 5 )  error = 5;
+        loop = (int) Random( 2 );
+        fprintf( Out, loop ? "WHILE " : "IF " );
+        Condition( scope );
+        fprintf( Out, error == 1 ? " BEGIN\n" : ( loop ? " DO BEGIN\n" : " THEN BEGIN\n" ) );
+        Block( scope, callable, ncallable, inner, depth + 1, indent + INDENT );
+        Indent( indent );
+        fprintf( Out, "END" );
+        if ( !loop && Random( 4 ) == 0 )  {
+            fprintf( Out, "\n" );
+            Indent( indent );
+            fprintf( Out, "ELSE BEGIN\n" );
+            Block( scope, callable, ncallable, inner, depth + 1, indent + INDENT );
+            Indent( indent );
+            fprintf( Out, "END" );
+        }
+    }
+    else if ( ( r = Random( 20 ) ) < 3 )  {
+        if ( error > 1 && error < 5 )  error = 5;
+        if ( r < 2 )  {
+            fprintf( Out, "WRITE( " );
+            Expression( scope, Shape.ExpressionDepth );
+            fprintf( Out, ", " );
+            Expression( scope, Shape.ExpressionDepth );
+        }
+        else  {
+            fprintf( Out, "READ( " );
+            Variable( scope );
+        }
+        fprintf( Out, error == 1 ? " " : " )" );
+    }
+    else if ( r < 5 && ncallable > 0 )  {
+        if ( error )  error = 5;
+        fprintf( Out, "p%ld", callable[Random( ncallable )] );
+    }
+    else  {
+        if ( error == 1 )  error = 5;
+        if ( error == 2 )  fprintf( Out, "undeclared" );
+        else  Variable( scope );
+        fprintf( Out, error == 3 ? " = " : " := " );
+        Expression( scope, Shape.ExpressionDepth );
+        if ( error == 4 )  fprintf( Out, " *" );
+    }
+    fprintf( Out, error == 5 ? "\n" : ";\n" );
+}
+
+/*  An expression with brackets nested up to "depth" deep, mixing all four   */
+/*  operators and unary minus.  A divisor is never bracketed, so constant    */
+/*  folding can never meet a division by zero.                               */
+
+PRIVATE void Expression( SCOPE *scope, int depth )
+{
+    static char *ops[] = { " + ", " - ", " * ", " / " };
+    int terms = 1 + (int) Random( 3 ), i, op = 0;
+
+    for ( i = 0; i < terms; i++ )  {
+        if ( i > 0 )  fprintf( Out, "%s", ops[op = (int) Random( 4 )] );
+        if ( Random( 8 ) == 0 )  fprintf( Out, "-" );
+        if ( depth > 0 && op != 3 && Random( 2 ) == 0 )  {
+            fprintf( Out, "( " );
+            Expression( scope, depth - 1 );
+            fprintf( Out, " )" );
+        }
+        else  Operand( scope );
+    }
+}
+
+PRIVATE void Operand( SCOPE *scope )
+{
+    if ( Random( 3 ) == 0 )  fprintf( Out, "%ld", 1 + Random( 999 ) );
+    else  Variable( scope );
+}
+
+PRIVATE void Condition( SCOPE *scope )
+{
+    static char *relops[] = { " = ", " < ", " > ", " <= ", " >= " };
+    int depth = Shape.ExpressionDepth > 0 ? Shape.ExpressionDepth - 1 : 0;
+
+    Expression( scope, depth );
+    fprintf( Out, "%s", relops[Random( 5 )] );
+    Expression( scope, depth );
+}
+
+/*  A variable of one of the scopes in force, the innermost most often.      */
+
+PRIVATE void Variable( SCOPE *scope )
+{
+    int level = scope->Levels - 1;
+
+    if ( level > 0 && Random( 2 ) == 0 )  level = (int) Random( scope->Levels );
+    fprintf( Out, "v%ldx%ld", scope->Procedure[level], 1 + Random( Shape.Variables ) );
+}
+
+PRIVATE void Indent( int indent )
+{
+    fprintf( Out, "%*s", indent, "" );
+}
+
+PRIVATE int Chance( double percent )
+{
+    return percent > 0.0 && Random( 100000 ) < (long) ( percent * 1000.0 );
+}
+
+/*  A pseudo-random number in 0 .. n-1, the same on every platform.          */
+
+PRIVATE long Random( long n )
+{
+    Seed = ( Seed * 1103515245UL + 12345UL ) & 0xffffffffUL;
+    return (long) ( ( Seed >> 8 ) % (unsigned long) n );
+}
@@ -0,0 +1,265 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      daemonbench.c                                                        */
+/*                                                                           */
+/*      Compile server benchmark.  Usage:                                    */
+/*                                                                           */
+/*          daemonbench <socket> <file.prog> [clients] [requests]            */
+/*                                                                           */
+/*      Starts "clients" (default 8) threads, each of which connects to the  */
+/*      server listening on "socket" (see "comp -d") and sends the source    */
+/*      "requests" (default 1000) times over its connection, one request     */
+/*      after another.  Every reply is checked against the first one.        */
+/*      Reports the requests per second and the mean and 99th percentile     */
+/*      latency of a request.                                                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "global.h"
+#include "daemon.h"
+
+#define  MAX_CLIENTS    256
+
+typedef struct  {
+    pthread_t Thread;
+    int       Requests;
+    double    *Latency;             /* seconds, one per request              */
+    int       Failed;               /* connection lost or reply differs      */
+}
+    CLIENT;
+
+PRIVATE char   *SocketName;
+PRIVATE char   *Source;
+PRIVATE size_t SourceLength;
+PRIVATE char   *Expected;           /* the first reply, as a reference       */
+PRIVATE size_t ExpectedLength;
+
+PRIVATE void   *RunClient( void *arg );
+PRIVATE int    Connect( void );
+PRIVATE char   *Request( int fd, size_t *length );
+PRIVATE int    ReadAll( int fd, void *buffer, size_t length );
+PRIVATE int    WriteAll( int fd, const void *buffer, size_t length );
+PRIVATE unsigned long Number( unsigned char *b );
+PRIVATE char   *ReadFile( char *filename, size_t *length );
+PRIVATE int    CompareDoubles( const void *a, const void *b );
+PRIVATE double Now( void );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    CLIENT clients[MAX_CLIENTS];
+    double *all, start, seconds, sum = 0.0;
+    int nclients = 8, requests = 1000, i, j, n = 0, failed = 0, fd;
+
+    if ( argc < 3 )  {
+        fprintf( stderr, "%s <socket> <file.prog> [clients] [requests]\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    SocketName = argv[1];
+    Source = ReadFile( argv[2], &SourceLength );
+    if ( argc > 3 && ( nclients = atoi( argv[3] ) ) < 1 )  nclients = 1;
+    if ( nclients > MAX_CLIENTS )  nclients = MAX_CLIENTS;
+    if ( argc > 4 && ( requests = atoi( argv[4] ) ) < 1 )  requests = 1;
+
+    if ( ( fd = Connect() ) < 0 || NULL == ( Expected = Request( fd, &ExpectedLength ) ) )  {
+        fprintf( stderr, "no reply from \"%s\"\n", SocketName );
+        return EXIT_FAILURE;
+    }
+    close( fd );
+    printf( "status %lu, %lu bytes of listing and code per reply\n",
+            Number( (unsigned char *) Expected ), (unsigned long) ExpectedLength - 12 );
+
+    start = Now();
+    for ( i = 0; i < nclients; i++ )  {
+        clients[i].Requests = requests;
+        clients[i].Failed = 0;
+        if ( NULL == ( clients[i].Latency = malloc( requests * sizeof( double ) ) ) ||
+             0 != pthread_create( &clients[i].Thread, NULL, RunClient, &clients[i] ) )  {
+            fprintf( stderr, "cannot start client %d\n", i );
+            return EXIT_FAILURE;
+        }
+    }
+    for ( i = 0; i < nclients; i++ )  pthread_join( clients[i].Thread, NULL );
+    seconds = Now() - start;
+
+    if ( NULL == ( all = malloc( (size_t) nclients * requests * sizeof( double ) ) ) )  {
+        fprintf( stderr, "out of memory\n" );
+        return EXIT_FAILURE;
+    }
+    for ( i = 0; i < nclients; i++ )  {
+        failed += clients[i].Failed;
+        for ( j = 0; j < clients[i].Requests; j++ )  {
+            all[n++] = clients[i].Latency[j];
+            sum += clients[i].Latency[j];
+        }
+        free( clients[i].Latency );
+    }
+    qsort( all, n, sizeof( double ), CompareDoubles );
+    printf( "%d clients x %d requests: %.3fs, %.0f requests/sec\n", nclients, requests,
+            seconds, seconds > 0.0 ? n / seconds : 0.0 );
+    if ( n > 0 )
+        printf( "latency: mean %.1fus, p99 %.1fus\n", 1e6 * sum / n, 1e6 * all[n * 99 / 100] );
+    if ( failed )  printf( "%d clients failed\n", failed );
+    free( all );
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void *RunClient( void *arg )
+{
+    CLIENT *self = arg;
+    char *reply;
+    size_t length;
+    double t;
+    int fd, i;
+
+    if ( ( fd = Connect() ) < 0 )  {
+        self->Failed = 1;
+        self->Requests = 0;
+        return NULL;
+    }
+    for ( i = 0; i < self->Requests; i++ )  {
+        t = Now();
+        if ( NULL == ( reply = Request( fd, &length ) ) )  break;
+        self->Latency[i] = Now() - t;
+        if ( length != ExpectedLength || 0 != memcmp( reply, Expected, length ) )
+            self->Failed = 1;
+        free( reply );
+    }
+    if ( i < self->Requests )  {
+        self->Failed = 1;
+        self->Requests = i;
+    }
+    close( fd );
+    return NULL;
+}
+
+PRIVATE int Connect( void )
+{
+    struct sockaddr_un address;
+    int fd;
+
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    strncpy( address.sun_path, SocketName, sizeof( address.sun_path ) - 1 );
+    if ( ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 )  return -1;
+    if ( 0 != connect( fd, (struct sockaddr *) &address, sizeof( address ) ) )  {
+        close( fd );
+        return -1;
+    }
+    return fd;
+}
+
+/*  Sends the source and returns the whole reply (status and both lengths    */
+/*  included) in memory from malloc, or NULL if the connection failed.       */
+
+PRIVATE char *Request( int fd, size_t *length )
+{
+    unsigned char header[4];
+    char *reply, *p;
+    unsigned long listing, code;
+
+    header[0] = (unsigned char) ( SourceLength >> 24 );
+    header[1] = (unsigned char) ( SourceLength >> 16 );
+    header[2] = (unsigned char) ( SourceLength >> 8 );
+    header[3] = (unsigned char) SourceLength;
+    if ( !WriteAll( fd, header, 4 ) || !WriteAll( fd, Source, SourceLength ) )  return NULL;
+
+    if ( NULL == ( reply = malloc( 8 ) ) || !ReadAll( fd, reply, 8 ) )  {
+        free( reply );
+        return NULL;
+    }
+    listing = Number( (unsigned char *) reply + 4 );
+    if ( NULL == ( p = realloc( reply, 12 + listing ) ) ||
+         !ReadAll( fd, ( reply = p ) + 8, listing + 4 ) )  {
+        free( p == NULL ? reply : p );
+        return NULL;
+    }
+    code = Number( (unsigned char *) reply + 8 + listing );
+    if ( NULL == ( p = realloc( reply, 12 + listing + code ) ) ||
+         !ReadAll( fd, ( reply = p ) + 12 + listing, code ) )  {
+        free( p == NULL ? reply : p );
+        return NULL;
+    }
+    *length = 12 + listing + code;
+    return reply;
+}
+
+PRIVATE int ReadAll( int fd, void *buffer, size_t length )
+{
+    char *p = buffer;
+    ssize_t n;
+
+    while ( length > 0 )  {
+        if ( ( n = read( fd, p, length ) ) <= 0 )  return 0;
+        p += n;
+        length -= (size_t) n;
+    }
+    return 1;
+}
+
+PRIVATE int WriteAll( int fd, const void *buffer, size_t length )
+{
+    const char *p = buffer;
+    ssize_t n;
+
+    while ( length > 0 )  {
+        if ( ( n = write( fd, p, length ) ) <= 0 )  return 0;
+        p += n;
+        length -= (size_t) n;
+    }
+    return 1;
+}
+
+PRIVATE unsigned long Number( unsigned char *b )
+{
+    return (unsigned long) b[0] << 24 | (unsigned long) b[1] << 16 |
+           (unsigned long) b[2] << 8 | (unsigned long) b[3];
+}
+
+PRIVATE char *ReadFile( char *filename, size_t *length )
+{
+    FILE *fp;
+    char *text;
+    long size;
+
+    if ( NULL == ( fp = fopen( filename, "rb" ) ) || 0 != fseek( fp, 0L, SEEK_END ) ||
+         ( size = ftell( fp ) ) < 0 || 0 != fseek( fp, 0L, SEEK_SET ) ||
+         NULL == ( text = malloc( (size_t) size + 1 ) ) ||
+         (size_t) size != fread( text, 1, (size_t) size, fp ) )  {
+        fprintf( stderr, "cannot read \"%s\"\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    fclose( fp );
+    *length = (size_t) size;
+    return text;
+}
+
+PRIVATE int CompareDoubles( const void *a, const void *b )
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+PRIVATE double Now( void )
+{
+    struct timespec t;
+
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return (double) t.tv_sec + (double) t.tv_nsec / 1e9;
+}
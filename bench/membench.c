@@ -0,0 +1,138 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      membench.c                                                           */
+/*                                                                           */
+/*      In-memory compilation benchmark.  Usage:                             */
+/*                                                                           */
+/*          membench <file.prog> [passes]                                    */
+/*                                                                           */
+/*      Compiles the file "passes" (default 1000) times with                 */
+/*      "CompileBuffer", reusing one CONTEXT and two buffer sinks, so no     */
+/*      pass touches the file system.  Then compiles it as many times the    */
+/*      way an embedding program had to before, through temporary files:     */
+/*      the source is written to one and read back, and the listing and      */
+/*      code are written to two more.  Reports compiles/sec and source       */
+/*      KB/sec for both.                                                     */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "global.h"
+#include "context.h"
+#include "sink.h"
+#include "compiler.h"
+
+PRIVATE char   *ReadFile( char *filename, size_t *length );
+PRIVATE FILE   *TemporaryFile( void );
+PRIVATE double Seconds( clock_t start );
+PRIVATE void   Report( char *name, int passes, size_t length, double t );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    CONTEXT *ctx;
+    SINK listing, code;
+    FILE *in, *list, *out;
+    char *source, *copy;
+    size_t length;
+    clock_t start;
+    int passes = 1000, p, valid = 0;
+
+    if ( argc < 2 )  {
+        fprintf( stderr, "usage: %s <file.prog> [passes]\n", argv[0] );
+        exit( EXIT_FAILURE );
+    }
+    if ( argc > 2 && ( passes = atoi( argv[2] ) ) < 1 )  passes = 1;
+    source = ReadFile( argv[1], &length );
+    if ( NULL == ( copy = malloc( length + 1 ) ) )  {
+        fprintf( stderr, "%s: out of memory\n", argv[0] );
+        exit( EXIT_FAILURE );
+    }
+    ctx = MakeCompilerContext();
+
+    InitBufferSink( &listing );
+    InitBufferSink( &code );
+    start = clock();
+    for ( p = 0; p < passes; p++ )  {
+        RewindSink( &listing );
+        RewindSink( &code );
+        valid = CompileBuffer( ctx, source, length, &listing, &code );
+    }
+    Report( "in memory:", passes, length, Seconds( start ) );
+    printf( "                 %s, %lu bytes of listing, %lu bytes of code\n",
+            valid ? "valid" : "invalid", (unsigned long) listing.Length,
+            (unsigned long) code.Length );
+    FreeSink( &listing );
+    FreeSink( &code );
+
+    start = clock();
+    for ( p = 0; p < passes; p++ )  {
+        in = TemporaryFile();
+        list = TemporaryFile();
+        out = TemporaryFile();
+        if ( length != fwrite( source, 1, length, in ) || 0 != fseek( in, 0L, SEEK_SET ) ||
+             length != fread( copy, 1, length, in ) )  {
+            fprintf( stderr, "%s: temporary file failed\n", argv[0] );
+            exit( EXIT_FAILURE );
+        }
+        InitFileSink( &listing, list );
+        InitFileSink( &code, out );
+        CompileBuffer( ctx, copy, length, &listing, &code );
+        fclose( in );
+        fclose( list );
+        fclose( out );
+    }
+    Report( "temporary files:", passes, length, Seconds( start ) );
+
+    FreeContext( ctx );
+    free( copy );
+    free( source );
+    return EXIT_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE char *ReadFile( char *filename, size_t *length )
+{
+    FILE *fp;
+    char *text;
+    long size;
+
+    if ( NULL == ( fp = fopen( filename, "rb" ) ) || 0 != fseek( fp, 0L, SEEK_END ) ||
+         ( size = ftell( fp ) ) < 0 || 0 != fseek( fp, 0L, SEEK_SET ) ||
+         NULL == ( text = malloc( (size_t) size + 1 ) ) ||
+         (size_t) size != fread( text, 1, (size_t) size, fp ) )  {
+        fprintf( stderr, "cannot read \"%s\"\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    fclose( fp );
+    *length = (size_t) size;
+    return text;
+}
+
+PRIVATE FILE *TemporaryFile( void )
+{
+    FILE *fp;
+
+    if ( NULL == ( fp = tmpfile() ) )  {
+        fprintf( stderr, "cannot create a temporary file\n" );
+        exit( EXIT_FAILURE );
+    }
+    return fp;
+}
+
+PRIVATE double Seconds( clock_t start )
+{
+    return (double) ( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+PRIVATE void Report( char *name, int passes, size_t length, double t )
+{
+    printf( "%-16s %d compiles in %.3fs, %.0f compiles/sec, %.1f KB/sec\n", name, passes, t,
+            t > 0.0 ? passes / t : 0.0, t > 0.0 ? passes * ( length / 1024.0 ) / t : 0.0 );
+}
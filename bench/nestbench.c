@@ -0,0 +1,135 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      nestbench.c                                                          */
+/*                                                                           */
+/*      Nested scope benchmark.  Usage:                                      */
+/*                                                                           */
+/*          nestbench [statements] [compiler] [directory]                    */
+/*                                                                           */
+/*      For each depth in "Depths" writes a program of procedures p1 .. pD   */
+/*      each nested in the one before, each with one local v1 .. vD.  The    */
+/*      innermost procedure runs "statements" assignments                    */
+/*                                                                           */
+/*          vD := vD + vK;                                                   */
+/*                                                                           */
+/*      with K going round the outer levels, and the program writes the      */
+/*      total.  Each program is compiled and run with "compiler -r"          */
+/*      (default "./comp"), the result checked and the instructions run      */
+/*      per assignment and the time reported.  The files are made in         */
+/*      "directory" (default ".") and removed afterwards.                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+
+#define  MAX_PATH    4096
+
+PRIVATE int Depths[] = { 2, 4, 8, 16, 32, 64 };
+
+PRIVATE long WriteProgram( char *filename, int depth, int statements );
+PRIVATE int  RunProgram( char *command, char *outname, char *errname, long *result,
+                         long *instructions, double *seconds );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    char *comp = "./comp", *dir = ".";
+    char progname[MAX_PATH], listname[MAX_PATH], codename[MAX_PATH];
+    char outname[MAX_PATH], errname[MAX_PATH], command[6 * MAX_PATH + 64];
+    long expected, result, instructions;
+    double seconds;
+    int statements = 200000, d, failed = 0;
+
+    if ( argc > 1 && ( statements = atoi( argv[1] ) ) < 1 )  statements = 1;
+    if ( argc > 2 )  comp = argv[2];
+    if ( argc > 3 )  dir = argv[3];
+    if ( strlen( dir ) + 16 > MAX_PATH || strlen( comp ) > MAX_PATH )  {
+        fprintf( stderr, "%s: name too long\n", argv[0] );
+        exit( EXIT_FAILURE );
+    }
+    sprintf( progname, "%s/nestbench.prog", dir );
+    sprintf( listname, "%s/nestbench.lst", dir );
+    sprintf( codename, "%s/nestbench.code", dir );
+    sprintf( outname, "%s/nestbench.out", dir );
+    sprintf( errname, "%s/nestbench.err", dir );
+    sprintf( command, "%s -r %s %s %s </dev/null >%s 2>%s",
+             comp, progname, listname, codename, outname, errname );
+
+    printf( "depth  instructions  per assignment     seconds\n" );
+    for ( d = 0; d < (int) ( sizeof( Depths ) / sizeof( Depths[0] ) ); d++ )  {
+        expected = WriteProgram( progname, Depths[d], statements );
+        if ( !RunProgram( command, outname, errname, &result, &instructions, &seconds ) )  {
+            printf( "%5d  failed to compile or run\n", Depths[d] );
+            failed = 1;
+            continue;
+        }
+        printf( "%5d  %12ld  %14.2f  %10.3f%s\n", Depths[d], instructions,
+                (double) instructions / statements, seconds,
+                result == expected ? "" : "  WRONG RESULT" );
+        if ( result != expected )  failed = 1;
+    }
+    remove( progname );
+    remove( listname );
+    remove( codename );
+    remove( outname );
+    remove( errname );
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  Returns the value the program should write.                              */
+
+PRIVATE long WriteProgram( char *filename, int depth, int statements )
+{
+    FILE *fp;
+    long total = depth;
+    int level, i, k;
+
+    if ( NULL == ( fp = fopen( filename, "w" ) ) )  {
+        fprintf( stderr, "cannot open \"%s\" for output\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    fprintf( fp, "PROGRAM nest;\nVAR g;\n" );
+    for ( level = 1; level <= depth; level++ )
+        fprintf( fp, "PROCEDURE p%d;\nVAR v%d;\n", level, level );
+
+    fprintf( fp, "BEGIN\n  v%d := %d;\n", depth, depth );
+    for ( i = 0; i < statements; i++ )  {
+        k = 1 + i % ( depth - 1 );
+        fprintf( fp, "  v%d := v%d + v%d;\n", depth, depth, k );
+        total += k;
+    }
+    fprintf( fp, "  g := v%d;\nEND;\n", depth );
+
+    for ( level = depth - 1; level >= 1; level-- )
+        fprintf( fp, "BEGIN\n  v%d := %d;\n  p%d;\nEND;\n", level, level, level + 1 );
+    fprintf( fp, "BEGIN\n  p1;\n  WRITE(g);\nEND.\n" );
+    fclose( fp );
+    return total;
+}
+
+PRIVATE int RunProgram( char *command, char *outname, char *errname, long *result,
+                        long *instructions, double *seconds )
+{
+    FILE *fp;
+    char line[256];
+    int found = 0;
+
+    if ( 0 != system( command ) )  return 0;
+    if ( NULL == ( fp = fopen( outname, "r" ) ) )  return 0;
+    while ( NULL != fgets( line, sizeof( line ), fp ) )
+        if ( 1 == sscanf( line, "%ld", result ) )  found = 1;
+    fclose( fp );
+    if ( !found || NULL == ( fp = fopen( errname, "r" ) ) )  return 0;
+    for ( found = 0; NULL != fgets( line, sizeof( line ), fp ); )
+        if ( 2 == sscanf( line, "%ld instructions in %lfs", instructions, seconds ) )  found = 1;
+    fclose( fp );
+    return found;
+}
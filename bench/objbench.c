@@ -0,0 +1,237 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      objbench.c                                                           */
+/*                                                                           */
+/*      Object file benchmark.  Usage:                                       */
+/*                                                                           */
+/*          objbench [instructions] [directory]                              */
+/*                                                                           */
+/*      Emits a program of the given size with the mix of instructions the   */
+/*      parser produces, then times writing it as a text code file           */
+/*      ("WriteCodeFile") and as a binary object file ("WriteObjectFile"),   */
+/*      and loading each back: the text by parsing every line, as a loader   */
+/*      of the text format has to, and the object by "LoadObjectFile".       */
+/*      Both loads checksum every instruction, so the two can be checked     */
+/*      against each other.  The files are made in "directory" (default     */
+/*      ".") and removed afterwards.                                         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "global.h"
+#include "code.h"
+#include "object.h"
+#include "context.h"
+
+#define  MAX_PATH    4096
+
+typedef struct  {
+    char *Mnemonic;
+    int  Opcode;
+    int  HasOperand;
+}
+    MNEMONIC;
+
+PRIVATE MNEMONIC Mnemonics[] =  {
+    { "Add", I_ADD, 0 },    { "Sub", I_SUB, 0 },    { "Mult", I_MULT, 0 },
+    { "Div", I_DIV, 0 },    { "Neg", I_NEG, 0 },    { "Ret", I_RET, 0 },
+    { "Bsf", I_BSF, 0 },    { "Rsf", I_RSF, 0 },    { "Push", I_PUSHFP, 0 },
+    { "Read", I_READ, 0 },  { "Write", I_WRITE, 0 }, { "Halt", I_HALT, 0 },
+    { "Br", I_BR, 1 },      { "Bgz", I_BGZ, 1 },    { "Bg", I_BG, 1 },
+    { "Blz", I_BLZ, 1 },    { "Bl", I_BL, 1 },      { "Bz", I_BZ, 1 },
+    { "Bnz", I_BNZ, 1 },    { "Call", I_CALL, 1 },  { "Ldp", I_LDP, 1 },
+    { "Rdp", I_RDP, 1 },    { "Inc", I_INC, 1 },    { "Dec", I_DEC, 1 }
+};
+
+PRIVATE void          EmitProgram( CONTEXT *ctx, int count );
+PRIVATE unsigned long LoadText( char *filename, long *count );
+PRIVATE int           ParseLine( char *line, int *opcode, int *operand );
+PRIVATE unsigned long Checksum( unsigned long sum, int opcode, int operand );
+PRIVATE double        Seconds( clock_t start );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    CONTEXT *ctx;
+    OBJECTFILE *obj;
+    FILE *fp;
+    SINK code;
+    char *dir = ".", textname[MAX_PATH], objname[MAX_PATH];
+    unsigned long textsum, objsum;
+    long textcount, i;
+    clock_t start;
+    double t;
+    int count = 1000000;
+
+    if ( argc > 1 && ( count = atoi( argv[1] ) ) < 1 )  count = 1;
+    if ( argc > 2 )  dir = argv[2];
+    if ( strlen( dir ) + 16 > MAX_PATH )  {
+        fprintf( stderr, "%s: directory name too long\n", argv[0] );
+        exit( EXIT_FAILURE );
+    }
+    sprintf( textname, "%s/objbench.code", dir );
+    sprintf( objname, "%s/objbench.obj", dir );
+
+    ctx = MakeContext();
+    if ( NULL == ( fp = fopen( textname, "w" ) ) )  {
+        fprintf( stderr, "%s: cannot open \"%s\" for output\n", argv[0], textname );
+        exit( EXIT_FAILURE );
+    }
+    InitFileSink( &code, fp );
+    InitCodeGenerator( ctx, &code );
+    EmitProgram( ctx, count );
+
+    start = clock();
+    WriteCodeFile( ctx );
+    fclose( fp );
+    t = Seconds( start );
+    printf( "write text:      %d instructions in %.3fs, %.0f instructions/sec\n",
+            count, t, t > 0.0 ? count / t : 0.0 );
+
+    if ( NULL == ( fp = fopen( objname, "wb" ) ) )  {
+        fprintf( stderr, "%s: cannot open \"%s\" for output\n", argv[0], objname );
+        exit( EXIT_FAILURE );
+    }
+    start = clock();
+    WriteObjectFile( ctx, fp );
+    fclose( fp );
+    t = Seconds( start );
+    printf( "write object:    %d instructions in %.3fs, %.0f instructions/sec\n",
+            count, t, t > 0.0 ? count / t : 0.0 );
+
+    start = clock();
+    textsum = LoadText( textname, &textcount );
+    t = Seconds( start );
+    printf( "load text:       %ld instructions in %.3fs, %.0f instructions/sec\n",
+            textcount, t, t > 0.0 ? textcount / t : 0.0 );
+
+    start = clock();
+    if ( NULL == ( obj = LoadObjectFile( objname ) ) )  exit( EXIT_FAILURE );
+    for ( objsum = 0, i = 0; i < obj->Header->CodeCount; i++ )
+        objsum = Checksum( objsum, obj->Code[i].Opcode, obj->Code[i].Operand );
+    t = Seconds( start );
+    printf( "load object:     %d instructions in %.3fs, %.0f instructions/sec\n",
+            obj->Header->CodeCount, t, t > 0.0 ? obj->Header->CodeCount / t : 0.0 );
+
+    if ( textsum != objsum || textcount != obj->Header->CodeCount )
+        printf( "checksums differ: text %lx, object %lx\n", textsum, objsum );
+    FreeObjectFile( obj );
+    FreeContext( ctx );
+    remove( textname );
+    remove( objname );
+    return textsum == objsum ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  Roughly the mix of a compiled statement list: loads and stores of        */
+/*  globals, locals and outer locals, arithmetic, calls and branches.        */
+
+PRIVATE void EmitProgram( CONTEXT *ctx, int count )
+{
+    unsigned long seed = 12345;
+    int i, r;
+
+    for ( i = 0; i < count - 1; i++ )  {
+        seed = seed * 1103515245UL + 12345UL;
+        r = (int) ( ( seed >> 16 ) & 0x7fff );
+        switch ( r % 16 )  {
+            case 0:  case 1:  Emit( ctx, I_LOADA, r % 64 );          break;
+            case 2:  case 3:  Emit( ctx, I_LOADI, r - 1000 );        break;
+            case 4:           Emit( ctx, I_LOADFP, r % 9 - 2 );      break;
+            case 5:           Emit( ctx, I_LOADSP, r % 5 );          break;
+            case 6:  case 7:  _Emit( ctx, I_ADD );                   break;
+            case 8:           _Emit( ctx, I_MULT );                  break;
+            case 9:           _Emit( ctx, I_NEG );                   break;
+            case 10: case 11: Emit( ctx, I_STOREA, r % 64 );         break;
+            case 12:          Emit( ctx, I_STOREFP, r % 7 );         break;
+            case 13:          Emit( ctx, I_STORESP, r % 3 );         break;
+            case 14:          Emit( ctx, I_CALL, r % ( i + 1 ) );    break;
+            default:          Emit( ctx, I_BZ, r % ( i + 1 ) );      break;
+        }
+    }
+    _Emit( ctx, I_HALT );
+}
+
+PRIVATE unsigned long LoadText( char *filename, long *count )
+{
+    FILE *fp;
+    char line[256];
+    unsigned long sum = 0;
+    int opcode, operand;
+
+    *count = 0;
+    if ( NULL == ( fp = fopen( filename, "r" ) ) )  return 0;
+    while ( NULL != fgets( line, sizeof( line ), fp ) )  {
+        if ( ParseLine( line, &opcode, &operand ) )  {
+            sum = Checksum( sum, opcode, operand );
+            ( *count )++;
+        }
+    }
+    fclose( fp );
+    return sum;
+}
+
+/*  "<addr>  <mnemonic> [<operand>]", where a Load or Store operand is       */
+/*  "#n", "n", "FP", "FP+n", "FP-n" or "[SP]+n".                             */
+
+PRIVATE int ParseLine( char *line, int *opcode, int *operand )
+{
+    char *p = line, *word;
+    int i, length;
+
+    strtol( p, &p, 10 );
+    while ( isspace( (unsigned char) *p ) )  p++;
+    for ( word = p; isalpha( (unsigned char) *p ); p++ )  ;
+    length = (int) ( p - word );
+    while ( *p == ' ' )  p++;
+    *operand = 0;
+
+    if ( ( length == 4 && 0 == strncmp( word, "Load", 4 ) ) ||
+         ( length == 5 && 0 == strncmp( word, "Store", 5 ) ) )  {
+        i = length == 4;
+        if ( *p == '#' )  {
+            *opcode = I_LOADI;
+            *operand = (int) strtol( p + 1, NULL, 10 );
+        }
+        else if ( *p == 'F' )  {
+            *opcode = i ? I_LOADFP : I_STOREFP;
+            *operand = (int) strtol( p + 2, NULL, 10 );
+        }
+        else if ( *p == '[' )  {
+            *opcode = i ? I_LOADSP : I_STORESP;
+            *operand = (int) strtol( p + 4, NULL, 10 );
+        }
+        else  {
+            *opcode = i ? I_LOADA : I_STOREA;
+            *operand = (int) strtol( p, NULL, 10 );
+        }
+        return 1;
+    }
+    for ( i = 0; i < (int) ( sizeof( Mnemonics ) / sizeof( Mnemonics[0] ) ); i++ )  {
+        if ( length == (int) strlen( Mnemonics[i].Mnemonic ) &&
+             0 == strncmp( word, Mnemonics[i].Mnemonic, length ) )  {
+            *opcode = Mnemonics[i].Opcode;
+            if ( Mnemonics[i].HasOperand )  *operand = (int) strtol( p, NULL, 10 );
+            return 1;
+        }
+    }
+    return 0;
+}
+
+PRIVATE unsigned long Checksum( unsigned long sum, int opcode, int operand )
+{
+    return sum * 65599UL + (unsigned long) opcode * 31UL + (unsigned long) operand;
+}
+
+PRIVATE double Seconds( clock_t start )
+{
+    return (double) ( clock() - start ) / CLOCKS_PER_SEC;
+}
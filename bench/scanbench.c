@@ -0,0 +1,138 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      scanbench.c                                                          */
+/*                                                                           */
+/*      Scanner microbenchmark.  Usage:                                      */
+/*                                                                           */
+/*          scanbench <source file> [passes]                                 */
+/*                                                                           */
+/*      Times "GetToken" over the whole file (tokens/sec), then takes        */
+/*      every identifier and keyword seen and times classifying them with    */
+/*      the old binary search over the token name table (one strncmp per     */
+/*      probe) against "LookupKeyword".  Both timings are reported so the    */
+/*      two approaches can be compared on the same input.                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "global.h"
+#include "scanner.h"
+#include "line.h"
+#include "context.h"
+
+#define  MAX_WORDS   200000
+#define  WORD_LEN    32
+
+PRIVATE char *Keywords[] =  {
+    "BEGIN", "DO", "ELSE", "END", "IF", "PROCEDURE", "PROGRAM", "READ",
+    "REF", "THEN", "VAR", "WHILE", "WRITE"
+};
+
+PRIVATE char Words[MAX_WORDS][WORD_LEN];
+PRIVATE int  WordLen[MAX_WORDS];
+PRIVATE int  WordCount;
+
+PRIVATE int    SearchKeywords( char *s );
+PRIVATE void   Remember( char *s );
+PRIVATE double Seconds( clock_t start );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    CONTEXT *ctx;
+    FILE *fp;
+    TOKEN token;
+    clock_t start;
+    double t;
+    long tokens = 0, lookups, hits;
+    int passes = 1, p, i;
+
+    if ( argc < 2 )  {
+        fprintf( stderr, "usage: %s <source file> [passes]\n", argv[0] );
+        exit( EXIT_FAILURE );
+    }
+    if ( argc > 2 && ( passes = atoi( argv[2] ) ) < 1 )  passes = 1;
+
+    start = clock();
+    for ( p = 0; p < passes; p++ )  {
+        if ( NULL == ( fp = fopen( argv[1], "r" ) ) )  {
+            fprintf( stderr, "%s: cannot open \"%s\"\n", argv[0], argv[1] );
+            exit( EXIT_FAILURE );
+        }
+        ctx = MakeContext();
+        InitCharProcessor( ctx, fp, NULL );
+        do  {
+            token = GetToken( ctx );
+            tokens++;
+            if ( p == 0 && token.code >= BEGIN && token.code <= IDENTIFIER )  {
+                if ( token.code == IDENTIFIER )  Remember( token.s );
+                else  Remember( Keywords[token.code - BEGIN] );
+            }
+        }  while ( token.code != ENDOFINPUT );
+        FreeContext( ctx );
+        fclose( fp );
+    }
+    t = Seconds( start );
+    printf( "GetToken:        %ld tokens in %.3fs, %.0f tokens/sec\n",
+            tokens, t, t > 0.0 ? tokens / t : 0.0 );
+
+    if ( WordCount == 0 )  return EXIT_SUCCESS;
+    lookups = 0;  hits = 0;
+    start = clock();
+    for ( p = 0; p < 50 * passes; p++ )
+        for ( i = 0; i < WordCount; i++, lookups++ )
+            hits += SearchKeywords( Words[i] ) != IDENTIFIER;
+    t = Seconds( start );
+    printf( "binary search:   %ld lookups (%ld keywords) in %.3fs, %.0f lookups/sec\n",
+            lookups, hits, t, t > 0.0 ? lookups / t : 0.0 );
+
+    lookups = 0;  hits = 0;
+    start = clock();
+    for ( p = 0; p < 50 * passes; p++ )
+        for ( i = 0; i < WordCount; i++, lookups++ )
+            hits += LookupKeyword( Words[i], WordLen[i] ) != IDENTIFIER;
+    t = Seconds( start );
+    printf( "LookupKeyword:   %ld lookups (%ld keywords) in %.3fs, %.0f lookups/sec\n",
+            lookups, hits, t, t > 0.0 ? lookups / t : 0.0 );
+    return EXIT_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      SearchKeywords: the keyword search GetToken used before              */
+/*      LookupKeyword, a binary search of the sorted keyword names with      */
+/*      strncmp, kept here as the baseline.                                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE int SearchKeywords( char *s )
+{
+    int lo = 0, hi = (int) ( sizeof( Keywords ) / sizeof( Keywords[0] ) );
+    int mid, lastmid = -1, cmp;
+
+    for ( ;; )  {
+        mid = ( lo + hi ) / 2;
+        if ( mid == lastmid )  return IDENTIFIER;
+        lastmid = mid;
+        if ( 0 == ( cmp = strncmp( s, Keywords[mid], 30 ) ) )  return BEGIN + mid;
+        else if ( cmp < 0 )  hi = mid;
+        else  lo = mid;
+    }
+}
+
+PRIVATE void Remember( char *s )
+{
+    if ( WordCount < MAX_WORDS )  {
+        strncpy( Words[WordCount], s, WORD_LEN - 1 );
+        Words[WordCount][WORD_LEN-1] = '\0';
+        WordLen[WordCount] = (int) strlen( Words[WordCount] );
+        WordCount++;
+    }
+}
+
+PRIVATE double Seconds( clock_t start )
+{
+    return (double) ( clock() - start ) / CLOCKS_PER_SEC;
+}
@@ -0,0 +1,141 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      symbench.c                                                           */
+/*                                                                           */
+/*      Symbol table benchmark.  Usage:                                      */
+/*                                                                           */
+/*          symbench [procedures] [locals] [runs]                            */
+/*                                                                           */
+/*      Makes the symbol table calls the parser makes for a program of       */
+/*      "procedures" (default 10000) procedures side by side, each with      */
+/*      "locals" (default 4) local variables: the procedure name is entered  */
+/*      at scope 0, its locals at scope 1, every name is looked up a few     */
+/*      times and "RemoveSymbols" then leaves scope 1.  Each distinct name   */
+/*      is interned once first, as the scanner would.  Reports procedures    */
+/*      per second, best of "runs" (default 5), and the statistics of the   */
+/*      tables (see ATOMSTATS and SYMBOLSTATS) at the end of the last run.   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "global.h"
+#include "symbol.h"
+#include "strtab.h"
+#include "context.h"
+
+#define  NAME_LEN    16
+#define  LOOKUPS      4                 /* Probes of each local              */
+
+PRIVATE char   *MakeNames( char *prefix, int count );
+PRIVATE long   Run( char *procnames, char *localnames, int procedures, int locals,
+                    ATOMSTATS *atomstats, SYMBOLSTATS *stats );
+PRIVATE double Seconds( clock_t start );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    char *procnames, *localnames;
+    ATOMSTATS atomstats;
+    SYMBOLSTATS stats;
+    clock_t start;
+    double t, best = -1.0;
+    long found = 0;
+    int procedures = 10000, locals = 4, runs = 5, r;
+
+    if ( argc > 1 && ( procedures = atoi( argv[1] ) ) < 1 )  procedures = 1;
+    if ( argc > 2 && ( locals = atoi( argv[2] ) ) < 0 )  locals = 0;
+    if ( argc > 3 && ( runs = atoi( argv[3] ) ) < 1 )  runs = 1;
+    procnames = MakeNames( "proc", procedures );
+    localnames = MakeNames( "v", locals );
+
+    for ( r = 0; r < runs; r++ )  {
+        start = clock();
+        found = Run( procnames, localnames, procedures, locals, &atomstats, &stats );
+        t = Seconds( start );
+        if ( best < 0.0 || t < best )  best = t;
+    }
+    printf( "%d procedures, %d locals each: %.3fs, %.0f procedures/sec\n",
+            procedures, locals, best, best > 0.0 ? procedures / best : 0.0 );
+    printf( "%d atoms in %d slots (%d resizes): %ld lookups, %.2f slots visited and "
+            "%.2f names compared per lookup, longest %ld\n", atomstats.Atoms,
+            atomstats.Slots, atomstats.Resizes, atomstats.Lookups,
+            (double) atomstats.Steps / atomstats.Lookups,
+            (double) atomstats.Compares / atomstats.Lookups, atomstats.MaxSteps );
+    printf( "%ld probes; %d symbols in %d chains (%d resizes), longest chain %d\n",
+            stats.Probes, stats.Symbols, stats.Chains, stats.Resizes, stats.LongestChain );
+    printf( "symbols: %ld bytes allocated, peak %ld, %d blocks of memory; "
+            "strings: %ld bytes, %d blocks\n", stats.Memory.Bytes, stats.Memory.Peak,
+            stats.Memory.Blocks, atomstats.Memory.Bytes, atomstats.Memory.Blocks );
+    if ( found != (long) procedures * ( 1 + locals * LOOKUPS ) )
+        printf( "lookups found %ld symbols, expected %ld\n",
+                found, (long) procedures * ( 1 + locals * LOOKUPS ) );
+
+    free( procnames );
+    free( localnames );
+    return EXIT_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  "count" names "<prefix>0", "<prefix>1", ..., NAME_LEN characters apart.  */
+
+PRIVATE char *MakeNames( char *prefix, int count )
+{
+    char *names;
+    int i;
+
+    if ( NULL == ( names = malloc( (size_t) ( count + 1 ) * NAME_LEN ) ) )  {
+        fprintf( stderr, "symbench: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    for ( i = 0; i < count; i++ )  sprintf( names + i * NAME_LEN, "%.4s%d", prefix, i );
+    return names;
+}
+
+/*  Returns the number of successful lookups, as a check.                    */
+
+PRIVATE long Run( char *procnames, char *localnames, int procedures, int locals,
+                  ATOMSTATS *atomstats, SYMBOLSTATS *stats )
+{
+    CONTEXT *ctx = MakeContext();
+    SYMBOL *sptr;
+    long found = 0;
+    int *procatoms, *localatoms, p, i, n;
+
+    if ( NULL == ( procatoms = malloc( (size_t) ( procedures + locals + 1 ) * sizeof( int ) ) ) )  {
+        fprintf( stderr, "symbench: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    localatoms = procatoms + procedures;
+    for ( p = 0; p < procedures; p++ )  procatoms[p] = InternName( ctx, procnames + p * NAME_LEN );
+    for ( i = 0; i < locals; i++ )  localatoms[i] = InternName( ctx, localnames + i * NAME_LEN );
+
+    for ( p = 0; p < procedures; p++ )  {
+        Probe( ctx, procatoms[p] );
+        if ( NULL != ( sptr = EnterSymbol( ctx, procatoms[p] ) ) )  sptr->scope = 0;
+        for ( i = 0; i < locals; i++ )  {
+            Probe( ctx, localatoms[i] );
+            if ( NULL != ( sptr = EnterSymbol( ctx, localatoms[i] ) ) )  sptr->scope = 1;
+        }
+        for ( n = 0; n < LOOKUPS; n++ )
+            for ( i = 0; i < locals; i++ )
+                if ( NULL != Probe( ctx, localatoms[i] ) )  found++;
+        RemoveSymbols( ctx, 1 );
+        if ( NULL != Probe( ctx, procatoms[p] ) )  found++;
+    }
+    GetAtomStats( ctx, atomstats );
+    GetSymbolStats( ctx, stats );
+    FreeContext( ctx );
+    free( procatoms );
+    return found;
+}
+
+PRIVATE double Seconds( clock_t start )
+{
+    return (double) ( clock() - start ) / CLOCKS_PER_SEC;
+}
@@ -0,0 +1,123 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      vmbench.c                                                            */
+/*                                                                           */
+/*      VM microbenchmark.  Usage:                                           */
+/*                                                                           */
+/*          vmbench [iterations] [runs]                                      */
+/*                                                                           */
+/*      Emits a loop that sums the integers iterations .. 1 in a global and  */
+/*      then calls a procedure that does the same with a local, runs it on   */
+/*      the VM and reports instructions/sec.  "make vmbench" builds it       */
+/*      twice, as bench/vmbench (threaded dispatch) and bench/vmbench-switch */
+/*      (switch dispatch), so the two can be compared.                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "global.h"
+#include "code.h"
+#include "vm.h"
+#include "context.h"
+
+PRIVATE void EmitProgram( CONTEXT *ctx, int iterations );
+
+PUBLIC int main( int argc, char *argv[] )
+{
+    CONTEXT *ctx;
+    VM *vm;
+    SINK code;
+    clock_t start;
+    double t;
+    long instructions = 0;
+    int iterations = 10000000, runs = 5, r, status = VM_HALTED;
+
+    if ( argc > 1 && ( iterations = atoi( argv[1] ) ) < 1 )  iterations = 1;
+    if ( argc > 2 && ( runs = atoi( argv[2] ) ) < 1 )  runs = 1;
+    InitBufferSink( &code );
+    ctx = MakeContext();
+    InitCodeGenerator( ctx, &code );
+    EmitProgram( ctx, iterations );
+    if ( NULL == ( vm = LoadVM( ctx, VM_DEFAULT_MEMORY ) ) )  exit( EXIT_FAILURE );
+
+    start = clock();
+    for ( r = 0; r < runs && status == VM_HALTED; r++ )  {
+        status = RunVM( vm, stdin, stdout );
+        instructions += VMInstructionCount( vm );
+    }
+    t = (double) ( clock() - start ) / CLOCKS_PER_SEC;
+    if ( status != VM_HALTED )  fprintf( stderr, "Run time error: %s\n", VMErrorString( status ) );
+    printf( "RunVM:           %ld instructions in %.3fs, %.0f instructions/sec\n",
+            instructions, t, t > 0.0 ? instructions / t : 0.0 );
+
+    FreeVM( vm );
+    FreeContext( ctx );
+    FreeSink( &code );
+    return status == VM_HALTED ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      EmitProgram: the benchmark program.  Globals 0 and 1 are the counter */
+/*      and the sum of the main loop; the procedure keeps its counter and    */
+/*      sum at FP+1 and FP+2 (FP+0 is the return address).                   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void EmitProgram( CONTEXT *ctx, int iterations )
+{
+    int loop, done, proc, skip;
+
+    skip = CurrentCodeAddress( ctx );
+    Emit( ctx, I_BR, 9999 );
+
+    proc = CurrentCodeAddress( ctx );           /* procedure body            */
+    Emit( ctx, I_INC, 2 );
+    Emit( ctx, I_LOADI, iterations );
+    Emit( ctx, I_STOREFP, 1 );
+    loop = CurrentCodeAddress( ctx );
+    Emit( ctx, I_LOADFP, 1 );
+    done = CurrentCodeAddress( ctx );
+    Emit( ctx, I_BZ, 9999 );
+    Emit( ctx, I_LOADFP, 2 );
+    Emit( ctx, I_LOADFP, 1 );
+    _Emit( ctx, I_ADD );
+    Emit( ctx, I_STOREFP, 2 );
+    Emit( ctx, I_LOADFP, 1 );
+    Emit( ctx, I_LOADI, 1 );
+    _Emit( ctx, I_SUB );
+    Emit( ctx, I_STOREFP, 1 );
+    Emit( ctx, I_BR, loop );
+    BackPatch( ctx, done, CurrentCodeAddress( ctx ) );
+    Emit( ctx, I_LOADFP, 2 );
+    _Emit( ctx, I_WRITE );
+    Emit( ctx, I_DEC, 2 );
+    _Emit( ctx, I_RET );
+
+    BackPatch( ctx, skip, CurrentCodeAddress( ctx ) );
+    Emit( ctx, I_LOADI, iterations );           /* main program              */
+    Emit( ctx, I_STOREA, 0 );
+    loop = CurrentCodeAddress( ctx );
+    Emit( ctx, I_LOADA, 0 );
+    done = CurrentCodeAddress( ctx );
+    Emit( ctx, I_BZ, 9999 );
+    Emit( ctx, I_LOADA, 1 );
+    Emit( ctx, I_LOADA, 0 );
+    _Emit( ctx, I_ADD );
+    Emit( ctx, I_STOREA, 1 );
+    Emit( ctx, I_LOADA, 0 );
+    Emit( ctx, I_LOADI, 1 );
+    _Emit( ctx, I_SUB );
+    Emit( ctx, I_STOREA, 0 );
+    Emit( ctx, I_BR, loop );
+    BackPatch( ctx, done, CurrentCodeAddress( ctx ) );
+    Emit( ctx, I_LOADA, 1 );
+    _Emit( ctx, I_WRITE );
+    _Emit( ctx, I_PUSHFP );
+    _Emit( ctx, I_BSF );
+    Emit( ctx, I_CALL, proc );
+    _Emit( ctx, I_RSF );
+    _Emit( ctx, I_HALT );
+}
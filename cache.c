@@ -0,0 +1,429 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      cache.c                                                              */
+/*                                                                           */
+/*      On-disk compile cache.  Each entry is a file "<key>.entry" in the    */
+/*      cache directory, holding a one-line header followed by the listing   */
+/*      and the code.  The key is a 64-bit hash (two 32-bit FNV-1a hashes    */
+/*      with different bases) of the options string and the source; the      */
+/*      header also records the source length and a third hash, which must   */
+/*      match before an entry is used.  Entries are written to a temporary   */
+/*      file and renamed into place, so concurrent compilers never see a     */
+/*      partial entry.  A hit touches its entry, so the modification times   */
+/*      order the entries by use, and the oldest are removed while the       */
+/*      total size is over the limit.                                        */
+/*                                                                           */
+/*      Hits, misses, evictions and the compile time saved are kept, across  */
+/*      runs, in the file "stats" in the cache directory, which is locked    */
+/*      while it is updated.                                                 */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "global.h"
+#include "cache.h"
+
+#define  CACHE_VERSION          1       /* of the entry format               */
+#define  ENTRY_SUFFIX           ".entry"
+#define  STATS_NAME             "stats"
+#define  MAX_HEADER           256       /* bytes in an entry header          */
+
+typedef struct  {
+    char   *Name;
+    long   Size;
+    time_t Used;
+}
+    ENTRY;
+
+struct compilecache  {
+    char          *Dir;
+    long          Limit;                /* bytes                             */
+    char          Key[17];              /* of the last lookup, in hex        */
+    unsigned long Check;                /* its third hash                    */
+    unsigned long SourceLength;
+    int           Looked;               /* a lookup has set the key          */
+    int           Hit;                  /* and found an entry                */
+    double        HitSaved;             /* compile seconds the hit replaced  */
+    int           Evicted;              /* entries removed by this run       */
+    CACHESTATS    Stats;                /* as last read from "stats"         */
+};
+
+PRIVATE unsigned long Hash( unsigned long h, const char *p, size_t length );
+PRIVATE char   *ReadWhole( char *filename, size_t *length );
+PRIVATE int    WriteWhole( char *filename, const char *text, size_t length );
+PRIVATE char   *Path( COMPILECACHE *cache, char *name, char *suffix );
+PRIVATE void   Evict( COMPILECACHE *cache );
+PRIVATE int    CompareEntries( const void *a, const void *b );
+PRIVATE void   UpdateStats( COMPILECACHE *cache, long hits, long misses, long evictions,
+                            double saved );
+PRIVATE void   *Allocate( size_t size );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      OpenCache: the cache in directory "dirname", which is created if     */
+/*      need be, limited to "limit" megabytes.  Returns NULL, after saying   */
+/*      why, if the directory cannot be used.                                */
+/*                                                                           */
+/*      CloseCache: release a cache.  The directory is left as it is.        */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC COMPILECACHE *OpenCache( char *dirname, long limit )
+{
+    COMPILECACHE *cache;
+    struct stat sb;
+
+    if ( 0 != mkdir( dirname, 0777 ) && errno != EEXIST )  {
+        fprintf( stderr, "cannot create cache directory \"%s\": %s\n", dirname,
+                 strerror( errno ) );
+        return NULL;
+    }
+    if ( 0 != stat( dirname, &sb ) || !S_ISDIR( sb.st_mode ) )  {
+        fprintf( stderr, "\"%s\" is not a cache directory\n", dirname );
+        return NULL;
+    }
+    cache = Allocate( sizeof( COMPILECACHE ) );
+    memset( cache, 0, sizeof( COMPILECACHE ) );
+    cache->Dir = Allocate( strlen( dirname ) + 1 );
+    strcpy( cache->Dir, dirname );
+    cache->Limit = ( limit > 0 ? limit : CACHE_DEFAULT_LIMIT ) * 1024L * 1024L;
+    return cache;
+}
+
+PUBLIC void CloseCache( COMPILECACHE *cache )
+{
+    if ( cache != NULL )  {
+        free( cache->Dir );
+        free( cache );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      CacheLookup: look for the compilation of "inputname" with            */
+/*      "options", a string naming the compiler version and every option     */
+/*      that changes its output.  On a hit, the listing and code are         */
+/*      written to "listname" and "codename", "*valid" is set to say         */
+/*      whether the program was valid, and 1 is returned.  Otherwise         */
+/*      returns 0, and "CacheStore" should be called once the source has     */
+/*      been compiled.                                                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int CacheLookup( COMPILECACHE *cache, char *inputname, char *options,
+                        char *listname, char *codename, int *valid )
+{
+    FILE *fp;
+    char *source, *path, *text = NULL;
+    size_t length, olength = strlen( options ) + 1;
+    unsigned long srclen, check, listlen, codelen;
+    double seconds;
+    int version, ok;
+
+    cache->Looked = cache->Hit = 0;
+    if ( NULL == ( source = ReadWhole( inputname, &length ) ) )  return 0;
+    sprintf( cache->Key, "%08lx%08lx",
+             Hash( Hash( 2166136261UL, options, olength ), source, length ),
+             Hash( Hash( 3735928559UL, options, olength ), source, length ) );
+    cache->Check = Hash( Hash( 1540483477UL, source, length ), options, olength );
+    cache->SourceLength = (unsigned long) length;
+    cache->Looked = 1;
+    free( source );
+
+    path = Path( cache, cache->Key, ENTRY_SUFFIX );
+    if ( NULL == ( fp = fopen( path, "rb" ) ) )  {
+        free( path );
+        return 0;
+    }
+    ok = 7 == fscanf( fp, "CPLCACHE %d %lu %lu %d %lf %lu %lu", &version, &srclen, &check,
+                      valid, &seconds, &listlen, &codelen ) &&
+         '\n' == getc( fp ) && version == CACHE_VERSION && srclen == cache->SourceLength &&
+         check == cache->Check && NULL != ( text = malloc( listlen + codelen + 1 ) ) &&
+         listlen + codelen == fread( text, 1, listlen + codelen, fp ) &&
+         WriteWhole( listname, text, listlen ) &&
+         WriteWhole( codename, text + listlen, codelen );
+    fclose( fp );
+    free( text );
+    if ( ok )  {
+        utime( path, NULL );
+        cache->Hit = 1;
+        cache->HitSaved = seconds;
+        UpdateStats( cache, 1, 0, 0, seconds );
+    }
+    free( path );
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      CacheStore: after a lookup that missed, enter the listing and code   */
+/*      just written to "listname" and "codename" under the lookup's key,    */
+/*      with "valid" and the "seconds" the compilation took, then evict      */
+/*      entries until the cache is within its limit.                         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void CacheStore( COMPILECACHE *cache, char *listname, char *codename,
+                        int valid, double seconds )
+{
+    FILE *fp;
+    char *listing, *code, *path, *temp, name[64];
+    size_t listlen, codelen;
+    int ok;
+
+    if ( !cache->Looked || cache->Hit )  return;
+    listing = ReadWhole( listname, &listlen );
+    code = ReadWhole( codename, &codelen );
+    if ( listing != NULL && code != NULL )  {
+        sprintf( name, "%s.%ld", cache->Key, (long) getpid() );
+        temp = Path( cache, name, ".tmp" );
+        path = Path( cache, cache->Key, ENTRY_SUFFIX );
+        if ( NULL != ( fp = fopen( temp, "wb" ) ) )  {
+            fprintf( fp, "CPLCACHE %d %lu %lu %d %.6f %lu %lu\n", CACHE_VERSION,
+                     cache->SourceLength, cache->Check, valid ? 1 : 0, seconds,
+                     (unsigned long) listlen, (unsigned long) codelen );
+            ok = listlen == fwrite( listing, 1, listlen, fp ) &&
+                 codelen == fwrite( code, 1, codelen, fp );
+            if ( 0 != fclose( fp ) || !ok || 0 != rename( temp, path ) )  remove( temp );
+        }
+        free( temp );
+        free( path );
+    }
+    free( listing );
+    free( code );
+    Evict( cache );
+    UpdateStats( cache, 0, 1, cache->Evicted, 0.0 );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetCacheStats: the totals for the cache directory, as of the last    */
+/*      lookup or store, with the entries now in it counted afresh.          */
+/*                                                                           */
+/*      ReportCache: write what this run did and those totals to "fp".       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void GetCacheStats( COMPILECACHE *cache, CACHESTATS *stats )
+{
+    DIR *dir;
+    struct dirent *d;
+    struct stat sb;
+    char *path;
+    size_t length, suffix = strlen( ENTRY_SUFFIX );
+
+    *stats = cache->Stats;
+    stats->Bytes = 0;
+    stats->Entries = 0;
+    if ( NULL == ( dir = opendir( cache->Dir ) ) )  return;
+    while ( NULL != ( d = readdir( dir ) ) )  {
+        length = strlen( d->d_name );
+        if ( length > suffix && 0 == strcmp( d->d_name + length - suffix, ENTRY_SUFFIX ) )  {
+            path = Path( cache, d->d_name, "" );
+            if ( 0 == stat( path, &sb ) )  {
+                stats->Bytes += (long) sb.st_size;
+                stats->Entries++;
+            }
+            free( path );
+        }
+    }
+    closedir( dir );
+}
+
+PUBLIC void ReportCache( COMPILECACHE *cache, FILE *fp )
+{
+    CACHESTATS stats;
+    long lookups;
+
+    GetCacheStats( cache, &stats );
+    lookups = stats.Hits + stats.Misses;
+    if ( cache->Hit )  fprintf( fp, "cache hit: %.3fs of compiling saved\n", cache->HitSaved );
+    else if ( cache->Looked )  fprintf( fp, "cache miss: entry %s stored\n", cache->Key );
+    fprintf( fp, "cache: %ld hits, %ld misses (%.1f%% hits), %.3fs saved; "
+             "%d entries, %ld KB of %ld KB, %ld evictions\n",
+             stats.Hits, stats.Misses, lookups > 0 ? 100.0 * stats.Hits / lookups : 0.0,
+             stats.Saved, stats.Entries, stats.Bytes / 1024, cache->Limit / 1024,
+             stats.Evictions );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  32-bit FNV-1a, continuing from "h".                                      */
+
+PRIVATE unsigned long Hash( unsigned long h, const char *p, size_t length )
+{
+    while ( length-- > 0 )  h = ( ( h ^ (unsigned char) *p++ ) * 16777619UL ) & 0xffffffffUL;
+    return h;
+}
+
+/*  The whole of a file, in memory from malloc, or NULL.                     */
+
+PRIVATE char *ReadWhole( char *filename, size_t *length )
+{
+    FILE *fp;
+    char *text = NULL;
+    long size;
+
+    if ( NULL == ( fp = fopen( filename, "rb" ) ) )  return NULL;
+    if ( 0 == fseek( fp, 0L, SEEK_END ) && ( size = ftell( fp ) ) >= 0 &&
+         0 == fseek( fp, 0L, SEEK_SET ) && NULL != ( text = malloc( (size_t) size + 1 ) ) &&
+         (size_t) size != fread( text, 1, (size_t) size, fp ) )  {
+        free( text );
+        text = NULL;
+    }
+    else if ( text != NULL )  *length = (size_t) size;
+    fclose( fp );
+    return text;
+}
+
+PRIVATE int WriteWhole( char *filename, const char *text, size_t length )
+{
+    FILE *fp;
+    int ok;
+
+    if ( NULL == ( fp = fopen( filename, "wb" ) ) )  return 0;
+    ok = length == fwrite( text, 1, length, fp );
+    return 0 == fclose( fp ) && ok;
+}
+
+/*  "<dir>/<name><suffix>", from malloc.                                     */
+
+PRIVATE char *Path( COMPILECACHE *cache, char *name, char *suffix )
+{
+    char *path = Allocate( strlen( cache->Dir ) + strlen( name ) + strlen( suffix ) + 2 );
+
+    sprintf( path, "%s/%s%s", cache->Dir, name, suffix );
+    return path;
+}
+
+/*  Remove the least recently used entries until the total size of the       */
+/*  entries is within the limit.                                             */
+
+PRIVATE void Evict( COMPILECACHE *cache )
+{
+    DIR *dir;
+    struct dirent *d;
+    struct stat sb;
+    ENTRY *entries = NULL, *more;
+    char *path;
+    size_t length, suffix = strlen( ENTRY_SUFFIX );
+    long total = 0;
+    int count = 0, capacity = 0, i;
+
+    if ( NULL == ( dir = opendir( cache->Dir ) ) )  return;
+    while ( NULL != ( d = readdir( dir ) ) )  {
+        length = strlen( d->d_name );
+        if ( length <= suffix || 0 != strcmp( d->d_name + length - suffix, ENTRY_SUFFIX ) )
+            continue;
+        path = Path( cache, d->d_name, "" );
+        if ( 0 != stat( path, &sb ) )  {
+            free( path );
+            continue;
+        }
+        if ( count == capacity )  {
+            capacity = capacity == 0 ? 64 : 2 * capacity;
+            if ( NULL == ( more = realloc( entries, capacity * sizeof( ENTRY ) ) ) )  {
+                fprintf( stderr, "Fatal Error: Evict: out of memory\n" );
+                exit( EXIT_FAILURE );
+            }
+            entries = more;
+        }
+        entries[count].Name = path;
+        entries[count].Size = (long) sb.st_size;
+        entries[count].Used = sb.st_mtime;
+        total += (long) sb.st_size;
+        count++;
+    }
+    closedir( dir );
+
+    if ( total > cache->Limit )  {
+        qsort( entries, count, sizeof( ENTRY ), CompareEntries );
+        for ( i = 0; i < count && total > cache->Limit; i++ )  {
+            if ( 0 == remove( entries[i].Name ) )  {
+                total -= entries[i].Size;
+                cache->Evicted++;
+            }
+        }
+    }
+    for ( i = 0; i < count; i++ )  free( entries[i].Name );
+    free( entries );
+}
+
+/*  Least recently used first.                                               */
+
+PRIVATE int CompareEntries( const void *a, const void *b )
+{
+    time_t x = ( (const ENTRY *) a )->Used, y = ( (const ENTRY *) b )->Used;
+
+    return x < y ? -1 : x > y;
+}
+
+/*  Add to the counts in the "stats" file, holding a lock on it so that      */
+/*  compilers sharing the cache do not lose each other's updates, and keep   */
+/*  the new totals.                                                          */
+
+PRIVATE void UpdateStats( COMPILECACHE *cache, long hits, long misses, long evictions,
+                          double saved )
+{
+    struct flock lock;
+    CACHESTATS *stats = &cache->Stats;
+    char *path, text[MAX_HEADER];
+    ssize_t n;
+    int fd;
+
+    path = Path( cache, STATS_NAME, "" );
+    fd = open( path, O_RDWR | O_CREAT, 0666 );
+    free( path );
+    if ( fd < 0 )  return;
+    memset( &lock, 0, sizeof( lock ) );
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    while ( 0 != fcntl( fd, F_SETLKW, &lock ) )  {
+        if ( errno != EINTR )  {
+            close( fd );
+            return;
+        }
+    }
+    memset( stats, 0, sizeof( CACHESTATS ) );
+    if ( ( n = read( fd, text, sizeof( text ) - 1 ) ) > 0 )  {
+        text[n] = '\0';
+        sscanf( text, "%ld %ld %ld %lf", &stats->Hits, &stats->Misses, &stats->Evictions,
+                &stats->Saved );
+    }
+    stats->Hits += hits;
+    stats->Misses += misses;
+    stats->Evictions += evictions;
+    stats->Saved += saved;
+    sprintf( text, "%ld %ld %ld %.6f\n", stats->Hits, stats->Misses, stats->Evictions,
+             stats->Saved );
+    if ( 0 == lseek( fd, 0L, SEEK_SET ) &&
+         (ssize_t) strlen( text ) == write( fd, text, strlen( text ) ) )
+        ftruncate( fd, (off_t) strlen( text ) );
+    close( fd );
+}
+
+PRIVATE void *Allocate( size_t size )
+{
+    void *p;
+
+    if ( NULL == ( p = malloc( size ) ) )  {
+        fprintf( stderr, "Fatal Error: cache: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    return p;
+}
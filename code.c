@@ -0,0 +1,492 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      code.c                                                               */
+/*                                                                           */
+/*      Code generator for the CPL compiler.  Instructions are held in an    */
+/*      arena of fixed-size chunks which is extended one chunk at a time as  */
+/*      the program grows.  Chunks are never moved once allocated, so a      */
+/*      code address stays valid for the life of the compilation and         */
+/*      "BackPatch" can be applied to any instruction already emitted.  Only */
+/*      the (small) chunk directory is ever reallocated, so the cost of      */
+/*      growing the table is linear in the number of instructions emitted.   */
+/*                                                                           */
+/*      When streaming (see "StreamCode"), "FlushCode" writes out the code   */
+/*      emitted so far as soon as the parser knows it is final, and frees    */
+/*      the chunks it filled, so the table only ever holds the code that     */
+/*      may still be patched.                                                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "code.h"
+#include "context.h"
+#include "stats.h"
+
+#define  CODE_CHUNK_BITS       12       /* log2 of instructions per chunk    */
+#define  CODE_CHUNK_SIZE       (1 << CODE_CHUNK_BITS)
+#define  CODE_CHUNK_MASK       (CODE_CHUNK_SIZE - 1)
+#define  CODE_DIRECTORY_INIT   16       /* initial chunk directory slots     */
+
+typedef struct  {
+    int  opcode;
+    int  offset;
+}
+    INSTRUCTION;
+
+struct codetable  {
+    SINK        *Code;                  /* where the code is written         */
+    INSTRUCTION **CodeChunks;           /* directory of instruction chunks   */
+    int         ChunkCount;             /* chunks currently allocated        */
+    int         DirectorySize;          /* slots available in directory      */
+    int         CodePosition;
+    int         ErrorsInProgram;
+    int         Streaming;              /* set by StreamCode                 */
+    int         Flushed;                /* instructions already written      */
+    INSTRUCTION *Spare;                 /* freed chunk kept for reuse        */
+    long        CodeMemoryInUse;        /* bytes held by chunks + directory  */
+    long        CodeMemoryPeak;
+    CODESTATS   Stats;
+};
+
+#define  CodeAt(ct,addr)  ((ct)->CodeChunks[(addr) >> CODE_CHUNK_BITS][(addr) & CODE_CHUNK_MASK])
+
+PRIVATE void AddChunk( CODETABLE *ct );
+PRIVATE void ReleaseChunk( CODETABLE *ct, int chunk );
+PRIVATE void ReleaseChunks( CODETABLE *ct );
+PRIVATE void Output( CODETABLE *ct, int i );
+PRIVATE void OutputControlInst( CODETABLE *ct, char *s, int i );
+PRIVATE void OutputDataInst( CODETABLE *ct, char *s, int i );
+PRIVATE void OutputFPInst( CODETABLE *ct, char *s, int i );
+PRIVATE void OutputSPInst( CODETABLE *ct, char *s, int i );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      MakeCodeTable / FreeCodeTable: create an empty code table, and       */
+/*      release one together with any code in it.                            */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC CODETABLE *MakeCodeTable( void )
+{
+    CODETABLE *ct;
+
+    if ( NULL == ( ct = calloc( 1, sizeof( CODETABLE ) ) ) )  {
+        fprintf( stderr, "Fatal compiler error, unable to allocate code table\n" );
+        exit( EXIT_FAILURE );
+    }
+    return ct;
+}
+
+PUBLIC void FreeCodeTable( CODETABLE *ct )
+{
+    if ( ct != NULL )  {
+        ReleaseChunks( ct );
+        free( ct );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      InitCodeGenerator: set up the code generator to write its output to  */
+/*      "code".  Any code table left over from a previous compilation is     */
+/*      released, and streaming is off.                                      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void InitCodeGenerator( CONTEXT *ctx, SINK *code )
+{
+    CODETABLE *ct = ctx->code;
+
+    if ( code == NULL )  {
+        fprintf( stderr, "Fatal Error: InitCodeGenerator: attempt to\n" );
+        fprintf( stderr, "use an invalid sink (NULL) for output\n" );
+        exit( EXIT_FAILURE );
+    }
+    ct->Code = code;
+    ReleaseChunks( ct );
+    ct->CodePosition = 0;
+    ct->ErrorsInProgram = 0;
+    ct->Streaming = 0;
+    ct->Flushed = 0;
+    ct->CodeMemoryPeak = 0;
+    memset( &ct->Stats, 0, sizeof( ct->Stats ) );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      StreamCode: from now on let "FlushCode" write code out early.  The   */
+/*      caller must not need the code table once the code has been written   */
+/*      (no "Peephole", no VM, no object file).                              */
+/*                                                                           */
+/*      FlushCode: declare every instruction emitted so far final: none of   */
+/*      them will be patched, changed or read again.  If streaming, they     */
+/*      are written to the code file and the chunks they filled are freed.   */
+/*      Otherwise, or once code generation has been killed, does nothing.    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void StreamCode( CONTEXT *ctx )
+{
+    ctx->code->Streaming = 1;
+}
+
+PUBLIC void FlushCode( CONTEXT *ctx )
+{
+    CODETABLE *ct = ctx->code;
+    int chunk, was;
+
+    if ( !ct->Streaming || ct->ErrorsInProgram )  return;
+    EnterPhase( ctx, was, PHASE_WRITE );
+    while ( ct->Flushed < ct->CodePosition )  Output( ct, ct->Flushed++ );
+    for ( chunk = ( ct->Flushed >> CODE_CHUNK_BITS ) - 1;
+          chunk >= 0 && ct->CodeChunks[chunk] != NULL; chunk-- )
+        ReleaseChunk( ct, chunk );
+    LeavePhase( ctx, was );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      WriteCodeFile: write the contents of the code table to the code      */
+/*      sink (what "FlushCode" has not already written), unless code         */
+/*      generation has been killed, in which case a short note is written    */
+/*      instead, replacing any code already flushed if the sink allows it.   */
+/*      The sink is flushed afterwards, and no longer used.                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void WriteCodeFile( CONTEXT *ctx )
+{
+    CODETABLE *ct = ctx->code;
+    int i, was;
+
+    if ( ct->Code == NULL )  {
+        fprintf( stderr, "Fatal Error: WriteCodeFile: attempt to\n" );
+        fprintf( stderr, "use an invalid sink (NULL) for output\n" );
+        exit( EXIT_FAILURE );
+    }
+    EnterPhase( ctx, was, PHASE_WRITE );
+    if ( !ct->ErrorsInProgram )  {
+        for ( i = ct->Flushed; i < ct->CodePosition; i++ )  Output( ct, i );
+    }
+    else  {
+        if ( ct->Flushed > 0 )  RewindSink( ct->Code );
+        SinkPrintf( ct->Code, ";; Errors detected in input file, no code\n" );
+        SinkPrintf( ct->Code, ";; generated\n" );
+    }
+    FlushSink( ct->Code );
+    ct->Stats.Written = ct->ErrorsInProgram ? 0 : ct->CodePosition;
+    ct->Stats.Bytes = ct->Code->Written;
+    ct->Code = NULL;
+    LeavePhase( ctx, was );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      KillCodeGeneration: suppress output of the code file.                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void KillCodeGeneration( CONTEXT *ctx )
+{
+    ctx->code->ErrorsInProgram = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Emit: append an instruction to the code table, adding a new chunk    */
+/*      to the arena when the current one is full.                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void Emit( CONTEXT *ctx, int opcode, int offset )
+{
+    CODETABLE *ct = ctx->code;
+
+    ct->Stats.Emitted++;
+    if ( ( ct->CodePosition >> CODE_CHUNK_BITS ) >= ct->ChunkCount )  AddChunk( ct );
+    CodeAt( ct, ct->CodePosition ).opcode = opcode;
+    CodeAt( ct, ct->CodePosition ).offset = offset;
+    ct->CodePosition++;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      CurrentCodeAddress: address at which the next instruction will be    */
+/*      placed.                                                              */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int CurrentCodeAddress( CONTEXT *ctx )
+{
+    return ctx->code->CodePosition;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      BackPatch: overwrite the operand of the instruction at "codeaddr".   */
+/*      Only instructions that have been emitted, and not flushed, may be    */
+/*      patched.                                                             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void BackPatch( CONTEXT *ctx, int codeaddr, int value )
+{
+    CODETABLE *ct = ctx->code;
+
+    if ( codeaddr < ct->Flushed || codeaddr >= ct->CodePosition )  {
+        fprintf( stderr, "Fatal internal error, attempt to BackPatch to " );
+        fprintf( stderr, "location %d\n", codeaddr );
+        fprintf( stderr, "This location is outside the valid set of code " );
+        fprintf( stderr, "addresses, %d .. %d\n", ct->Flushed, ct->CodePosition - 1 );
+        exit( EXIT_FAILURE );
+    }
+    CodeAt( ct, codeaddr ).offset = value;
+    ct->Stats.BackPatches++;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      CodeMemoryHighWater: largest number of bytes held by the code table  */
+/*      (chunks plus chunk directory) since InitCodeGenerator was called.    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC long CodeMemoryHighWater( CONTEXT *ctx )
+{
+    return ctx->code->CodeMemoryPeak;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetCodeStats: copy the counts of instructions emitted, patched and   */
+/*      written since InitCodeGenerator (see CODESTATS) into "stats".  The   */
+/*      instructions and bytes written are only known once WriteCodeFile     */
+/*      has been called.                                                     */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void GetCodeStats( CONTEXT *ctx, CODESTATS *stats )
+{
+    *stats = ctx->code->Stats;
+    stats->MemoryPeak = CodeMemoryHighWater( ctx );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      CodeGenerationKilled: non-zero if "KillCodeGeneration" has been      */
+/*      called, i.e., the code table does not hold a usable program.         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int CodeGenerationKilled( CONTEXT *ctx )
+{
+    return ctx->code->ErrorsInProgram;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetInstruction: opcode of the instruction at "codeaddr", which must  */
+/*      be below "CurrentCodeAddress" and not flushed.  Its operand is       */
+/*      stored in "offset".                                                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int GetInstruction( CONTEXT *ctx, int codeaddr, int *offset )
+{
+    *offset = CodeAt( ctx->code, codeaddr ).offset;
+    return CodeAt( ctx->code, codeaddr ).opcode;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      SetInstruction: overwrite the instruction at "codeaddr", which must  */
+/*      already have been emitted and not flushed.                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void SetInstruction( CONTEXT *ctx, int codeaddr, int opcode, int offset )
+{
+    CodeAt( ctx->code, codeaddr ).opcode = opcode;
+    CodeAt( ctx->code, codeaddr ).offset = offset;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      TruncateCode: discard every instruction at "codeaddr" and beyond     */
+/*      (none that have been flushed).  The chunks stay allocated for the    */
+/*      following Emits.                                                     */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void TruncateCode( CONTEXT *ctx, int codeaddr )
+{
+    if ( codeaddr >= ctx->code->Flushed && codeaddr < ctx->code->CodePosition )
+        ctx->code->CodePosition = codeaddr;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ConstantArithmetic: the result of "a op b", where "op" is I_ADD,     */
+/*      I_SUB, I_MULT or I_DIV, stored in "result".  The arithmetic wraps    */
+/*      around exactly as it does when the VM runs the instruction, so       */
+/*      folding an operation never changes what the program computes.        */
+/*      Returns 0, leaving "result" alone, for division by zero.             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int ConstantArithmetic( int opcode, int a, int b, int *result )
+{
+    switch ( opcode )  {
+        case I_ADD:   *result = (int) ( (unsigned) a + (unsigned) b );  break;
+        case I_SUB:   *result = (int) ( (unsigned) a - (unsigned) b );  break;
+        case I_MULT:  *result = (int) ( (unsigned) a * (unsigned) b );  break;
+        default:
+            if ( b == 0 )  return 0;
+            *result = b == -1 ? (int) ( 0u - (unsigned) a ) : a / b;
+            break;
+    }
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void AddChunk( CODETABLE *ct )
+{
+    INSTRUCTION **newdir;
+    int newsize;
+
+    if ( ct->ChunkCount == ct->DirectorySize )  {
+        newsize = ct->DirectorySize == 0 ? CODE_DIRECTORY_INIT : 2 * ct->DirectorySize;
+        if ( NULL == ( newdir = realloc( ct->CodeChunks, newsize * sizeof( INSTRUCTION * ) ) ) )  {
+            fprintf( stderr, "Fatal compiler error, code table overflow\n" );
+            fprintf( stderr, "(unable to allocate %d chunk directory slots)\n", newsize );
+            exit( EXIT_FAILURE );
+        }
+        ct->CodeMemoryInUse += ( newsize - ct->DirectorySize ) * (long) sizeof( INSTRUCTION * );
+        ct->CodeChunks = newdir;
+        ct->DirectorySize = newsize;
+    }
+    if ( ct->Spare != NULL )  {
+        ct->CodeChunks[ct->ChunkCount++] = ct->Spare;
+        ct->Spare = NULL;
+        return;
+    }
+    if ( NULL == ( ct->CodeChunks[ct->ChunkCount] = malloc( CODE_CHUNK_SIZE * sizeof( INSTRUCTION ) ) ) )  {
+        fprintf( stderr, "Fatal compiler error, code table overflow\n" );
+        fprintf( stderr, "(unable to allocate space beyond %d instructions)\n", ct->CodePosition );
+        exit( EXIT_FAILURE );
+    }
+    ct->ChunkCount++;
+    ct->CodeMemoryInUse += CODE_CHUNK_SIZE * (long) sizeof( INSTRUCTION );
+    if ( ct->CodeMemoryInUse > ct->CodeMemoryPeak )  ct->CodeMemoryPeak = ct->CodeMemoryInUse;
+}
+
+/*  Free a flushed chunk, or keep it as the spare for the next AddChunk.     */
+
+PRIVATE void ReleaseChunk( CODETABLE *ct, int chunk )
+{
+    if ( ct->Spare == NULL )  ct->Spare = ct->CodeChunks[chunk];
+    else  {
+        free( ct->CodeChunks[chunk] );
+        ct->CodeMemoryInUse -= CODE_CHUNK_SIZE * (long) sizeof( INSTRUCTION );
+    }
+    ct->CodeChunks[chunk] = NULL;
+}
+
+PRIVATE void ReleaseChunks( CODETABLE *ct )
+{
+    while ( ct->ChunkCount > 0 )  free( ct->CodeChunks[--ct->ChunkCount] );
+    free( ct->Spare );
+    ct->Spare = NULL;
+    free( ct->CodeChunks );
+    ct->CodeChunks = NULL;
+    ct->DirectorySize = 0;
+    ct->CodeMemoryInUse = 0;
+}
+
+PRIVATE void Output( CODETABLE *ct, int i )
+{
+    if ( !ct->ErrorsInProgram )  {
+        SinkPrintf( ct->Code, "%3d  ", i );
+        switch ( CodeAt( ct, i ).opcode )  {
+            case I_ADD:     SinkPrintf( ct->Code, "Add\n" );           break;
+            case I_SUB:     SinkPrintf( ct->Code, "Sub\n" );           break;
+            case I_MULT:    SinkPrintf( ct->Code, "Mult\n" );          break;
+            case I_DIV:     SinkPrintf( ct->Code, "Div\n" );           break;
+            case I_NEG:     SinkPrintf( ct->Code, "Neg\n" );           break;
+            case I_RET:     SinkPrintf( ct->Code, "Ret\n" );           break;
+            case I_BSF:     SinkPrintf( ct->Code, "Bsf\n" );           break;
+            case I_RSF:     SinkPrintf( ct->Code, "Rsf\n" );           break;
+            case I_PUSHFP:  SinkPrintf( ct->Code, "Push  FP\n" );      break;
+            case I_READ:    SinkPrintf( ct->Code, "Read\n" );          break;
+            case I_WRITE:   SinkPrintf( ct->Code, "Write\n" );         break;
+            case I_HALT:    SinkPrintf( ct->Code, "Halt\n" );          break;
+            case I_BR:      OutputControlInst( ct, "Br  ", i );         break;
+            case I_BGZ:     OutputControlInst( ct, "Bgz ", i );         break;
+            case I_BG:      OutputControlInst( ct, "Bg  ", i );         break;
+            case I_BLZ:     OutputControlInst( ct, "Blz ", i );         break;
+            case I_BL:      OutputControlInst( ct, "Bl  ", i );         break;
+            case I_BZ:      OutputControlInst( ct, "Bz  ", i );         break;
+            case I_BNZ:     OutputControlInst( ct, "Bnz ", i );         break;
+            case I_CALL:    OutputControlInst( ct, "Call", i );         break;
+            case I_LDP:     OutputControlInst( ct, "Ldp ", i );         break;
+            case I_RDP:     OutputControlInst( ct, "Rdp ", i );         break;
+            case I_INC:     OutputControlInst( ct, "Inc ", i );         break;
+            case I_DEC:     OutputControlInst( ct, "Dec ", i );         break;
+            case I_LOADI:
+                SinkPrintf( ct->Code, "Load  #%-4d\n", CodeAt( ct, i ).offset );
+                break;
+            case I_LOADA:   OutputDataInst( ct, "Load ", i );           break;
+            case I_LOADFP:  OutputFPInst( ct, "Load ", i );             break;
+            case I_LOADSP:  OutputSPInst( ct, "Load ", i );             break;
+            case I_STOREA:  OutputDataInst( ct, "Store", i );           break;
+            case I_STOREFP: OutputFPInst( ct, "Store", i );             break;
+            case I_STORESP: OutputSPInst( ct, "Store", i );             break;
+            default:
+                SinkPrintf( ct->Code, "Fatal compiler error, unknown opcode %d\n",
+                         CodeAt( ct, i ).opcode );
+                FlushSink( ct->Code );
+                fprintf( stderr, "Fatal compiler error, unknown opcode %d\n",
+                         CodeAt( ct, i ).opcode );
+                fprintf( stderr, "Code address %d\n", i );
+                exit( EXIT_FAILURE );
+        }
+    }
+}
+
+PRIVATE void OutputControlInst( CODETABLE *ct, char *s, int i )
+{
+    SinkPrintf( ct->Code, "%s  %-4d\n", s, CodeAt( ct, i ).offset );
+}
+
+PRIVATE void OutputDataInst( CODETABLE *ct, char *s, int i )
+{
+    SinkPrintf( ct->Code, "%s %-4d\n", s, CodeAt( ct, i ).offset );
+}
+
+PRIVATE void OutputFPInst( CODETABLE *ct, char *s, int i )
+{
+    int offset = CodeAt( ct, i ).offset;
+
+    SinkPrintf( ct->Code, "%s FP", s );
+    if ( offset == 0 )  SinkPutc( ct->Code, '\n' );
+    else if ( offset > 0 )  SinkPrintf( ct->Code, "+%-4d\n", offset );
+    else  SinkPrintf( ct->Code, "%-4d\n", offset );
+}
+
+PRIVATE void OutputSPInst( CODETABLE *ct, char *s, int i )
+{
+    int offset = CodeAt( ct, i ).offset;
+
+    SinkPrintf( ct->Code, "%s [SP]", s );
+    if ( offset == 0 )  SinkPutc( ct->Code, '\n' );
+    else if ( offset > 0 )  SinkPrintf( ct->Code, "+%-4d\n", offset );
+    else  SinkPrintf( ct->Code, "%-4d\n", offset );
+}
@@ -0,0 +1,91 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      context.c                                                            */
+/*                                                                           */
+/*      Creation and destruction of compiler CONTEXTs.                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "context.h"
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      MakeContext: a new CONTEXT with every module in its initial state    */
+/*      and the parser state zeroed.  The files are attached by              */
+/*      InitCharProcessor and InitCodeGenerator.                             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC CONTEXT *MakeContext( void )
+{
+    CONTEXT *ctx;
+
+    if ( NULL == ( ctx = calloc( 1, sizeof( CONTEXT ) ) ) )  {
+        fprintf( stderr, "Fatal Error: MakeContext: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    ctx->line   = MakeCharProcessor();
+    ctx->strtab = MakeStringTable();
+    ctx->symtab = MakeSymbolTable();
+    ctx->code   = MakeCodeTable();
+    ctx->lookahead = MakeTokenArray();
+    return ctx;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ResetContext: return a CONTEXT that has been used for a compilation  */
+/*      to the state MakeContext leaves it in, but keeping the memory its    */
+/*      string and symbol tables have got, and the error recovery sets, so   */
+/*      a server compiling one small program after another neither           */
+/*      allocates the tables nor forms the sets each time.  The code table   */
+/*      and character processor are reset by InitCodeGenerator and           */
+/*      InitCharProcessor as usual, and the token array by StartTokens.      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void ResetContext( CONTEXT *ctx )
+{
+    CONTEXT modules;
+
+    modules = *ctx;
+    memset( ctx, 0, sizeof( CONTEXT ) );
+    ctx->line   = modules.line;
+    ctx->strtab = modules.strtab;
+    ctx->symtab = modules.symtab;
+    ctx->code   = modules.code;
+    ctx->lookahead = modules.lookahead;
+    ctx->StatementFS_aug = modules.StatementFS_aug;
+    ctx->StatementFBS = modules.StatementFBS;
+    ctx->DeclarationFS_aug = modules.DeclarationFS_aug;
+    ctx->ProcDeclarationFS_aug = modules.ProcDeclarationFS_aug;
+    ctx->ProcDeclarationFBS = modules.ProcDeclarationFBS;
+    ctx->StatementSync = modules.StatementSync;
+    ctx->DeclarationSync = modules.DeclarationSync;
+    ctx->ProcDeclarationSync = modules.ProcDeclarationSync;
+    ResetStringTable( ctx->strtab );
+    ResetSymbolTable( ctx->symtab );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      FreeContext: release a CONTEXT and everything its modules hold.      */
+/*      The caller's files are not closed.                                   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void FreeContext( CONTEXT *ctx )
+{
+    if ( ctx != NULL )  {
+        FreeTokenArray( ctx->lookahead );
+        FreeCodeTable( ctx->code );
+        FreeSymbolTable( ctx->symtab );
+        FreeStringTable( ctx->strtab );
+        FreeCharProcessor( ctx->line );
+        free( ctx );
+    }
+}
@@ -0,0 +1,465 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      daemon.c                                                             */
+/*                                                                           */
+/*      Compile server.  One thread, the poller, accepts connections and     */
+/*      watches every open one that is between requests.  When a request     */
+/*      starts to arrive on one, the poller queues the connection for a      */
+/*      fixed pool of worker threads; the worker that takes it serves that   */
+/*      one request, through the caller's DAEMONCOMPILER, and hands the      */
+/*      connection back to the poller.  So a worker is only ever busy with   */
+/*      a request, and clients that stay connected between requests tie up   */
+/*      no workers.  A connection is closed once the client closes it, or    */
+/*      after IDLE_SECONDS between requests (or in the middle of one).       */
+/*      Each worker keeps its compiler state (DAEMONREQUEST.State) from one  */
+/*      request to the next, so only the first compile on a worker pays to   */
+/*      set it up.  SIGINT or SIGTERM stops the server, removing the socket  */
+/*      and reporting what was served.                                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "global.h"
+#include "daemon.h"
+
+#define  MAX_THREADS        256     /* upper limit on the pool size          */
+#define  LISTEN_QUEUE       128     /* connections waiting for a worker      */
+#define  IDLE_SECONDS        10     /* an idle connection is closed after    */
+#define  MAX_CONNECTIONS   1024     /* open at once; more wait in the queue  */
+#define  POLL_MS           1000     /* how often idle connections are timed  */
+
+typedef struct server  SERVER;
+
+typedef struct  {
+    pthread_t       Thread;
+    SERVER          *Server;
+}
+    WORKER;
+
+struct server  {
+    int             Socket;         /* the listening socket                  */
+    DAEMONCOMPILER  Compile;
+    int             Wake[2];        /* a pipe, written to wake the poller    */
+    pthread_mutex_t Lock;           /* guards everything below               */
+    pthread_cond_t  Ready;          /* signalled when Queue is added to      */
+    int             Queue[MAX_CONNECTIONS];     /* connections with a        */
+    int             QueueHead;                  /* request for a worker,     */
+    int             QueueCount;                 /* oldest first              */
+    int             Back[MAX_CONNECTIONS];      /* served, for the poller    */
+    int             BackCount;                  /* to watch again            */
+    int             Open;           /* connections accepted and not closed   */
+    long            Connections;
+    long            Requests[3];    /* by status                             */
+    long            BytesIn;
+    long            BytesOut;
+};
+
+PRIVATE int    Listen( char *path );
+PRIVATE void   *Poll( void *arg );
+PRIVATE int    Accept( SERVER *server, struct pollfd *watch, time_t *since, int n );
+PRIVATE void   Close( SERVER *server, int fd );
+PRIVATE void   *Work( void *arg );
+PRIVATE int    Serve( SERVER *server, int fd, void **state );
+PRIVATE int    Reply( int fd, int status, DAEMONREQUEST *request );
+PRIVATE int    ReadAll( int fd, void *buffer, size_t length );
+PRIVATE int    WriteAll( int fd, const void *buffer, size_t length );
+PRIVATE int    ReadNumber( int fd, unsigned long *n );
+PRIVATE int    WriteNumber( int fd, unsigned long n );
+PRIVATE int    CoreCount( void );
+PRIVATE double Elapsed( struct timespec *start );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      RunDaemon: entry point for "comp -d".  The arguments are             */
+/*                                                                           */
+/*          -d [-j<threads>] <socket>                                        */
+/*                                                                           */
+/*      Listens on the Unix domain socket <socket>, replacing any socket     */
+/*      already there, with one worker per online core unless "-j" says      */
+/*      otherwise, and serves requests until SIGINT or SIGTERM.  Returns     */
+/*      EXIT_FAILURE if the server could not be started, otherwise           */
+/*      EXIT_SUCCESS once it has stopped.                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int RunDaemon( int argc, char *argv[], DAEMONCOMPILER compile )
+{
+    SERVER server;
+    WORKER *workers;
+    pthread_t poller;
+    struct timespec start;
+    struct sigaction ignore;
+    sigset_t stop;
+    int arg = 2, threads = 0, i, signo;
+    double seconds;
+
+    if ( arg < argc && 0 == strncmp( argv[arg], "-j", 2 ) )  {
+        if ( ( threads = atoi( argv[arg] + 2 ) ) < 1 )  threads = -1;
+        else if ( threads > MAX_THREADS )  threads = MAX_THREADS;
+        arg++;
+    }
+    if ( threads < 0 || argc - arg != 1 )  {
+        fprintf( stderr, "%s -d [-j<threads>] <socket>\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    if ( threads == 0 )  threads = CoreCount();
+
+    /* the workers inherit this mask, so only sigwait below sees a stop */
+    sigemptyset( &stop );
+    sigaddset( &stop, SIGINT );
+    sigaddset( &stop, SIGTERM );
+    pthread_sigmask( SIG_BLOCK, &stop, NULL );
+    memset( &ignore, 0, sizeof( ignore ) );
+    ignore.sa_handler = SIG_IGN;
+    sigaction( SIGPIPE, &ignore, NULL );
+
+    memset( &server, 0, sizeof( server ) );
+    server.Compile = compile;
+    if ( ( server.Socket = Listen( argv[arg] ) ) < 0 )  return EXIT_FAILURE;
+    if ( 0 != pipe( server.Wake ) )  {
+        perror( "pipe" );
+        return EXIT_FAILURE;
+    }
+    fcntl( server.Wake[0], F_SETFL, O_NONBLOCK );
+    fcntl( server.Wake[1], F_SETFL, O_NONBLOCK );
+    pthread_mutex_init( &server.Lock, NULL );
+    pthread_cond_init( &server.Ready, NULL );
+
+    if ( NULL == ( workers = calloc( threads, sizeof( WORKER ) ) ) )  {
+        fprintf( stderr, "Fatal Error: RunDaemon: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    for ( i = 0; i < threads; i++ )  {
+        workers[i].Server = &server;
+        if ( 0 != pthread_create( &workers[i].Thread, NULL, Work, &workers[i] ) )  {
+            fprintf( stderr, "Fatal Error: RunDaemon: cannot create thread\n" );
+            exit( EXIT_FAILURE );
+        }
+    }
+    if ( 0 != pthread_create( &poller, NULL, Poll, &server ) )  {
+        fprintf( stderr, "Fatal Error: RunDaemon: cannot create thread\n" );
+        exit( EXIT_FAILURE );
+    }
+    fprintf( stderr, "listening on \"%s\" with %d threads\n", argv[arg], threads );
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    while ( 0 != sigwait( &stop, &signo ) )
+        ;
+    seconds = Elapsed( &start );
+    unlink( argv[arg] );
+
+    /* the threads are not joined: a worker may be waiting on its client */
+    pthread_mutex_lock( &server.Lock );
+    printf( "%ld connections, %ld requests (%ld valid, %ld invalid, %ld failed) in %.3fs\n",
+            server.Connections,
+            server.Requests[DAEMON_VALID] + server.Requests[DAEMON_INVALID] +
+            server.Requests[DAEMON_FAILED],
+            server.Requests[DAEMON_VALID], server.Requests[DAEMON_INVALID],
+            server.Requests[DAEMON_FAILED], seconds );
+    printf( "%ld bytes in, %ld bytes out\n", server.BytesIn, server.BytesOut );
+    fflush( stdout );
+    return EXIT_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  A listening socket bound to "path", or -1 after reporting why not.       */
+
+PRIVATE int Listen( char *path )
+{
+    struct sockaddr_un address;
+    int fd;
+
+    memset( &address, 0, sizeof( address ) );
+    if ( strlen( path ) >= sizeof( address.sun_path ) )  {
+        fprintf( stderr, "socket name \"%s\" too long\n", path );
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy( address.sun_path, path );
+    if ( ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 )  {
+        perror( "socket" );
+        return -1;
+    }
+    unlink( path );
+    if ( 0 != bind( fd, (struct sockaddr *) &address, sizeof( address ) ) ||
+         0 != listen( fd, LISTEN_QUEUE ) )  {
+        fprintf( stderr, "cannot listen on \"%s\": %s\n", path, strerror( errno ) );
+        close( fd );
+        return -1;
+    }
+    fcntl( fd, F_SETFL, O_NONBLOCK );   /* the poller accepts till none are left */
+    return fd;
+}
+
+/*  The poller.  Entries 0 and 1 of "watch" are the listening socket and    */
+/*  the wake pipe, and the rest the connections waiting for a request,      */
+/*  each with the time it started waiting in "since".  A connection that     */
+/*  becomes readable (or hangs up) goes to the workers; one that a worker    */
+/*  hands back is watched again.                                             */
+
+PRIVATE void *Poll( void *arg )
+{
+    SERVER *server = arg;
+    struct pollfd watch[MAX_CONNECTIONS + 2];
+    time_t since[MAX_CONNECTIONS + 2], now;
+    char drain[64];
+    int n = 2, i, open, tail;
+
+    watch[0].fd = server->Socket;
+    watch[1].fd = server->Wake[0];
+    watch[1].events = POLLIN;
+    for ( ;; )  {
+        pthread_mutex_lock( &server->Lock );
+        open = server->Open;
+        pthread_mutex_unlock( &server->Lock );
+        watch[0].events = open < MAX_CONNECTIONS ? POLLIN : 0;
+        if ( poll( watch, (nfds_t) n, POLL_MS ) < 0 )  {
+            if ( errno == EINTR )  continue;
+            perror( "poll" );
+            break;
+        }
+        now = time( NULL );
+        for ( i = 2; i < n; )  {
+            if ( watch[i].revents != 0 || now - since[i] > IDLE_SECONDS )  {
+                if ( watch[i].revents != 0 )  {
+                    pthread_mutex_lock( &server->Lock );
+                    tail = ( server->QueueHead + server->QueueCount++ ) % MAX_CONNECTIONS;
+                    server->Queue[tail] = watch[i].fd;
+                    pthread_cond_signal( &server->Ready );
+                    pthread_mutex_unlock( &server->Lock );
+                }
+                else  Close( server, watch[i].fd );
+                watch[i] = watch[--n];
+                since[i] = since[n];
+            }
+            else  i++;
+        }
+        if ( watch[1].revents != 0 )  {
+            while ( read( server->Wake[0], drain, sizeof( drain ) ) > 0 )
+                ;
+            pthread_mutex_lock( &server->Lock );
+            for ( i = 0; i < server->BackCount; i++, n++ )  {
+                watch[n].fd = server->Back[i];
+                watch[n].events = POLLIN;
+                since[n] = now;
+            }
+            server->BackCount = 0;
+            pthread_mutex_unlock( &server->Lock );
+        }
+        if ( watch[0].revents != 0 )  n = Accept( server, watch, since, n );
+    }
+    return NULL;
+}
+
+/*  Accepts the connections waiting on the listening socket, while there     */
+/*  is room for them, adding them to the "n" entries of "watch"; returns     */
+/*  how many entries there are then.                                         */
+
+PRIVATE int Accept( SERVER *server, struct pollfd *watch, time_t *since, int n )
+{
+    struct timeval idle;
+    int fd;
+
+    idle.tv_sec = IDLE_SECONDS;
+    idle.tv_usec = 0;
+    for ( ;; )  {
+        pthread_mutex_lock( &server->Lock );
+        if ( server->Open == MAX_CONNECTIONS )  {
+            pthread_mutex_unlock( &server->Lock );
+            break;
+        }
+        pthread_mutex_unlock( &server->Lock );
+        if ( ( fd = accept( server->Socket, NULL, NULL ) ) < 0 )  {
+            if ( errno == EINTR || errno == ECONNABORTED )  continue;
+            if ( errno != EAGAIN && errno != EWOULDBLOCK )  perror( "accept" );
+            break;
+        }
+        /* a worker reads a request with the connection blocking, for at */
+        /* most IDLE_SECONDS at a time                                   */
+        fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) & ~O_NONBLOCK );
+        setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof( idle ) );
+        pthread_mutex_lock( &server->Lock );
+        server->Open++;
+        server->Connections++;
+        pthread_mutex_unlock( &server->Lock );
+        watch[n].fd = fd;
+        watch[n].events = POLLIN;
+        since[n++] = time( NULL );
+    }
+    return n;
+}
+
+PRIVATE void Close( SERVER *server, int fd )
+{
+    close( fd );
+    pthread_mutex_lock( &server->Lock );
+    server->Open--;
+    pthread_mutex_unlock( &server->Lock );
+}
+
+/*  A worker serves one request on each connection it is given, then hands   */
+/*  the connection back to the poller (waking it), or closes it.             */
+
+PRIVATE void *Work( void *arg )
+{
+    WORKER *self = arg;
+    SERVER *server = self->Server;
+    void *state = NULL;
+    int fd;
+
+    for ( ;; )  {
+        pthread_mutex_lock( &server->Lock );
+        while ( server->QueueCount == 0 )
+            pthread_cond_wait( &server->Ready, &server->Lock );
+        fd = server->Queue[server->QueueHead];
+        server->QueueHead = ( server->QueueHead + 1 ) % MAX_CONNECTIONS;
+        server->QueueCount--;
+        pthread_mutex_unlock( &server->Lock );
+        if ( Serve( server, fd, &state ) )  {
+            pthread_mutex_lock( &server->Lock );
+            server->Back[server->BackCount++] = fd;
+            pthread_mutex_unlock( &server->Lock );
+            /* if the pipe is full the poller has a wake-up pending anyway */
+            if ( write( server->Wake[1], "", 1 ) < 0 && errno != EAGAIN )
+                perror( "write" );
+        }
+        else  Close( server, fd );
+    }
+    return NULL;
+}
+
+/*  Reads, compiles and replies to one request.  Returns 0 once the          */
+/*  connection should be closed.                                             */
+
+PRIVATE int Serve( SERVER *server, int fd, void **state )
+{
+    DAEMONREQUEST request;
+    unsigned long length;
+    int status, ok;
+
+    if ( !ReadNumber( fd, &length ) )  return 0;
+    memset( &request, 0, sizeof( request ) );
+    if ( length > (unsigned long) DAEMON_MAX_SOURCE )  {
+        Reply( fd, DAEMON_FAILED, &request );
+        return 0;
+    }
+    if ( NULL == ( request.Source = malloc( length + 1 ) ) )  {
+        Reply( fd, DAEMON_FAILED, &request );
+        return 0;
+    }
+    if ( !ReadAll( fd, request.Source, length ) )  {
+        free( request.Source );
+        return 0;
+    }
+    request.SourceLength = length;
+    request.State = *state;
+    status = server->Compile( &request );
+    *state = request.State;
+    if ( status < DAEMON_VALID || status > DAEMON_FAILED )  status = DAEMON_FAILED;
+
+    ok = Reply( fd, status, &request );
+    pthread_mutex_lock( &server->Lock );
+    server->Requests[status]++;
+    server->BytesIn += (long) length;
+    server->BytesOut += (long) ( request.ListingLength + request.CodeLength );
+    pthread_mutex_unlock( &server->Lock );
+    free( request.Source );
+    free( request.Listing );
+    free( request.Code );
+    return ok;
+}
+
+PRIVATE int Reply( int fd, int status, DAEMONREQUEST *request )
+{
+    return WriteNumber( fd, (unsigned long) status ) &&
+           WriteNumber( fd, (unsigned long) request->ListingLength ) &&
+           WriteAll( fd, request->Listing, request->ListingLength ) &&
+           WriteNumber( fd, (unsigned long) request->CodeLength ) &&
+           WriteAll( fd, request->Code, request->CodeLength );
+}
+
+PRIVATE int ReadAll( int fd, void *buffer, size_t length )
+{
+    char *p = buffer;
+    ssize_t n;
+
+    while ( length > 0 )  {
+        if ( ( n = read( fd, p, length ) ) < 0 && errno == EINTR )  continue;
+        if ( n <= 0 )  return 0;
+        p += n;
+        length -= (size_t) n;
+    }
+    return 1;
+}
+
+PRIVATE int WriteAll( int fd, const void *buffer, size_t length )
+{
+    const char *p = buffer;
+    ssize_t n;
+
+    while ( length > 0 )  {
+        if ( ( n = write( fd, p, length ) ) < 0 && errno == EINTR )  continue;
+        if ( n <= 0 )  return 0;
+        p += n;
+        length -= (size_t) n;
+    }
+    return 1;
+}
+
+PRIVATE int ReadNumber( int fd, unsigned long *n )
+{
+    unsigned char b[4];
+
+    if ( !ReadAll( fd, b, 4 ) )  return 0;
+    *n = (unsigned long) b[0] << 24 | (unsigned long) b[1] << 16 |
+         (unsigned long) b[2] << 8 | (unsigned long) b[3];
+    return 1;
+}
+
+PRIVATE int WriteNumber( int fd, unsigned long n )
+{
+    unsigned char b[4];
+
+    b[0] = (unsigned char) ( n >> 24 );
+    b[1] = (unsigned char) ( n >> 16 );
+    b[2] = (unsigned char) ( n >> 8 );
+    b[3] = (unsigned char) n;
+    return WriteAll( fd, b, 4 );
+}
+
+PRIVATE int CoreCount( void )
+{
+    long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+    if ( n < 1 )  return 1;
+    return n > MAX_THREADS ? MAX_THREADS : (int) n;
+}
+
+PRIVATE double Elapsed( struct timespec *start )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (double) ( now.tv_sec - start->tv_sec ) +
+           (double) ( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
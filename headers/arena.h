@@ -0,0 +1,35 @@
+#ifndef  ARENAHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      arena.h                                                              */
+/*                                                                           */
+/*      Header file for "arena.c", containing type definitions and function  */
+/*      prototypes for the arena (bump) allocator.                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  ARENAHEADER
+
+#include <stddef.h>
+#include "global.h"
+
+typedef struct  {                   /* see "GetArenaStats"                   */
+    long Allocations;           /* calls of ArenaAlloc                       */
+    long Bytes;                 /* bytes they asked for (after rounding)     */
+    long InUse;                 /* bytes allocated and not released now      */
+    long Peak;                  /* most bytes ever in use at once            */
+    long Reserved;              /* bytes in blocks got from malloc           */
+    int  Blocks;                /* blocks got from malloc                    */
+}
+    ARENASTATS;
+
+typedef struct arena  ARENA;
+
+PUBLIC ARENA  *MakeArena( size_t blocksize );
+PUBLIC void   FreeArena( ARENA *arena );
+PUBLIC void   *ArenaAlloc( ARENA *arena, size_t size );
+PUBLIC void   *ArenaMark( ARENA *arena );
+PUBLIC void   ArenaRelease( ARENA *arena, void *mark );
+PUBLIC void   GetArenaStats( ARENA *arena, ARENASTATS *stats );
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef  BATCHHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      batch.h                                                              */
+/*                                                                           */
+/*      Header file for "batch.c", the batch compilation driver.  A batch    */
+/*      is a manifest (a file listing one source file per line) or a         */
+/*      directory of ".prog" files.  Every unit is compiled, on a pool of    */
+/*      worker threads, into a ".lst" listing and a ".asm" code file.        */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  BATCHHEADER
+
+#include "global.h"
+
+#define  BATCH_VALID        0       /* compiled, no errors                   */
+#define  BATCH_INVALID      1       /* compiled, errors in the listing       */
+#define  BATCH_FAILED       2       /* files could not be opened             */
+
+typedef struct  {
+    char *InputName;                /* source file                           */
+    char *ListName;                 /* listing, with any error messages      */
+    char *CodeName;                 /* generated code                        */
+    long Size;                      /* bytes in the source file              */
+    int  Status;                    /* one of BATCH_VALID ... BATCH_FAILED   */
+}
+    BATCHUNIT;
+
+/*  Compiles one unit, returning its status.  Called concurrently from the   */
+/*  worker threads, so it must keep all of its state in a CONTEXT.           */
+
+typedef int (*BATCHCOMPILER)( BATCHUNIT *unit );
+
+PUBLIC int CompileBatch( int argc, char *argv[], BATCHCOMPILER compile );
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef  CACHEHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      cache.h                                                              */
+/*                                                                           */
+/*      Header file for "cache.c", the on-disk compile cache.  An entry      */
+/*      holds the listing, the code and the validity of one compilation,     */
+/*      keyed on a hash of the source bytes and of a string describing the   */
+/*      compiler and its options, so a source that has been compiled before  */
+/*      is not compiled again.  The least recently used entries are removed  */
+/*      once the cache grows past its size limit.                            */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  CACHEHEADER
+
+#include <stdio.h>
+#include "global.h"
+
+#define  CACHE_DEFAULT_LIMIT   64L      /* megabytes                         */
+
+typedef struct  {                   /* see "GetCacheStats"                   */
+    long   Hits;                    /* over the life of the cache directory  */
+    long   Misses;
+    long   Evictions;               /* entries removed to keep under limit   */
+    double Saved;                   /* compile seconds the hits replaced     */
+    long   Bytes;                   /* in the entries now in the cache       */
+    int    Entries;
+}
+    CACHESTATS;
+
+typedef struct compilecache  COMPILECACHE;
+
+PUBLIC COMPILECACHE *OpenCache( char *dirname, long limit );
+PUBLIC void   CloseCache( COMPILECACHE *cache );
+PUBLIC int    CacheLookup( COMPILECACHE *cache, char *inputname, char *options,
+                           char *listname, char *codename, int *valid );
+PUBLIC void   CacheStore( COMPILECACHE *cache, char *listname, char *codename,
+                          int valid, double seconds );
+PUBLIC void   GetCacheStats( COMPILECACHE *cache, CACHESTATS *stats );
+PUBLIC void   ReportCache( COMPILECACHE *cache, FILE *fp );
+
+#endif
@@ -12,6 +12,7 @@
 
 #include <stdio.h>
 #include "global.h"
+#include "sink.h"
 
 #define  I_ADD           0      /* 0-"address" instructions                  */
 #define  I_SUB           1      /* Sub                                       */
@@ -46,12 +47,34 @@
 #define  I_STOREFP      29      /* Store FP+<offset>                         */
 #define  I_STORESP      30      /* Store [SP]+<offset>                       */
 
-PUBLIC void   InitCodeGenerator( FILE *codefile );
-PUBLIC void   WriteCodeFile( void );
-PUBLIC void   KillCodeGeneration( void );
-PUBLIC void   Emit( int opcode, int offset );
-PUBLIC int    CurrentCodeAddress( void );
-PUBLIC void   BackPatch( int codeaddr, int value );
+typedef struct  {                   /* see "GetCodeStats"                    */
+    long Emitted;               /* calls of Emit                             */
+    long BackPatches;           /* calls of BackPatch                        */
+    long Written;               /* instructions in the code file             */
+    long Bytes;                 /* bytes written to the code sink            */
+    long MemoryPeak;            /* see "CodeMemoryHighWater"                 */
+}
+    CODESTATS;
 
-#define _Emit(opcode)  Emit((opcode),0)
+typedef struct codetable  CODETABLE;
+
+PUBLIC CODETABLE *MakeCodeTable( void );
+PUBLIC void   FreeCodeTable( CODETABLE *ct );
+PUBLIC void   InitCodeGenerator( CONTEXT *ctx, SINK *code );
+PUBLIC void   StreamCode( CONTEXT *ctx );
+PUBLIC void   FlushCode( CONTEXT *ctx );
+PUBLIC void   WriteCodeFile( CONTEXT *ctx );
+PUBLIC void   KillCodeGeneration( CONTEXT *ctx );
+PUBLIC void   Emit( CONTEXT *ctx, int opcode, int offset );
+PUBLIC int    CurrentCodeAddress( CONTEXT *ctx );
+PUBLIC void   BackPatch( CONTEXT *ctx, int codeaddr, int value );
+PUBLIC long   CodeMemoryHighWater( CONTEXT *ctx );
+PUBLIC void   GetCodeStats( CONTEXT *ctx, CODESTATS *stats );
+PUBLIC int    CodeGenerationKilled( CONTEXT *ctx );
+PUBLIC int    GetInstruction( CONTEXT *ctx, int codeaddr, int *offset );
+PUBLIC void   SetInstruction( CONTEXT *ctx, int codeaddr, int opcode, int offset );
+PUBLIC void   TruncateCode( CONTEXT *ctx, int codeaddr );
+PUBLIC int    ConstantArithmetic( int opcode, int a, int b, int *result );
+
+#define _Emit(ctx,opcode)  Emit((ctx),(opcode),0)
 #endif
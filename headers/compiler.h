@@ -0,0 +1,25 @@
+#ifndef  COMPILERHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      compiler.h                                                           */
+/*                                                                           */
+/*      Header file for the in-memory entry point of "Compiler.c", for       */
+/*      programs that embed the compiler.  The source is taken from a        */
+/*      buffer and the listing and code go to SINKs (see "sink.h"), so a     */
+/*      compilation does no file I/O.  To link Compiler.c into another       */
+/*      program, compile it with its "main" renamed, e.g.,                   */
+/*      "-Dmain=CompilerMain" (see the "membench" target in the Makefile).   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  COMPILERHEADER
+
+#include <stddef.h>
+#include "global.h"
+#include "sink.h"
+
+PUBLIC CONTEXT *MakeCompilerContext( void );
+PUBLIC int    CompileBuffer( CONTEXT *ctx, const char *source, size_t length,
+                             SINK *listing, SINK *code );
+
+#endif
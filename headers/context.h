@@ -0,0 +1,65 @@
+#ifndef  CONTEXTHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      context.h                                                            */
+/*                                                                           */
+/*      Header file for "context.c".  A CONTEXT holds all the state of one   */
+/*      compilation: the private state of each library module (reached       */
+/*      only through that module's routines) and the parser's own state.     */
+/*      No module keeps any state of its own, so separate compilations may   */
+/*      run at the same time, e.g., one per thread, as long as each CONTEXT  */
+/*      is only used by one thread at a time.                                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  CONTEXTHEADER
+
+#include <stdio.h>
+#include "global.h"
+#include "sets.h"
+#include "scanner.h"
+#include "line.h"
+#include "strtab.h"
+#include "symbol.h"
+#include "code.h"
+#include "tokarray.h"
+
+struct compilercontext  {
+    CHARPROCESSOR *line;        /* source and listing ("line.c")             */
+    STRINGTABLE   *strtab;      /* identifier strings ("strtab.c")           */
+    SYMBOLTABLE   *symtab;      /* symbol table ("symbol.c")                 */
+    CODETABLE     *code;        /* code table ("code.c")                     */
+    TOKENARRAY    *lookahead;   /* tokens ahead of the parser ("tokarray.c") */
+
+    FILE  *InputFile;           /* Parser state: the files being compiled,   */
+    FILE  *ListFile;            /* the error recovery sets and the current   */
+    FILE  *CodeFile;            /* scope and address.                        */
+    SET   StatementFS_aug;
+    SET   StatementFBS;
+    SET   DeclarationFS_aug;
+    SET   ProcDeclarationFS_aug;
+    SET   ProcDeclarationFBS;
+    SET   StatementSync;        /* the unions Synchronise skips to, formed   */
+    SET   DeclarationSync;      /* once by SetupSets                         */
+    SET   ProcDeclarationSync;
+    int   ErrorFlag;
+    int   recovering;
+    int   scope;
+    int   varaddress;
+    int   display;              /* address of the display (see Compiler.c)   */
+    long  tokens;               /* tokens read, Synchronise recoveries and   */
+    long  recoveries;           /* tokens skipped to recover, for "--stats"  */
+    long  skipped;              /* (see "stats.h")                           */
+    volatile int phase;         /* what the compiler is doing, likewise      */
+    int   speculative;          /* parsing one part of a split source, so no */
+                                /* messages (see "split.h" and Compiler.c)   */
+    int   quiet;                /* compiling for CompileBuffer, so messages  */
+                                /* go only to the caller's listing sink      */
+    SET   *skipto;              /* what GetTokenIn is skipping to, or NULL   */
+};
+
+PUBLIC CONTEXT *MakeContext( void );
+PUBLIC void    ResetContext( CONTEXT *ctx );
+PUBLIC void    FreeContext( CONTEXT *ctx );
+
+#endif
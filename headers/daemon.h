@@ -0,0 +1,55 @@
+#ifndef  DAEMONHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      daemon.h                                                             */
+/*                                                                           */
+/*      Header file for "daemon.c", the compile server.  "comp -d" listens   */
+/*      on a Unix domain socket and compiles the sources its clients send,   */
+/*      replying with the listing and the code.  A client may send any       */
+/*      number of requests over one connection, one after another.           */
+/*                                                                           */
+/*      All numbers on the wire are 4-byte unsigned integers, most           */
+/*      significant byte first.  A request is                                */
+/*                                                                           */
+/*          <length> <length bytes of source>                                */
+/*                                                                           */
+/*      and the reply to it is                                               */
+/*                                                                           */
+/*          <status> <length> <listing> <length> <code>                      */
+/*                                                                           */
+/*      where <status> is one of the DAEMON_ codes.  A request longer than   */
+/*      DAEMON_MAX_SOURCE gets a DAEMON_FAILED reply with an empty listing   */
+/*      and code, and the connection is then closed.                         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  DAEMONHEADER
+
+#include <stddef.h>
+#include "global.h"
+
+#define  DAEMON_VALID       0       /* compiled, no errors                   */
+#define  DAEMON_INVALID     1       /* compiled, errors in the listing       */
+#define  DAEMON_FAILED      2       /* not compiled                          */
+
+#define  DAEMON_MAX_SOURCE  ( 64L * 1024 * 1024 )   /* longest request       */
+
+typedef struct  {
+    char   *Source;                 /* the source sent by the client         */
+    size_t SourceLength;
+    char   *Listing;                /* set by the compiler, in memory from   */
+    size_t ListingLength;           /* malloc, which the daemon frees after  */
+    char   *Code;                   /* replying (either may be NULL)         */
+    size_t CodeLength;
+    void   *State;                  /* the worker's own, kept from request   */
+}                                   /* to request; NULL at first             */
+    DAEMONREQUEST;
+
+/*  Compiles one request, returning its status.  Called concurrently from    */
+/*  the worker threads, so it must keep all of its state in "State".         */
+
+typedef int (*DAEMONCOMPILER)( DAEMONREQUEST *request );
+
+PUBLIC int RunDaemon( int argc, char *argv[], DAEMONCOMPILER compile );
+
+#endif
@@ -11,4 +11,6 @@
 
 #define  PUBLIC
 #define  PRIVATE  static
+
+typedef struct compilercontext  CONTEXT;    /* see "context.h"               */
 #endif
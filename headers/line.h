@@ -11,7 +11,9 @@
 #define  LINEHEADER
 
 #include <stdio.h>
+#include <stddef.h>
 #include "global.h"
+#include "sink.h"
 
 #define  M_LINE_WIDTH          256              /* maximum line width        */
                                                 /* N.B, changed from 74 on   */
@@ -19,12 +21,39 @@
 #define  M_ERRS_LINE             5              /* max displayed errors per  */
                                                 /* line                      */
 
-PUBLIC void   InitCharProcessor( FILE *inputfile, FILE *listfile );
-PUBLIC int    ReadChar( void );
-PUBLIC void   UnReadChar( void );
-PUBLIC int    CurrentCharPos( void );
-PUBLIC void   Error( char *ErrorString, int PositionInLine );
-PUBLIC void   SetTabWidth( int NewTabWidth );
-PUBLIC int    GetTabWidth( void );
+typedef struct  {                   /* see "GetLineStats"                    */
+    long Lines;                 /* source lines read so far                  */
+    long BytesRead;             /* source bytes read so far                  */
+    long ListingBytes;          /* bytes written to the listing sink         */
+    long Errors;                /* messages passed to Error                  */
+}
+    LINESTATS;
+
+typedef struct  {                   /* see "MarkListing"                     */
+    long Lines;                 /* lines the scanner is done with            */
+    long Current;               /* number of the line it is on, or -1        */
+}
+    LISTMARK;
+
+typedef struct charprocessor  CHARPROCESSOR;
+
+PUBLIC CHARPROCESSOR *MakeCharProcessor( void );
+PUBLIC void   FreeCharProcessor( CHARPROCESSOR *cp );
+PUBLIC void   InitCharProcessor( CONTEXT *ctx, FILE *inputfile, SINK *listing );
+PUBLIC void   InitCharBuffer( CONTEXT *ctx, const char *source, size_t length, SINK *listing );
+PUBLIC int    ReadChar( CONTEXT *ctx );
+PUBLIC void   UnReadChar( CONTEXT *ctx );
+PUBLIC int    CurrentCharPos( CONTEXT *ctx );
+PUBLIC void   Error( CONTEXT *ctx, char *ErrorString, int PositionInLine );
+PUBLIC void   SetTabWidth( CONTEXT *ctx, int NewTabWidth );
+PUBLIC int    GetTabWidth( CONTEXT *ctx );
+PUBLIC void   GetLineStats( CONTEXT *ctx, LINESTATS *stats );
+PUBLIC const char *GetSource( CONTEXT *ctx, size_t *length );
+PUBLIC void   SetLineNumber( CONTEXT *ctx, int line );
+PUBLIC void   SkipSource( CONTEXT *ctx, size_t length, const char *listing, size_t listlength );
+PUBLIC int    LongLines( CONTEXT *ctx );
+PUBLIC void   DeferListing( CONTEXT *ctx );
+PUBLIC void   MarkListing( CONTEXT *ctx, LISTMARK *mark );
+PUBLIC void   ListTo( CONTEXT *ctx, LISTMARK *mark );
 
 #endif
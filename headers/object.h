@@ -0,0 +1,67 @@
+#ifndef  OBJECTHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      object.h                                                             */
+/*                                                                           */
+/*      Header file for "object.c", the binary object file format.  An       */
+/*      object file is an OBJHEADER followed by CodeCount OBJINSTRUCTIONs,   */
+/*      SymbolCount OBJSYMBOLs and StringSize bytes of NUL-terminated        */
+/*      symbol names.  Every field is an int in the byte order of the        */
+/*      machine that wrote it, so a file can be used in place once mapped    */
+/*      into memory; "LoadObjectFile" rejects files from a machine with a    */
+/*      different byte order or int size.                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  OBJECTHEADER
+
+#include <stdio.h>
+#include "global.h"
+
+#define  OBJ_MAGIC          "CPLO"
+#define  OBJ_VERSION        1
+#define  OBJ_BYTE_ORDER     0x01020304  /* reads differently if swapped      */
+
+#define  OBJ_NO_CODE        1           /* Flags: errors, no code generated  */
+
+typedef struct  {
+    char Magic[4];                      /* OBJ_MAGIC, not NUL-terminated     */
+    int  ByteOrder;                     /* OBJ_BYTE_ORDER                    */
+    int  WordSize;                      /* sizeof( int ) of the writer       */
+    int  Version;                       /* OBJ_VERSION                       */
+    int  Flags;
+    int  CodeCount;                     /* instructions                      */
+    int  SymbolCount;                   /* symbols                           */
+    int  StringSize;                    /* bytes of symbol names             */
+}
+    OBJHEADER;
+
+typedef struct  {
+    int  Opcode;                        /* one of the I_ codes in "code.h"   */
+    int  Operand;
+}
+    OBJINSTRUCTION;
+
+typedef struct  {
+    int  Name;                          /* offset of the name in Strings     */
+    int  Type;                          /* one of the STYPEs in "symbol.h"   */
+    int  Scope;
+    int  Address;
+}
+    OBJSYMBOL;
+
+typedef struct  {                       /* an object file loaded by mmap     */
+    OBJHEADER      *Header;
+    OBJINSTRUCTION *Code;
+    OBJSYMBOL      *Symbols;
+    char           *Strings;
+    void           *Map;
+    long           MapSize;
+}
+    OBJECTFILE;
+
+PUBLIC int        WriteObjectFile( CONTEXT *ctx, FILE *objfile );
+PUBLIC OBJECTFILE *LoadObjectFile( char *filename );
+PUBLIC void       FreeObjectFile( OBJECTFILE *obj );
+
+#endif
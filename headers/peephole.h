@@ -0,0 +1,17 @@
+#ifndef  PEEPHOLEHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      peephole.h                                                           */
+/*                                                                           */
+/*      Header file for "peephole.c", the peephole optimiser which is run    */
+/*      over the code table between parsing and "WriteCodeFile".             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  PEEPHOLEHEADER
+
+#include "global.h"
+
+PUBLIC int Peephole( CONTEXT *ctx );
+
+#endif
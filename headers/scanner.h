@@ -54,12 +54,15 @@ typedef struct  {       /*  Definiton of a TOKEN, the structure which is     */
     int  value;         /*  identification code for the TOKEN, "value" is    */
     int  pos;           /*  its value if it is an INTCONST, "pos" is the     */
     char *s;            /*  position in the input line where the token       */
-}                       /*  begins, "s" is a pointer to the token string.    */
-    TOKEN;              /*  "s" is always NULL unless the token code is      */
-                        /*  IDENTIFIER.                                      */
+    int  atom;          /*  begins, "s" is a pointer to the token string     */
+}                       /*  and "atom" its interned atom (see strtab.h).     */
+    TOKEN;              /*  "s" is always NULL and "atom" NO_ATOM unless the */
+                        /*  token code is IDENTIFIER.                        */
 
-PUBLIC TOKEN  GetToken( void );
-PUBLIC void   SyntaxError( int Expected, TOKEN CurrentToken );
-PUBLIC void   SyntaxError2( SET Expected, TOKEN CurrentToken );
+PUBLIC TOKEN  GetToken( CONTEXT *ctx );
+PUBLIC long   GetTokenIn( CONTEXT *ctx, SET *set, TOKEN *token );
+PUBLIC int    LookupKeyword( char *s, int length );
+PUBLIC void   SyntaxError( CONTEXT *ctx, int Expected, TOKEN CurrentToken );
+PUBLIC void   SyntaxError2( CONTEXT *ctx, SET Expected, TOKEN CurrentToken );
 
 #endif
@@ -3,9 +3,15 @@
 /*                                                                           */
 /*      sets.h                                                               */
 /*                                                                           */
-/*      Header file for "sets.c", containing constant declarations, type     */
-/*      definitions and function prototypes for the set manipulation         */
-/*      routines.                                                            */
+/*      Sets of small integers (token codes) for the CPL compiler.  This     */
+/*      file is all there is: a SET is an array of "unsigned long" words,    */
+/*      a single word wherever "unsigned long" has 64 bits, and the          */
+/*      operations are macros, so testing membership or forming a union      */
+/*      costs a mask or two in line rather than a (varargs) call.            */
+/*                                                                           */
+/*      Arguments are pointers to SETs and element numbers in the range      */
+/*      0 .. SET_SIZE-1, which are not checked.  Element arguments may be    */
+/*      evaluated more than once.                                            */
 /*                                                                           */
 /*---------------------------------------------------------------------------*/
 
@@ -16,26 +22,43 @@
 
 #define  SET_SIZE               64
 
-#if ( INT_MAX == 32767 )
-#define  BITS_PER_WORD          16      /* 16 bit word machine, ibm pc       */
+#if ( ULONG_MAX > 0xffffffffUL )
+#define  BITS_PER_WORD          64      /* LP64: the set fits in one word    */
 #else
-#define  BITS_PER_WORD          32      /* assume 32 bit word if not 16      */
+#define  BITS_PER_WORD          32      /* "unsigned long" has at least 32   */
 #endif
 
 #define  WORDS_PER_SET          (SET_SIZE/BITS_PER_WORD)
 
 typedef  struct  {
-    unsigned  word[WORDS_PER_SET];
+    unsigned long  word[WORDS_PER_SET];
 }
     SET;
 
-PUBLIC SET   *MakeSet( void );
-PUBLIC void  ClearSet( SET *setptr );
-PUBLIC void  AddElements( SET *setptr, int ElementCount, ... );
-PUBLIC void  InitSet( SET *setptr, int ElementCount, ... );
-PUBLIC void  AddElement( SET *setptr, int Element );
-PUBLIC void  RemoveElement( SET *setptr, int Element );
-PUBLIC int   InSet( SET *setptr, int Element );
-PUBLIC SET   Union( int SetCount, ... );
-PUBLIC SET   Intersection( int SetCount, ... );
+#define  SET_BIT(e)             ( 1UL << ( (e) % BITS_PER_WORD ) )
+
+#if ( WORDS_PER_SET == 1 )
+
+#define  ClearSet(s)            ( (s)->word[0] = 0UL )
+#define  AddElement(s,e)        ( (s)->word[0] |= SET_BIT(e) )
+#define  RemoveElement(s,e)     ( (s)->word[0] &= ~SET_BIT(e) )
+#define  InSet(s,e)             ( ( (s)->word[0] & SET_BIT(e) ) != 0UL )
+#define  SetUnion(d,a,b)        ( (d)->word[0] = (a)->word[0] | (b)->word[0] )
+#define  SetIntersection(d,a,b) ( (d)->word[0] = (a)->word[0] & (b)->word[0] )
+
+#else
+
+#define  SET_WORD(s,e)          ( (s)->word[(e) / BITS_PER_WORD] )
+
+#define  ClearSet(s)            ( (s)->word[0] = (s)->word[1] = 0UL )
+#define  AddElement(s,e)        ( SET_WORD(s,e) |= SET_BIT(e) )
+#define  RemoveElement(s,e)     ( SET_WORD(s,e) &= ~SET_BIT(e) )
+#define  InSet(s,e)             ( ( SET_WORD(s,e) & SET_BIT(e) ) != 0UL )
+#define  SetUnion(d,a,b)        ( (d)->word[0] = (a)->word[0] | (b)->word[0], \
+                                  (d)->word[1] = (a)->word[1] | (b)->word[1] )
+#define  SetIntersection(d,a,b) ( (d)->word[0] = (a)->word[0] & (b)->word[0], \
+                                  (d)->word[1] = (a)->word[1] & (b)->word[1] )
+
+#endif
+
 #endif
@@ -0,0 +1,50 @@
+#ifndef  SINKHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      sink.h                                                               */
+/*                                                                           */
+/*      Header file for "sink.c", containing type definitions and function   */
+/*      prototypes for output sinks.  The listing and the code are written   */
+/*      to a SINK, which passes them on to a FILE, collects them in a        */
+/*      growable buffer or hands them to a routine of the caller's.          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  SINKHEADER
+
+#include <stdio.h>
+#include <stddef.h>
+#include "global.h"
+
+#define  SINK_BLOCK_SIZE      4096      /* a writer sink is called with at   */
+                                        /* most this many bytes at a time    */
+
+/*  A SINKWRITER is given the next "length" bytes of output and returns      */
+/*  how many of them it took; anything less marks the sink as failed.        */
+
+typedef size_t (*SINKWRITER)( void *arg, const char *data, size_t length );
+
+typedef struct  {
+    FILE       *File;               /* file sink: the FILE written to        */
+    SINKWRITER Writer;              /* writer sink: the routine and its      */
+    void       *Arg;                /* first argument                        */
+    char       *Buffer;             /* the output so far (buffer sink), or   */
+    size_t     Length;              /* not yet passed on (writer sink)       */
+    size_t     Capacity;
+    long       Written;             /* bytes written to the sink in all      */
+    int        Failed;              /* a write has been lost                 */
+}
+    SINK;
+
+PUBLIC void   InitFileSink( SINK *sink, FILE *file );
+PUBLIC void   InitBufferSink( SINK *sink );
+PUBLIC void   InitWriterSink( SINK *sink, SINKWRITER writer, void *arg );
+PUBLIC void   SinkWrite( SINK *sink, const char *data, size_t length );
+PUBLIC void   SinkPutc( SINK *sink, int ch );
+PUBLIC void   SinkPrintf( SINK *sink, const char *format, ... );
+PUBLIC int    FlushSink( SINK *sink );
+PUBLIC int    RewindSink( SINK *sink );
+PUBLIC char   *TakeSinkBuffer( SINK *sink, size_t *length );
+PUBLIC void   FreeSink( SINK *sink );
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef  SPLITHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      split.h                                                              */
+/*                                                                           */
+/*      Header file for "split.c", which cuts a source into parts that can   */
+/*      be parsed at the same time (see "comp -j").  A pre-scan finds the    */
+/*      outer procedures, those declared at scope 0, and the program's       */
+/*      block.  Part 0 is the program heading, the global declarations and   */
+/*      the first outer procedure; then come runs of whole outer             */
+/*      procedures, and last the block.  Every part starts at the start of   */
+/*      a line, so the listings of the parts put end to end are the listing  */
+/*      of the whole source.                                                 */
+/*                                                                           */
+/*      The pre-scan only reads the tokens, so what it says about a part     */
+/*      (how many outer procedures it declares, how many variable addresses  */
+/*      they take) is a prediction, which the caller must check against the  */
+/*      parse before it trusts the parts.                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  SPLITHEADER
+
+#include <stddef.h>
+#include "global.h"
+
+#define  SPLIT_MIN_SOURCE   16384   /* bytes; smaller sources are not split  */
+#define  SPLIT_PARTS_THREAD     4   /* parts of outer procedures per thread  */
+
+typedef struct  {
+    const char *Start;              /* first byte, at the start of a line    */
+    size_t     Length;
+    int        FirstLine;           /* number of its first line              */
+    int        FirstProcedure;      /* index of its first outer procedure    */
+    int        Procedures;          /* outer procedures declared in it       */
+    int        Variables;           /* addresses their declarations take     */
+    void       *State;              /* the caller's, e.g. its parse          */
+}
+    SOURCEPART;
+
+typedef struct sourcesplit  SOURCESPLIT;
+
+struct sourcesplit  {
+    SOURCEPART *Parts;              /* Parts[Count - 1] is the block         */
+    int        Count;
+    char       **Names;             /* of the outer procedures, in order     */
+    int        Procedures;
+    char       *NameStore;
+    void       *State;              /* the caller's, shared by all parts     */
+};
+
+/*  Parses "split->Parts[part]".  Called concurrently from the worker        */
+/*  threads of ParseParts, so it must keep all its state in the part.        */
+
+typedef void (*PARTPARSER)( SOURCESPLIT *split, int part );
+
+PUBLIC int    SplitSource( const char *source, size_t length, int threads, SOURCESPLIT *split );
+PUBLIC void   ParseParts( SOURCESPLIT *split, int first, int threads, PARTPARSER parse );
+PUBLIC int    ThreadCount( int threads );
+PUBLIC void   FreeSplit( SOURCESPLIT *split );
+
+#endif
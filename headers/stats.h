@@ -0,0 +1,75 @@
+#ifndef  STATSHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      stats.h                                                              */
+/*                                                                           */
+/*      Header file for "stats.c", the phase timings and counters reported   */
+/*      by "comp --stats".  The compiler records what it is doing in the     */
+/*      "phase" field of its CONTEXT, a single store with no clock read, so  */
+/*      the hot paths run at full speed.  The driver sets it around the      */
+/*      parse, the parser's NextToken around each token, and the entry       */
+/*      points of the symbol table and the code file around their own work   */
+/*      (see "EnterPhase"), so the productions of the parser need not.  While*/
+/*      a compilation is measured, profiling timers sample that field every  */
+/*      SAMPLE_INTERVAL of CPU time and of wall time, and the whole          */
+/*      compilation's CPU and wall times, which are read exactly, are shared */
+/*      out between the phases in proportion to their samples.  The          */
+/*      counters come from the modules.                                      */
+/*                                                                           */
+/*      The timers and their signal handlers belong to the process, so only  */
+/*      one compilation at a time may be measured; this is the one piece of  */
+/*      state that is not kept in a CONTEXT.                                 */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  STATSHEADER
+
+#include <stdio.h>
+#include "global.h"
+#include "line.h"
+#include "strtab.h"
+#include "symbol.h"
+#include "code.h"
+
+#define  PHASE_OTHER        0   /* loading the source, the optimiser, ...    */
+#define  PHASE_SCAN         1   /* GetToken, including the listing it writes */
+#define  PHASE_PARSE        2   /* the parser and code generation            */
+#define  PHASE_SYMBOL       3   /* Probe, EnterSymbol and RemoveSymbols      */
+#define  PHASE_WRITE        4   /* FlushCode and WriteCodeFile               */
+#define  PHASE_RECOVER      5   /* skipping tokens after a syntax error      */
+#define  PHASES             6
+
+/*  EnterPhase puts the CONTEXT in phase "p", keeping the phase it was in    */
+/*  in "was", and LeavePhase puts that back, so a module can mark its own    */
+/*  work whichever phase it is called from.                                  */
+
+#define  EnterPhase( ctx, was, p )  ( ( was ) = ( ctx )->phase, ( ctx )->phase = ( p ) )
+#define  LeavePhase( ctx, was )     ( ( ctx )->phase = ( was ) )
+
+#define  SAMPLE_INTERVAL  1000  /* microseconds between samples              */
+
+typedef struct  {                   /* see "StartStats" and "StopStats"      */
+    double      Wall;               /* seconds, the whole compilation        */
+    double      Cpu;
+    double      PhaseWall[PHASES];  /* shares of them, by the samples        */
+    double      PhaseCpu[PHASES];
+    long        WallSamples[PHASES];
+    long        CpuSamples[PHASES];
+    long        PeakRSS;            /* kilobytes, of the whole process       */
+    int         Valid;              /* the program had no errors             */
+    long        Tokens;             /* read by the parser                    */
+    long        Recoveries;         /* times Synchronise skipped tokens      */
+    long        Skipped;            /* tokens skipped, there and by Accept   */
+    LINESTATS   Source;
+    ATOMSTATS   Atoms;
+    SYMBOLSTATS Symbols;
+    CODESTATS   Code;
+}
+    COMPILESTATS;
+
+PUBLIC void   StartStats( CONTEXT *ctx, COMPILESTATS *stats );
+PUBLIC void   StopStats( CONTEXT *ctx, COMPILESTATS *stats );
+PUBLIC void   ReportStats( COMPILESTATS *stats, char *name, FILE *fp );
+PUBLIC void   WriteStatsJSON( COMPILESTATS *stats, char *name, FILE *fp );
+
+#endif
@@ -12,9 +12,35 @@
 #define  STRINGTABLEHEADER
 
 #include "global.h"
+#include "arena.h"
 
-PUBLIC void   NewString( void );
-PUBLIC void   AddChar( int ch );
-PUBLIC char   *GetString( void );
-PUBLIC void   PreserveString( void );
+#define  NO_ATOM             (-1)      /* atom of a token that has no name  */
+#define  SIGNIFICANT_LENGTH    80       /* characters that tell names apart  */
+
+typedef struct  {                   /* see "GetAtomStats"                    */
+    long Lookups;               /* calls of InternString                     */
+    long Steps;                 /* slots visited by them                     */
+    long Compares;              /* name compares (atoms with equal hash)     */
+    long MaxSteps;              /* most slots visited by one lookup          */
+    int  Resizes;               /* times the slots have been doubled         */
+    int  Atoms;                 /* distinct names interned                   */
+    int  Slots;                 /* slots now                                 */
+    ARENASTATS Memory;          /* the arena the strings are kept in         */
+}
+    ATOMSTATS;
+
+typedef struct stringtable  STRINGTABLE;
+
+PUBLIC STRINGTABLE *MakeStringTable( void );
+PUBLIC void   FreeStringTable( STRINGTABLE *st );
+PUBLIC void   ResetStringTable( STRINGTABLE *st );
+PUBLIC void   NewString( CONTEXT *ctx );
+PUBLIC void   AddChar( CONTEXT *ctx, int ch );
+PUBLIC char   *GetString( CONTEXT *ctx );
+PUBLIC void   PreserveString( CONTEXT *ctx );
+PUBLIC int    InternString( CONTEXT *ctx );
+PUBLIC int    InternName( CONTEXT *ctx, char *s );
+PUBLIC char   *AtomName( CONTEXT *ctx, int atom );
+PUBLIC int    AtomCount( CONTEXT *ctx );
+PUBLIC void   GetAtomStats( CONTEXT *ctx, ATOMSTATS *stats );
 #endif
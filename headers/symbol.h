@@ -12,10 +12,7 @@
 #define  SYMBOLHEADER
 
 #include "global.h"
-
-#define  HASHSIZE       997     /* Should be a prime for efficient hashing.  */
-#define  MAXHASHLENGTH  100     /* Maximum number of characters taken into   */
-                                /* account in a string when hashing.         */
+#include "arena.h"
 
 #define  STYPE_PROGRAM    1     /* SYMBOL type for the program name.         */
 #define  STYPE_VARIABLE   2     /* SYMBOL type for global variables.         */
@@ -34,13 +31,36 @@ typedef struct symboltype  {
     int  ptypes;                /* is the number of parameters of the symbol */
                                 /* and ptypes contains parameter types       */
     int  address;               /* address or offset of symbol               */
-    struct symboltype *next;    /* pointer to next symbol in chain           */
+    int  atom;                  /* the name's atom (see strtab.h)            */
+    struct symboltype *next;    /* next symbol with the same name            */
+    struct symboltype *older;   /* symbol entered before this one            */
 }
     SYMBOL;
 
-PUBLIC SYMBOL *Probe( char *String, int *hashindex );
-PUBLIC SYMBOL *EnterSymbol( char *String, int hashindex );
-PUBLIC void   DumpSymbols( int scope );
-PUBLIC void   RemoveSymbols( int scope );
+typedef struct  {                   /* see "GetSymbolStats"                  */
+    long Probes;                /* calls of Probe                            */
+    long Misses;                /* of them, names with no symbol             */
+    long Entered;               /* calls of EnterSymbol                      */
+    long Removals;              /* calls of RemoveSymbols                    */
+    long Removed;               /* symbols they deleted                      */
+    int  Resizes;               /* times the table has grown                 */
+    int  Symbols;               /* symbols in the table now                  */
+    int  Chains;                /* chains (atoms) the table has room for     */
+    int  LongestChain;          /* most symbols with one name (shadowing)    */
+    ARENASTATS Memory;          /* the arena the symbols are kept in         */
+}
+    SYMBOLSTATS;
+
+typedef struct symboltable  SYMBOLTABLE;
+
+PUBLIC SYMBOLTABLE *MakeSymbolTable( void );
+PUBLIC void   FreeSymbolTable( SYMBOLTABLE *symtab );
+PUBLIC void   ResetSymbolTable( SYMBOLTABLE *symtab );
+PUBLIC SYMBOL *Probe( CONTEXT *ctx, int atom );
+PUBLIC SYMBOL *EnterSymbol( CONTEXT *ctx, int atom );
+PUBLIC void   DumpSymbols( CONTEXT *ctx, int scope );
+PUBLIC int    GetSymbols( CONTEXT *ctx, SYMBOL *table[], int max );
+PUBLIC void   RemoveSymbols( CONTEXT *ctx, int scope );
+PUBLIC void   GetSymbolStats( CONTEXT *ctx, SYMBOLSTATS *stats );
 
 #endif
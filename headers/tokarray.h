@@ -0,0 +1,73 @@
+#ifndef  TOKARRAYHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      tokarray.h                                                           */
+/*                                                                           */
+/*      Header file for "tokarray.c", the tokens ahead of the parser.  The   */
+/*      scanner's tokens are kept in a ring of TOKARRAY_SIZE, as a structure */
+/*      of arrays (code, value, pos and atom each in an array of its own),   */
+/*      so that a routine looking for a token code only walks the codes.     */
+/*      Token 0 is the current token, the one the parser has got to, and     */
+/*      "Peek" looks at the ones after it, scanning as far as it must;       */
+/*      "Advance" makes the next one current, and "SkipTo" the next one in a */
+/*      SET, for error recovery.                                             */
+/*                                                                           */
+/*      Looking ahead must not move the listing on, or errors found at the   */
+/*      current token would be listed under a later line.  So a parse that   */
+/*      will Peek past token 0 says how far at StartTokens, and the listing  */
+/*      is then deferred (see "DeferListing" in "line.h") and written up to  */
+/*      each token as it becomes current; so it is with a pipe.  Otherwise   */
+/*      the array holds just the current token, and the listing is written   */
+/*      as it is scanned, as before.  A source with LongLines cannot be      */
+/*      deferred: there, an error reported after a Peek past token 0 may     */
+/*      come under a later line.                                             */
+/*                                                                           */
+/*      The Current... macros give the fields of token 0 without a call,     */
+/*      and are only valid once Advance has been called.                     */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  TOKARRAYHEADER
+
+#include "global.h"
+#include "scanner.h"
+#include "sets.h"
+#include "tokpipe.h"
+
+#define  TOKARRAY_SIZE        256   /* tokens held; a power of two           */
+#define  TOKARRAY_MASK        ( TOKARRAY_SIZE - 1 )
+
+typedef struct  {
+    int  Code[TOKARRAY_SIZE];       /* the tokens, each field in an array    */
+    int  Value[TOKARRAY_SIZE];      /* of its own, indexed by the number of  */
+    int  Pos[TOKARRAY_SIZE];        /* the token modulo TOKARRAY_SIZE        */
+    int  Atom[TOKARRAY_SIZE];
+    long Lines[TOKARRAY_SIZE];      /* and the listing mark made with each   */
+    long Line[TOKARRAY_SIZE];       /* (see LISTMARK)                        */
+    unsigned long First;            /* number of token 0                     */
+    unsigned long End;              /* one past the last token scanned       */
+    int  Reach;                     /* how far past token 0 Peek may look    */
+    long ListedLines;               /* the last mark given to ListTo         */
+    long ListedLine;
+    int  Deferred;                  /* the listing is written by Advance     */
+    TOKENPIPE *Pipe;                /* where tokens come from, or NULL for   */
+    CONTEXT *ctx;                   /* GetToken on "ctx"                     */
+}
+    TOKENARRAY;
+
+#define  TOKEN_FIELD(ta,f)      ( (ta)->f[(ta)->First & TOKARRAY_MASK] )
+#define  CurrentCode(ta)        TOKEN_FIELD( ta, Code )
+#define  CurrentValue(ta)       TOKEN_FIELD( ta, Value )
+#define  CurrentPos(ta)         TOKEN_FIELD( ta, Pos )
+#define  CurrentAtom(ta)        TOKEN_FIELD( ta, Atom )
+
+PUBLIC TOKENARRAY *MakeTokenArray( void );
+PUBLIC void   FreeTokenArray( TOKENARRAY *ta );
+PUBLIC void   StartTokens( CONTEXT *ctx, int lookahead, int pipelined );
+PUBLIC void   StopTokens( CONTEXT *ctx );
+PUBLIC void   Advance( TOKENARRAY *ta );
+PUBLIC long   SkipTo( TOKENARRAY *ta, SET *set );
+PUBLIC int    Peek( TOKENARRAY *ta, int k );
+PUBLIC TOKEN  PeekToken( TOKENARRAY *ta, int k );
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef  TOKPIPEHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      tokpipe.h                                                            */
+/*                                                                           */
+/*      Header file for "tokpipe.c", which runs the scanner on a thread of   */
+/*      its own (see "comp -p").  The scanner thread puts each token into a  */
+/*      ring of PIPE_TOKENS, and the parser's token array ("tokarray.h")     */
+/*      takes them out with PipedToken instead of calling GetToken, so       */
+/*      scanning and parsing overlap.  The ring has one writer and one       */
+/*      reader, so it needs no lock: each side only publishes how far it     */
+/*      has got.                                                             */
+/*                                                                           */
+/*      The listing must be deferred (see "DeferListing" in "line.h"): each  */
+/*      token comes with its mark, and the token array writes the listing    */
+/*      up to it as the parser gets to it, so the listing and the errors in  */
+/*      it come out in the same order as without the pipe.  While the pipe   */
+/*      is running the scanner's thread owns the character processor and     */
+/*      the string table, but for AtomName, and the parser's owns the rest   */
+/*      of the CONTEXT.                                                      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  TOKPIPEHEADER
+
+#include "global.h"
+#include "scanner.h"
+#include "line.h"
+
+#define  PIPE_TOKENS         4096   /* size of the ring; a power of two      */
+#define  PIPE_SPINS           100   /* polls before a waiting side yields    */
+
+typedef struct tokenpipe  TOKENPIPE;
+
+PUBLIC TOKENPIPE *StartTokenPipe( CONTEXT *ctx );
+PUBLIC TOKEN  PipedToken( TOKENPIPE *pipe, LISTMARK *mark );
+PUBLIC void   StopTokenPipe( TOKENPIPE *pipe );
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef  VMHEADER
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      vm.h                                                                 */
+/*                                                                           */
+/*      Header file for "vm.c", an interpreter for the stack machine whose   */
+/*      instructions are defined in "code.h".  A VM is loaded from the code  */
+/*      table of a CONTEXT after a successful compilation and can then be    */
+/*      run any number of times.                                             */
+/*                                                                           */
+/*      The machine has a memory of words, a stack pointer SP (the next      */
+/*      free word), a frame pointer FP and a small display of frame          */
+/*      pointers.  Absolute addresses ("Load <addr>") name words at the      */
+/*      bottom of memory; the stack starts just above the highest one used   */
+/*      by the program.  Two-operand instructions pop the right operand      */
+/*      first.  The conditional branches pop a value and branch if it is     */
+/*      >= 0 (Bgz), > 0 (Bg), <= 0 (Blz), < 0 (Bl), = 0 (Bz) or != 0 (Bnz).  */
+/*                                                                           */
+/*          Push FP    push FP              Call <a>   push return, goto a   */
+/*          Bsf        FP := SP             Ret        pop return address    */
+/*          Rsf        SP := FP, pop FP     Inc/Dec n  SP := SP +/- n        */
+/*          Ldp n      push D[n], D[n]:=FP  Rdp n      pop D[n]              */
+/*          Load [SP]+o  pop a, push M[a+o]                                  */
+/*          Store [SP]+o pop a, pop M[a+o]                                   */
+/*                                                                           */
+/*      Read pushes an integer from the input, Write pops one to the output  */
+/*      and Halt (or running off the end of the code) stops the machine.     */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  VMHEADER
+
+#include <stdio.h>
+#include "global.h"
+
+#define  VM_DEFAULT_MEMORY  (1L << 20)  /* words of memory, code excluded    */
+#define  VM_DISPLAY_SIZE    64          /* entries in the display            */
+
+#define  VM_HALTED          0           /* RunVM results: normal stop        */
+#define  VM_STACK_OVERFLOW  1
+#define  VM_STACK_UNDERFLOW 2
+#define  VM_BAD_ADDRESS     3           /* memory access outside memory      */
+#define  VM_BAD_RETURN      4           /* Ret to an address outside code    */
+#define  VM_DIVIDE_BY_ZERO  5
+#define  VM_BAD_INPUT       6           /* Read found no integer             */
+
+typedef struct vm  VM;
+
+PUBLIC VM   *LoadVM( CONTEXT *ctx, long memsize );
+PUBLIC void FreeVM( VM *vm );
+PUBLIC int  RunVM( VM *vm, FILE *input, FILE *output );
+PUBLIC long VMInstructionCount( VM *vm );
+PUBLIC char *VMErrorString( int status );
+
+#endif
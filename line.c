@@ -0,0 +1,667 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      line.c                                                               */
+/*                                                                           */
+/*      Character processor for the CPL compiler.  The whole source is made  */
+/*      available as a single read-only buffer, memory-mapped where the      */
+/*      input is a regular file and otherwise read in large blocks, unless   */
+/*      the caller already has it in memory ("InitCharBuffer").              */
+/*      "ReadChar" and "UnReadChar" step through that buffer directly, and   */
+/*      a LINE only records where the current line starts in the buffer, so  */
+/*      no characters are copied on the way to the scanner.  The listing is  */
+/*      written to a SINK from the same buffer, expanding tabs as it goes.   */
+/*                                                                           */
+/*      As before, the listing runs one line behind the input so that        */
+/*      errors detected while the scanner is looking ahead into the next     */
+/*      line are still reported under the line that caused them.             */
+/*                                                                           */
+/*      When the scanner runs on a thread of its own (see "tokpipe.h") the   */
+/*      listing is deferred: ReadChar only counts the lines it would have    */
+/*      listed, each token is marked with that count ("MarkListing"), and    */
+/*      the parser's thread lists the lines up to a token when it takes it   */
+/*      ("ListTo").  Errors are kept against line numbers rather than LINEs  */
+/*      then, so the listing is the same as when the scanner runs inline.    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "global.h"
+#include "line.h"
+#include "context.h"
+
+#define  SOURCE_BLOCK_SIZE     65536    /* read size when mmap unavailable   */
+
+typedef struct  {
+    int  used;                          /* line holds at least one char      */
+    int  pos;                           /* column (tabs expanded)            */
+    const char *text;                   /* start of line in source buffer    */
+    int  nbytes;                        /* source bytes consumed by the line */
+    int  addnewline;                    /* EOF reached on unterminated line  */
+    int  errcount;
+    int  errpos[M_ERRS_LINE];
+    char errmsg[M_ERRS_LINE][M_LINE_WIDTH+2];
+}
+    LINE;
+
+struct charprocessor  {
+    SINK *List;                         /* the listing, or NULL              */
+
+    const char *Source;                 /* start of source buffer            */
+    const char *SourceEnd;              /* one past its last byte            */
+    const char *NextChar;               /* next byte to be read              */
+    void *MappedBase;                   /* non-NULL if Source is an mmap     */
+    size_t MappedLength;
+    char *ReadBuffer;                   /* non-NULL if Source was read in    */
+
+    LINE LineStore[2];
+    int  LinesAllocated;
+    LINE *CurrentLine;
+    LINE *PreviousLine;
+
+    int  CurrentLineNum;
+    long Errors;                        /* calls of Error                    */
+    int  TabWidth;
+    int  PushBack;
+    int  ReadEOF;
+
+    int  Deferred;                      /* listing written by ListTo         */
+    long Counted;                       /* lines ReadChar has finished with  */
+    long Listed;                        /* lines ListTo has written, ...     */
+    const char *ListNext;               /* ... and where the next one starts */
+    long ErrorLine;                     /* line Error attaches to, or -1     */
+    LINE Pending[2];                    /* errors for lines not yet listed,  */
+    long PendingLine[2];                /* by line number & 1                */
+};
+
+PRIVATE void LoadSource( CHARPROCESSOR *cp, FILE *inputfile );
+PRIVATE void Restart( CHARPROCESSOR *cp, SINK *listing );
+PRIVATE void ReleaseSource( CHARPROCESSOR *cp );
+PRIVATE LINE *NewLine( CHARPROCESSOR *cp );
+PRIVATE void SwapLines( LINE **a, LINE **b );
+PRIVATE void EndLine( CHARPROCESSOR *cp, int numbered, LINE *line );
+PRIVATE void DisplayLine( CHARPROCESSOR *cp, int numbered, LINE *line );
+PRIVATE void DisplayErrorMessage( CHARPROCESSOR *cp, int pos, char *msg );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      MakeCharProcessor / FreeCharProcessor: create a character processor  */
+/*      with no input attached, and release one along with its source        */
+/*      buffer.  Neither touches the input or listing files.                 */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC CHARPROCESSOR *MakeCharProcessor( void )
+{
+    CHARPROCESSOR *cp;
+
+    if ( NULL == ( cp = calloc( 1, sizeof( CHARPROCESSOR ) ) ) )  {
+        fprintf( stderr, "error, failed to allocate memory for character processor\n" );
+        exit( EXIT_FAILURE );
+    }
+    cp->CurrentLineNum = 1;
+    cp->TabWidth = 8;
+    return cp;
+}
+
+PUBLIC void FreeCharProcessor( CHARPROCESSOR *cp )
+{
+    if ( cp != NULL )  {
+        ReleaseSource( cp );
+        free( cp );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      InitCharProcessor: make the contents of "inputfile" available to     */
+/*      ReadChar, and direct the program listing to "listing" (which may be  */
+/*      NULL if no listing is wanted).                                       */
+/*                                                                           */
+/*      InitCharBuffer: the same, but the source is the "length" bytes at    */
+/*      "source", which must stay put until the compilation is over.         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void InitCharProcessor( CONTEXT *ctx, FILE *inputfile, SINK *listing )
+{
+    if ( inputfile == NULL )  {
+        fprintf( stderr, "Fatal Error: InitCharProcessor: attempt to\n" );
+        fprintf( stderr, "use an invalid file handle (NULL) for input\n" );
+        exit( EXIT_FAILURE );
+    }
+    LoadSource( ctx->line, inputfile );
+    Restart( ctx->line, listing );
+}
+
+PUBLIC void InitCharBuffer( CONTEXT *ctx, const char *source, size_t length, SINK *listing )
+{
+    CHARPROCESSOR *cp = ctx->line;
+
+    ReleaseSource( cp );
+    cp->Source = cp->NextChar = source;
+    cp->SourceEnd = source + length;
+    Restart( cp, listing );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Error: attach an error message to the current line, to be listed     */
+/*      under it, or display it at once if there is no current line.  The    */
+/*      message is also echoed on stderr unless the listing goes there.      */
+/*      While the listing is deferred the current line is the one ListTo     */
+/*      was last given, not the one the scanner has got to.                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void Error( CONTEXT *ctx, char *ErrorString, int PositionInLine )
+{
+    CHARPROCESSOR *cp = ctx->line;
+    LINE *line;
+
+    cp->Errors++;
+    if ( !cp->Deferred )  line = cp->CurrentLine;
+    else if ( cp->ErrorLine < 0 )  line = NULL;
+    else  {
+        line = &cp->Pending[cp->ErrorLine & 1];
+        if ( cp->PendingLine[cp->ErrorLine & 1] != cp->ErrorLine )  {
+            cp->PendingLine[cp->ErrorLine & 1] = cp->ErrorLine;
+            line->errcount = 0;
+            line->used = 1;
+        }
+    }
+    if ( line == NULL || !line->used )  {
+        if ( cp->List != NULL )  DisplayErrorMessage( cp, PositionInLine, ErrorString );
+    }
+    else if ( line->errcount < M_ERRS_LINE && cp->List != NULL )  {
+        strncpy( line->errmsg[line->errcount], ErrorString, M_LINE_WIDTH );
+        line->errmsg[line->errcount][M_LINE_WIDTH] = '\0';
+        line->errpos[line->errcount] = PositionInLine;
+        line->errcount++;
+    }
+    if ( !ctx->speculative && !ctx->quiet &&
+         ( cp->List == NULL || ( cp->List->File != stderr && cp->List->File != stdin ) ) )
+        fprintf( stderr, "Error: %s\n", ErrorString );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ReadChar: return the next character of the source, or EOF.  Tabs     */
+/*      are returned as a single space but advance the column to the next    */
+/*      tab stop.                                                            */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int ReadChar( CONTEXT *ctx )
+{
+    CHARPROCESSOR *cp = ctx->line;
+    int ch, i, tabstop;
+    LINE *line = cp->CurrentLine;
+
+    /* Fast path: an ordinary character in the middle of a line.           */
+    if ( !cp->PushBack && line != NULL && line->used && cp->NextChar < cp->SourceEnd &&
+         line->pos < M_LINE_WIDTH )  {
+        ch = (unsigned char) *cp->NextChar;
+        if ( ch != '\n' && ch != '\t' )  {
+            cp->NextChar++;
+            line->nbytes++;
+            line->pos++;
+            return ch;
+        }
+    }
+
+    if ( cp->ReadEOF )  return EOF;
+
+    if ( cp->PushBack )  {
+        if ( cp->CurrentLine == NULL )  {
+            fprintf( stderr, "No current line, but PushBack true\n" );
+            exit( EXIT_FAILURE );
+        }
+        ch = (unsigned char) cp->NextChar[-1];
+        if ( ch == '\t' )  ch = ' ';
+        cp->PushBack = 0;
+        cp->CurrentLine->pos++;
+    }
+    else  {
+        if ( cp->CurrentLine == NULL )  cp->CurrentLine = NewLine( cp );
+        if ( cp->NextChar >= cp->SourceEnd )  ch = EOF;
+        else  {
+            if ( !cp->CurrentLine->used )  {
+                cp->CurrentLine->text = cp->NextChar;
+                cp->CurrentLine->nbytes = 0;
+            }
+            ch = (unsigned char) *cp->NextChar++;
+            cp->CurrentLine->used = 1;
+            cp->CurrentLine->nbytes++;
+            if ( ch == '\t' )  {
+                i = cp->CurrentLine->pos;
+                for ( tabstop = cp->TabWidth; tabstop <= i; tabstop += cp->TabWidth )
+                    ;
+                while ( i < tabstop && i < M_LINE_WIDTH )  i++;
+                cp->CurrentLine->pos = i;
+                ch = ' ';
+            }
+            else  cp->CurrentLine->pos++;
+        }
+    }
+
+    if ( ch == '\n' )  {
+        EndLine( cp, 1, cp->PreviousLine );
+        SwapLines( &cp->CurrentLine, &cp->PreviousLine );
+        if ( cp->CurrentLine != NULL )  {
+            cp->CurrentLine->used = 0;
+            cp->CurrentLine->pos = 0;
+        }
+    }
+    else if ( cp->CurrentLine->pos > M_LINE_WIDTH )  {
+        EndLine( cp, 0, cp->PreviousLine );
+        SwapLines( &cp->CurrentLine, &cp->PreviousLine );
+        if ( cp->CurrentLine != NULL )  {
+            cp->CurrentLine->used = 0;
+            cp->CurrentLine->pos = 0;
+        }
+    }
+    else if ( ch == EOF )  {
+        if ( cp->CurrentLine->used && cp->CurrentLine->pos )  {
+            cp->CurrentLine->addnewline = 1;
+            cp->CurrentLine->pos++;
+        }
+        EndLine( cp, 1, cp->PreviousLine );
+        EndLine( cp, 1, cp->CurrentLine );
+        cp->ReadEOF = 1;
+    }
+    return ch;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      UnReadChar: push back the last character read.  Only one character   */
+/*      of push back is supported.                                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void UnReadChar( CONTEXT *ctx )
+{
+    CHARPROCESSOR *cp = ctx->line;
+
+    if ( cp->PushBack )  {
+        fprintf( stderr, "Attempt to unread more than one character\n" );
+        exit( EXIT_FAILURE );
+    }
+    if ( !cp->ReadEOF )  {
+        if ( cp->CurrentLine == NULL || !cp->CurrentLine->used || cp->CurrentLine->pos == 0 )  {
+            if ( cp->PreviousLine == NULL )  {
+                fprintf( stderr, "Attempt to push back character " );
+                fprintf( stderr, "before start of file\n" );
+                exit( EXIT_FAILURE );
+            }
+            SwapLines( &cp->CurrentLine, &cp->PreviousLine );
+            if ( cp->PreviousLine != NULL )  {
+                cp->PreviousLine->used = 0;
+                cp->PreviousLine->pos = 0;
+                cp->PreviousLine->errcount = 0;
+            }
+        }
+        cp->CurrentLine->pos--;
+    }
+    cp->PushBack = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      CurrentCharPos: column just past the last character read on the      */
+/*      current line, or zero at the start of a line.                        */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int CurrentCharPos( CONTEXT *ctx )
+{
+    CHARPROCESSOR *cp = ctx->line;
+
+    if ( cp->CurrentLine == NULL || !cp->CurrentLine->used )  return 0;
+    else  return cp->CurrentLine->pos;
+}
+
+PUBLIC void SetTabWidth( CONTEXT *ctx, int NewTabWidth )
+{
+    if ( NewTabWidth > 2 && NewTabWidth <= 8 )  ctx->line->TabWidth = NewTabWidth;
+    else  {
+        fprintf( stderr, "Fatal Error: SetTabWidth: attempt to set an " );
+        fprintf( stderr, "illegal tab size (%1d).\n", NewTabWidth );
+        fprintf( stderr, "Legal range is 3 to 8\n" );
+        exit( EXIT_FAILURE );
+    }
+}
+
+PUBLIC int GetTabWidth( CONTEXT *ctx )
+{
+    return ctx->line->TabWidth;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetLineStats: copy the lines and bytes of source read so far, and    */
+/*      the bytes of listing written, into "stats" (see LINESTATS).  The     */
+/*      lines are counted here, so this takes time in proportion to the      */
+/*      source, and the listing sink must still be there.                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void GetLineStats( CONTEXT *ctx, LINESTATS *stats )
+{
+    CHARPROCESSOR *cp = ctx->line;
+    const char *p, *nl;
+
+    stats->Lines = 0;
+    for ( p = cp->Source; p < cp->NextChar; p = nl + 1 )  {
+        stats->Lines++;
+        if ( NULL == ( nl = memchr( p, '\n', cp->NextChar - p ) ) )  break;
+    }
+    stats->BytesRead = (long) ( cp->NextChar - cp->Source );
+    stats->ListingBytes = cp->List != NULL ? cp->List->Written : 0L;
+    stats->Errors = cp->Errors;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetSource: the source buffer, all of it, and its "length".  It       */
+/*      belongs to the character processor and must not be changed.          */
+/*                                                                           */
+/*      SetLineNumber: number the next line listed "line", for a source      */
+/*      that is one part of a larger one (see "split.h").                    */
+/*                                                                           */
+/*      SkipSource: pass over the next "length" bytes of source, which have  */
+/*      been compiled elsewhere, writing the "listlength" bytes of listing   */
+/*      made for them there in place of their own.  Only whole lines may be  */
+/*      skipped, and only before anything has been read on the line.         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC const char *GetSource( CONTEXT *ctx, size_t *length )
+{
+    *length = (size_t) ( ctx->line->SourceEnd - ctx->line->Source );
+    return ctx->line->Source;
+}
+
+PUBLIC void SetLineNumber( CONTEXT *ctx, int line )
+{
+    ctx->line->CurrentLineNum = line;
+}
+
+PUBLIC void SkipSource( CONTEXT *ctx, size_t length, const char *listing, size_t listlength )
+{
+    CHARPROCESSOR *cp = ctx->line;
+
+    if ( length > (size_t) ( cp->SourceEnd - cp->NextChar ) )  length = cp->SourceEnd - cp->NextChar;
+    cp->NextChar += length;
+    if ( cp->List != NULL )  SinkWrite( cp->List, listing, listlength );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      LongLines: whether any line of the source is too long to be listed   */
+/*      on one line, i.e. takes more than M_LINE_WIDTH columns with its      */
+/*      tabs expanded.  Such a line is listed in numbered and unnumbered     */
+/*      pieces, which neither a split source nor a deferred listing can      */
+/*      reproduce.                                                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int LongLines( CONTEXT *ctx )
+{
+    CHARPROCESSOR *cp = ctx->line;
+    const char *p;
+    int col = 0, tabstop;
+
+    for ( p = cp->Source; p < cp->SourceEnd; p++ )  {
+        if ( *p == '\n' )  col = 0;
+        else if ( *p == '\t' )  {
+            for ( tabstop = cp->TabWidth; tabstop <= col; tabstop += cp->TabWidth )
+                ;
+            col = tabstop < M_LINE_WIDTH ? tabstop : M_LINE_WIDTH;
+        }
+        else if ( ++col > M_LINE_WIDTH )  return 1;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      DeferListing: from now on ReadChar only counts the lines it is done  */
+/*      with, and the listing is written by ListTo.  Must be called before   */
+/*      anything is read, on a source without LongLines.                     */
+/*                                                                           */
+/*      MarkListing: where the listing would be now, for the token just      */
+/*      read; called on the scanner's thread.                                */
+/*                                                                           */
+/*      ListTo: write the listing up to "mark" and attach the errors that    */
+/*      follow to the line it was on; called on the parser's thread as it    */
+/*      takes the token.  Marks must be given in the order they were made.   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void DeferListing( CONTEXT *ctx )
+{
+    CHARPROCESSOR *cp = ctx->line;
+
+    cp->Deferred = 1;
+    cp->Counted = cp->Listed = 0;
+    cp->ListNext = cp->NextChar;
+    cp->ErrorLine = -1;
+    cp->PendingLine[0] = cp->PendingLine[1] = -1;
+}
+
+PUBLIC void MarkListing( CONTEXT *ctx, LISTMARK *mark )
+{
+    CHARPROCESSOR *cp = ctx->line;
+    int previous = cp->PreviousLine != NULL && cp->PreviousLine->used;
+
+    mark->Lines = cp->Counted;
+    if ( cp->CurrentLine != NULL && cp->CurrentLine->used )  mark->Current = cp->Counted + previous;
+    else  mark->Current = -1;
+}
+
+PUBLIC void ListTo( CONTEXT *ctx, LISTMARK *mark )
+{
+    CHARPROCESSOR *cp = ctx->line;
+    const char *nl;
+    LINE *line;
+
+    while ( cp->Listed < mark->Lines )  {
+        line = &cp->Pending[cp->Listed & 1];
+        if ( cp->PendingLine[cp->Listed & 1] != cp->Listed )  line->errcount = 0;
+        cp->PendingLine[cp->Listed & 1] = -1;
+        line->used = 1;
+        line->addnewline = 0;
+        line->text = cp->ListNext;
+        if ( NULL == ( nl = memchr( line->text, '\n', cp->SourceEnd - line->text ) ) )  {
+            line->nbytes = (int) ( cp->SourceEnd - line->text );
+            line->addnewline = 1;
+        }
+        else  line->nbytes = (int) ( nl + 1 - line->text );
+        cp->ListNext += line->nbytes;
+        cp->Listed++;
+        DisplayLine( cp, 1, line );
+    }
+    cp->ErrorLine = mark->Current;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      LoadSource: map the rest of "inputfile" into memory.  Streams that   */
+/*      cannot be mapped (pipes, terminals, empty files) are read in         */
+/*      SOURCE_BLOCK_SIZE blocks into a buffer that doubles as needed.       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void LoadSource( CHARPROCESSOR *cp, FILE *inputfile )
+{
+    struct stat st;
+    long start;
+    size_t size = 0, capacity = 0, n;
+    char *newbuf;
+    int fd;
+
+    ReleaseSource( cp );
+
+    fd = fileno( inputfile );
+    start = ftell( inputfile );
+    if ( start < 0 )  start = 0;
+    if ( fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > start )  {
+        cp->MappedLength = (size_t) st.st_size;
+        cp->MappedBase = mmap( NULL, cp->MappedLength, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( cp->MappedBase != MAP_FAILED )  {
+            cp->Source = (const char *) cp->MappedBase + start;
+            cp->SourceEnd = (const char *) cp->MappedBase + cp->MappedLength;
+            cp->NextChar = cp->Source;
+            return;
+        }
+        cp->MappedBase = NULL;
+    }
+
+    do  {
+        if ( capacity - size < SOURCE_BLOCK_SIZE )  {
+            capacity = capacity == 0 ? SOURCE_BLOCK_SIZE : 2 * capacity;
+            if ( NULL == ( newbuf = realloc( cp->ReadBuffer, capacity ) ) )  {
+                fprintf( stderr, "error, failed to allocate memory for source\n" );
+                exit( EXIT_FAILURE );
+            }
+            cp->ReadBuffer = newbuf;
+        }
+        n = fread( cp->ReadBuffer + size, 1, SOURCE_BLOCK_SIZE, inputfile );
+        size += n;
+    }  while ( n == SOURCE_BLOCK_SIZE );
+
+    cp->Source = cp->ReadBuffer;
+    cp->SourceEnd = cp->ReadBuffer + size;
+    cp->NextChar = cp->Source;
+}
+
+/*  Start reading the source from the top, listing it to "listing".          */
+
+PRIVATE void Restart( CHARPROCESSOR *cp, SINK *listing )
+{
+    cp->List = listing;
+    cp->CurrentLine = cp->PreviousLine = NULL;
+    cp->LinesAllocated = 0;
+    cp->CurrentLineNum = 1;
+    cp->Errors = 0;
+    cp->PushBack = cp->ReadEOF = 0;
+    cp->Deferred = 0;
+}
+
+PRIVATE void ReleaseSource( CHARPROCESSOR *cp )
+{
+    if ( cp->MappedBase != NULL )  munmap( cp->MappedBase, cp->MappedLength );
+    cp->MappedBase = NULL;
+    free( cp->ReadBuffer );
+    cp->ReadBuffer = NULL;
+    cp->Source = cp->SourceEnd = cp->NextChar = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      NewLine: at most two LINEs (current and previous) are live at any    */
+/*      one time, so they are taken from a pair kept in the processor.       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE LINE *NewLine( CHARPROCESSOR *cp )
+{
+    LINE *line = &cp->LineStore[cp->LinesAllocated++ & 1];
+
+    line->used = 0;
+    line->pos = 0;
+    line->nbytes = 0;
+    line->addnewline = 0;
+    line->errcount = 0;
+    return line;
+}
+
+PRIVATE void SwapLines( LINE **a, LINE **b )
+{
+    LINE *tmp = *a;
+
+    *a = *b;
+    *b = tmp;
+}
+
+/*  ReadChar is done with "line": list it, or count it for ListTo.           */
+
+PRIVATE void EndLine( CHARPROCESSOR *cp, int numbered, LINE *line )
+{
+    if ( !cp->Deferred )  DisplayLine( cp, numbered, line );
+    else if ( line != NULL && line->used && cp->List != NULL )  {
+        cp->Counted++;
+        line->used = 0;
+        line->pos = 0;
+        line->addnewline = 0;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      DisplayLine: write a line to the listing straight from the source    */
+/*      buffer, followed by any errors attached to it.  Tabs are expanded    */
+/*      exactly as ReadChar counted them.  Continuation lines (the tail of   */
+/*      a line longer than M_LINE_WIDTH) are not numbered.                   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void DisplayLine( CHARPROCESSOR *cp, int numbered, LINE *line )
+{
+    const char *p, *run, *end;
+    int i, col, tabstop;
+
+    if ( line != NULL && line->used && cp->List != NULL )  {
+        if ( numbered == 1 )  SinkPrintf( cp->List, "%3d ", cp->CurrentLineNum++ );
+        else  SinkWrite( cp->List, "    ", 4 );
+
+        col = 0;
+        end = line->text + line->nbytes;
+        for ( p = run = line->text; p < end && *p != '\0'; p++ )  {
+            if ( *p == '\t' )  {
+                SinkWrite( cp->List, run, p - run );
+                for ( tabstop = cp->TabWidth; tabstop <= col; tabstop += cp->TabWidth )
+                    ;
+                while ( col < tabstop && col < M_LINE_WIDTH )  {
+                    SinkPutc( cp->List, ' ' );
+                    col++;
+                }
+                run = p + 1;
+            }
+            else  col++;
+        }
+        SinkWrite( cp->List, run, p - run );
+        if ( line->addnewline && p == end )  SinkPutc( cp->List, '\n' );
+
+        for ( i = 0; i < line->errcount; i++ )
+            DisplayErrorMessage( cp, line->errpos[i], line->errmsg[i] );
+        line->used = 0;
+        line->pos = 0;
+        line->addnewline = 0;
+        line->errcount = 0;
+    }
+}
+
+PRIVATE void DisplayErrorMessage( CHARPROCESSOR *cp, int pos, char *msg )
+{
+    int i;
+
+    SinkWrite( cp->List, "    ", 4 );
+    for ( i = 0; i < pos; i++ )  SinkPutc( cp->List, ' ' );
+    SinkPrintf( cp->List, "^\n%s\n", msg );
+}
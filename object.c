@@ -0,0 +1,202 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      object.c                                                             */
+/*                                                                           */
+/*      Binary object files (see "object.h").  The whole file is built in    */
+/*      one buffer and written with a single fwrite; it is read back with    */
+/*      mmap, and the sections are used where they lie in the mapping, so    */
+/*      loading costs a few checks however large the program is.             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "global.h"
+#include "code.h"
+#include "symbol.h"
+#include "object.h"
+#include "context.h"
+
+PRIVATE int CheckObject( OBJECTFILE *obj, char *filename );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      WriteObjectFile: write the code table and symbol table of "ctx" to   */
+/*      "objfile" as an object file.  If code generation was killed only     */
+/*      the header is written, with OBJ_NO_CODE set.  The file is left       */
+/*      open.  Returns 1 if the file was written successfully, 0 if not.    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int WriteObjectFile( CONTEXT *ctx, FILE *objfile )
+{
+    OBJHEADER *header;
+    OBJINSTRUCTION *code;
+    OBJSYMBOL *symbols;
+    SYMBOL **table = NULL;
+    char *image, *strings;
+    size_t size;
+    int i, ok;
+
+    header = calloc( 1, sizeof( OBJHEADER ) );
+    if ( header == NULL )  goto nomemory;
+    memcpy( header->Magic, OBJ_MAGIC, sizeof( header->Magic ) );
+    header->ByteOrder = OBJ_BYTE_ORDER;
+    header->WordSize = (int) sizeof( int );
+    header->Version = OBJ_VERSION;
+    if ( CodeGenerationKilled( ctx ) )  {
+        header->Flags = OBJ_NO_CODE;
+        ok = 1 == fwrite( header, sizeof( OBJHEADER ), 1, objfile );
+        free( header );
+        return ok;
+    }
+    header->CodeCount = CurrentCodeAddress( ctx );
+    header->SymbolCount = GetSymbols( ctx, NULL, 0 );
+    if ( header->SymbolCount > 0 )  {
+        if ( NULL == ( table = malloc( header->SymbolCount * sizeof( SYMBOL * ) ) ) )
+            goto nomemory;
+        GetSymbols( ctx, table, header->SymbolCount );
+    }
+    for ( i = 0; i < header->SymbolCount; i++ )
+        header->StringSize += (int) strlen( table[i]->s ) + 1;
+
+    size = sizeof( OBJHEADER ) + header->CodeCount * sizeof( OBJINSTRUCTION ) +
+           header->SymbolCount * sizeof( OBJSYMBOL ) + header->StringSize;
+    if ( NULL == ( image = realloc( header, size ) ) )  goto nomemory;
+    header = (OBJHEADER *) image;
+    code = (OBJINSTRUCTION *) ( image + sizeof( OBJHEADER ) );
+    symbols = (OBJSYMBOL *) ( code + header->CodeCount );
+    strings = (char *) ( symbols + header->SymbolCount );
+
+    for ( i = 0; i < header->CodeCount; i++ )
+        code[i].Opcode = GetInstruction( ctx, i, &code[i].Operand );
+    for ( i = 0; i < header->SymbolCount; i++ )  {
+        symbols[i].Name = (int) ( strings - (char *) ( symbols + header->SymbolCount ) );
+        symbols[i].Type = table[i]->type;
+        symbols[i].Scope = table[i]->scope;
+        symbols[i].Address = table[i]->address;
+        strcpy( strings, table[i]->s );
+        strings += strlen( table[i]->s ) + 1;
+    }
+
+    ok = 1 == fwrite( image, size, 1, objfile );
+    free( table );
+    free( image );
+    return ok;
+
+nomemory:
+    fprintf( stderr, "Error, \"WriteObjectFile\", malloc failure\n" );
+    exit( EXIT_FAILURE );
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      LoadObjectFile: map "filename" into memory and return an OBJECTFILE  */
+/*      whose sections point into the mapping.  Returns NULL, after saying   */
+/*      why on stderr, if the file cannot be read or is not a valid object   */
+/*      file for this machine.                                               */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC OBJECTFILE *LoadObjectFile( char *filename )
+{
+    OBJECTFILE *obj;
+    struct stat sb;
+    void *map;
+    int fd;
+
+    if ( -1 == ( fd = open( filename, O_RDONLY ) ) || 0 != fstat( fd, &sb ) )  {
+        fprintf( stderr, "cannot open \"%s\" for input\n", filename );
+        if ( fd != -1 )  close( fd );
+        return NULL;
+    }
+    if ( sb.st_size < (off_t) sizeof( OBJHEADER ) )  {
+        fprintf( stderr, "\"%s\" is not an object file\n", filename );
+        close( fd );
+        return NULL;
+    }
+    map = mmap( NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( map == MAP_FAILED )  {
+        fprintf( stderr, "cannot map \"%s\"\n", filename );
+        return NULL;
+    }
+    if ( NULL == ( obj = malloc( sizeof( OBJECTFILE ) ) ) )  {
+        fprintf( stderr, "Error, \"LoadObjectFile\", malloc failure\n" );
+        exit( EXIT_FAILURE );
+    }
+    obj->Map = map;
+    obj->MapSize = (long) sb.st_size;
+    obj->Header = map;
+    if ( !CheckObject( obj, filename ) )  {
+        FreeObjectFile( obj );
+        return NULL;
+    }
+    return obj;
+}
+
+PUBLIC void FreeObjectFile( OBJECTFILE *obj )
+{
+    if ( obj != NULL )  {
+        munmap( obj->Map, (size_t) obj->MapSize );
+        free( obj );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  The header must match this machine, the sections it describes must       */
+/*  exactly fill the file, and every name must lie within the string         */
+/*  section, which must end with a NUL.  Sets the section pointers.          */
+
+PRIVATE int CheckObject( OBJECTFILE *obj, char *filename )
+{
+    OBJHEADER *h = obj->Header;
+    double size;
+    int i;
+
+    if ( 0 != memcmp( h->Magic, OBJ_MAGIC, sizeof( h->Magic ) ) )  {
+        fprintf( stderr, "\"%s\" is not an object file\n", filename );
+        return 0;
+    }
+    if ( h->ByteOrder != OBJ_BYTE_ORDER || h->WordSize != (int) sizeof( int ) )  {
+        fprintf( stderr, "\"%s\" was written on a different kind of machine\n", filename );
+        return 0;
+    }
+    if ( h->Version != OBJ_VERSION )  {
+        fprintf( stderr, "\"%s\" is object format version %d, not %d\n",
+                 filename, h->Version, OBJ_VERSION );
+        return 0;
+    }
+    size = (double) sizeof( OBJHEADER ) +
+           (double) h->CodeCount * sizeof( OBJINSTRUCTION ) +
+           (double) h->SymbolCount * sizeof( OBJSYMBOL ) + (double) h->StringSize;
+    if ( h->CodeCount < 0 || h->SymbolCount < 0 || h->StringSize < 0 ||
+         size != (double) obj->MapSize ||
+         ( h->StringSize > 0 && ( (char *) obj->Map )[obj->MapSize - 1] != '\0' ) )  {
+        fprintf( stderr, "\"%s\" is damaged\n", filename );
+        return 0;
+    }
+    obj->Code = (OBJINSTRUCTION *) ( h + 1 );
+    obj->Symbols = (OBJSYMBOL *) ( obj->Code + h->CodeCount );
+    obj->Strings = (char *) ( obj->Symbols + h->SymbolCount );
+    for ( i = 0; i < h->SymbolCount; i++ )  {
+        if ( obj->Symbols[i].Name < 0 || obj->Symbols[i].Name >= h->StringSize )  {
+            fprintf( stderr, "\"%s\" is damaged\n", filename );
+            return 0;
+        }
+    }
+    return 1;
+}
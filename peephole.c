@@ -0,0 +1,324 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      peephole.c                                                           */
+/*                                                                           */
+/*      Peephole optimiser for the code table.  Each entry of "Rules" names  */
+/*      a short run of opcodes and a routine that rewrites a matching run    */
+/*      in place, deleting instructions it no longer needs.  The rules are   */
+/*      applied until none of them changes anything; the code is then        */
+/*      compacted and every branch, call and procedure address is moved to   */
+/*      the new position of the instruction it referred to.                  */
+/*                                                                           */
+/*      A run is only rewritten if no branch or call lands inside it (on     */
+/*      any instruction but the first), so the code reached by every jump    */
+/*      is unchanged.  The rules assume that the stack holds the operands    */
+/*      each instruction needs, as it does in code from the parser.          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "global.h"
+#include "code.h"
+#include "symbol.h"
+#include "peephole.h"
+#include "context.h"
+
+#define  PH_DELETED         -1      /* opcode of a deleted instruction       */
+#define  PH_BRANCH          -2      /* in a rule, matches Br .. Bnz          */
+#define  MAX_WINDOW          3      /* longest run matched by a rule         */
+#define  MAX_CHAIN          16      /* Br-to-Br hops followed by a branch    */
+
+typedef struct  {
+    int  opcode;
+    int  offset;
+}
+    PHINSTRUCTION;
+
+typedef struct  {
+    PHINSTRUCTION *Code;
+    char          *Target;          /* non-zero if a branch or call lands    */
+    int           Length;
+}
+    PHCODE;
+
+/*  A REWRITE is given the (undeleted) instructions matched by its rule and  */
+/*  returns 1 if it changed them, 0 if they did not qualify after all.       */
+
+typedef int (*REWRITE)( PHCODE *pc, int at[] );
+
+typedef struct  {
+    int     Length;
+    int     Opcodes[MAX_WINDOW];
+    REWRITE Rewrite;
+}
+    RULE;
+
+PRIVATE int DropZeroSize( PHCODE *pc, int at[] );
+PRIVATE int MergeSizes( PHCODE *pc, int at[] );
+PRIVATE int NegateConstant( PHCODE *pc, int at[] );
+PRIVATE int DropPair( PHCODE *pc, int at[] );
+PRIVATE int DropIdentity( PHCODE *pc, int at[] );
+PRIVATE int FoldConstants( PHCODE *pc, int at[] );
+PRIVATE int ThreadBranch( PHCODE *pc, int at[] );
+PRIVATE int DropBranchToNext( PHCODE *pc, int at[] );
+
+PRIVATE RULE Rules[] =  {
+    { 1, { I_INC },                     DropZeroSize },     /* Inc 0         */
+    { 1, { I_DEC },                     DropZeroSize },     /* Dec 0         */
+    { 2, { I_INC, I_INC },              MergeSizes },       /* Inc a; Inc b  */
+    { 2, { I_INC, I_DEC },              MergeSizes },
+    { 2, { I_DEC, I_INC },              MergeSizes },
+    { 2, { I_DEC, I_DEC },              MergeSizes },
+    { 2, { I_LOADI, I_NEG },            NegateConstant },   /* Load #-a      */
+    { 2, { I_NEG, I_NEG },              DropPair },
+    { 2, { I_LOADI, I_ADD },            DropIdentity },     /* Load #0; Add  */
+    { 2, { I_LOADI, I_SUB },            DropIdentity },     /* Load #0; Sub  */
+    { 2, { I_LOADI, I_MULT },           DropIdentity },     /* Load #1; Mult */
+    { 2, { I_LOADI, I_DIV },            DropIdentity },     /* Load #1; Div  */
+    { 3, { I_LOADI, I_LOADI, I_ADD },   FoldConstants },    /* Load #a op b  */
+    { 3, { I_LOADI, I_LOADI, I_SUB },   FoldConstants },
+    { 3, { I_LOADI, I_LOADI, I_MULT },  FoldConstants },
+    { 3, { I_LOADI, I_LOADI, I_DIV },   FoldConstants },
+    { 1, { PH_BRANCH },                 ThreadBranch },     /* to a Br       */
+    { 1, { I_BR },                      DropBranchToNext }
+};
+
+#define  RULE_COUNT  ( (int) ( sizeof( Rules ) / sizeof( Rules[0] ) ) )
+
+PRIVATE int  ApplyRules( PHCODE *pc );
+PRIVATE int  Match( PHCODE *pc, RULE *rule, int i, int at[] );
+PRIVATE int  NextLive( PHCODE *pc, int i );
+PRIVATE int  Compact( CONTEXT *ctx, PHCODE *pc );
+PRIVATE int  IsCodeAddress( int opcode );
+PRIVATE void *Allocate( size_t size );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Peephole: optimise the code table of "ctx" in place and return the   */
+/*      number of instructions removed.  The addresses of the procedures     */
+/*      still in the symbol table are moved along with their code.  Nothing  */
+/*      is done if code generation has been killed.                          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int Peephole( CONTEXT *ctx )
+{
+    PHCODE pc;
+    int i, removed;
+
+    if ( CodeGenerationKilled( ctx ) || 0 == ( pc.Length = CurrentCodeAddress( ctx ) ) )
+        return 0;
+    pc.Code = Allocate( pc.Length * sizeof( PHINSTRUCTION ) );
+    pc.Target = Allocate( pc.Length + 1 );
+    for ( i = 0; i <= pc.Length; i++ )  pc.Target[i] = 0;
+    for ( i = 0; i < pc.Length; i++ )  {
+        pc.Code[i].opcode = GetInstruction( ctx, i, &pc.Code[i].offset );
+        if ( IsCodeAddress( pc.Code[i].opcode ) &&
+             pc.Code[i].offset >= 0 && pc.Code[i].offset <= pc.Length )
+            pc.Target[pc.Code[i].offset] = 1;
+    }
+
+    while ( ApplyRules( &pc ) )  ;
+    removed = Compact( ctx, &pc );
+
+    free( pc.Code );
+    free( pc.Target );
+    return removed;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  One pass over the code, returning non-zero if any rule applied.  After   */
+/*  a rewrite the same position is tried again, as the new instruction may   */
+/*  start another match.                                                     */
+
+PRIVATE int ApplyRules( PHCODE *pc )
+{
+    int at[MAX_WINDOW], i, r, first, changed = 0;
+
+    for ( i = NextLive( pc, -1 ); i < pc->Length; i = NextLive( pc, i ) )  {
+        for ( r = 0; r < RULE_COUNT; r++ )  {
+            first = Rules[r].Opcodes[0];
+            if ( first != pc->Code[i].opcode && first != PH_BRANCH )  continue;
+            if ( Match( pc, &Rules[r], i, at ) && Rules[r].Rewrite( pc, at ) )  {
+                changed = 1;
+                if ( pc->Code[i].opcode == PH_DELETED )  break;
+                r = -1;
+            }
+        }
+    }
+    return changed;
+}
+
+PRIVATE int Match( PHCODE *pc, RULE *rule, int i, int at[] )
+{
+    int n, opcode;
+
+    for ( n = 0; n < rule->Length; n++, i = NextLive( pc, i ) )  {
+        if ( i >= pc->Length || ( n > 0 && pc->Target[i] ) )  return 0;
+        opcode = pc->Code[i].opcode;
+        if ( rule->Opcodes[n] == PH_BRANCH ? opcode < I_BR || opcode > I_BNZ
+                                           : opcode != rule->Opcodes[n] )  return 0;
+        at[n] = i;
+    }
+    return 1;
+}
+
+PRIVATE int NextLive( PHCODE *pc, int i )
+{
+    for ( i++; i < pc->Length && pc->Code[i].opcode == PH_DELETED; i++ )  ;
+    return i;
+}
+
+/*  Close up the deleted instructions, write the code back and correct all   */
+/*  code addresses.  An address of a deleted instruction becomes that of     */
+/*  the next one kept, which is where control would have gone anyway.        */
+
+PRIVATE int Compact( CONTEXT *ctx, PHCODE *pc )
+{
+    SYMBOL **table;
+    int *newaddr, i, n = 0, count;
+
+    newaddr = Allocate( ( pc->Length + 1 ) * sizeof( int ) );
+    for ( i = 0; i <= pc->Length; i++ )  {
+        newaddr[i] = n;
+        if ( i < pc->Length && pc->Code[i].opcode != PH_DELETED )  n++;
+    }
+    for ( i = 0; i < pc->Length; i++ )  {
+        if ( pc->Code[i].opcode == PH_DELETED )  continue;
+        if ( IsCodeAddress( pc->Code[i].opcode ) &&
+             pc->Code[i].offset >= 0 && pc->Code[i].offset <= pc->Length )
+            pc->Code[i].offset = newaddr[pc->Code[i].offset];
+        SetInstruction( ctx, newaddr[i], pc->Code[i].opcode, pc->Code[i].offset );
+    }
+    TruncateCode( ctx, n );
+
+    count = GetSymbols( ctx, NULL, 0 );
+    table = Allocate( ( count + 1 ) * sizeof( SYMBOL * ) );
+    GetSymbols( ctx, table, count );
+    for ( i = 0; i < count; i++ )
+        if ( table[i]->type == STYPE_PROCEDURE &&
+             table[i]->address >= 0 && table[i]->address <= pc->Length )
+            table[i]->address = newaddr[table[i]->address];
+
+    free( table );
+    free( newaddr );
+    return pc->Length - n;
+}
+
+PRIVATE int IsCodeAddress( int opcode )
+{
+    return opcode >= I_BR && opcode <= I_CALL;
+}
+
+PRIVATE void *Allocate( size_t size )
+{
+    void *p;
+
+    if ( NULL == ( p = malloc( size ) ) )  {
+        fprintf( stderr, "Error, \"Peephole\", malloc failure\n" );
+        exit( EXIT_FAILURE );
+    }
+    return p;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      The rewrites.                                                        */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE int DropZeroSize( PHCODE *pc, int at[] )
+{
+    if ( pc->Code[at[0]].offset != 0 )  return 0;
+    pc->Code[at[0]].opcode = PH_DELETED;
+    return 1;
+}
+
+PRIVATE int MergeSizes( PHCODE *pc, int at[] )
+{
+    PHINSTRUCTION *a = &pc->Code[at[0]], *b = &pc->Code[at[1]];
+    long size;
+
+    size = a->opcode == I_INC ? (long) a->offset : - (long) a->offset;
+    size += b->opcode == I_INC ? (long) b->offset : - (long) b->offset;
+    if ( size > INT_MAX || size < - (long) INT_MAX )  return 0;
+    a->opcode = size >= 0 ? I_INC : I_DEC;
+    a->offset = (int) ( size >= 0 ? size : -size );
+    b->opcode = PH_DELETED;
+    return 1;
+}
+
+PRIVATE int NegateConstant( PHCODE *pc, int at[] )
+{
+    if ( pc->Code[at[0]].offset == INT_MIN )  return 0;
+    pc->Code[at[0]].offset = -pc->Code[at[0]].offset;
+    pc->Code[at[1]].opcode = PH_DELETED;
+    return 1;
+}
+
+PRIVATE int DropPair( PHCODE *pc, int at[] )
+{
+    pc->Code[at[0]].opcode = PH_DELETED;
+    pc->Code[at[1]].opcode = PH_DELETED;
+    return 1;
+}
+
+/*  Adding or subtracting 0, or multiplying or dividing by 1.                */
+
+PRIVATE int DropIdentity( PHCODE *pc, int at[] )
+{
+    int identity = pc->Code[at[1]].opcode == I_ADD || pc->Code[at[1]].opcode == I_SUB ? 0 : 1;
+
+    if ( pc->Code[at[0]].offset != identity )  return 0;
+    return DropPair( pc, at );
+}
+
+/*  Division by zero is left for run time.                                   */
+
+PRIVATE int FoldConstants( PHCODE *pc, int at[] )
+{
+    if ( !ConstantArithmetic( pc->Code[at[2]].opcode, pc->Code[at[0]].offset,
+                              pc->Code[at[1]].offset, &pc->Code[at[0]].offset ) )
+        return 0;
+    pc->Code[at[1]].opcode = PH_DELETED;
+    pc->Code[at[2]].opcode = PH_DELETED;
+    return 1;
+}
+
+/*  A branch to an unconditional branch goes straight to the final target.   */
+/*  Chains that are too long or loop back are left alone.                    */
+
+PRIVATE int ThreadBranch( PHCODE *pc, int at[] )
+{
+    int target = pc->Code[at[0]].offset, hops, next;
+
+    if ( target < 0 || target > pc->Length )  return 0;
+    for ( hops = 0; hops < MAX_CHAIN; hops++ )  {
+        if ( target == pc->Length )  break;             /* the end, not a Br */
+        next = pc->Code[target].opcode == PH_DELETED ? NextLive( pc, target ) : target;
+        if ( next >= pc->Length || pc->Code[next].opcode != I_BR )  break;
+        if ( next == at[0] )  return 0;
+        target = pc->Code[next].offset;
+        if ( target < 0 || target > pc->Length )  return 0;
+    }
+    if ( hops == 0 || hops == MAX_CHAIN )  return 0;
+    pc->Code[at[0]].offset = target;
+    pc->Target[target] = 1;
+    return 1;
+}
+
+PRIVATE int DropBranchToNext( PHCODE *pc, int at[] )
+{
+    int target = pc->Code[at[0]].offset;
+
+    if ( target <= at[0] || target > NextLive( pc, at[0] ) )  return 0;
+    pc->Code[at[0]].opcode = PH_DELETED;
+    return 1;
+}
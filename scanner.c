@@ -0,0 +1,318 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      scanner.c                                                            */
+/*                                                                           */
+/*      Lexical analyser for the CPL compiler.  "GetToken" is a finite       */
+/*      state machine driven one character at a time by "ReadChar".          */
+/*                                                                           */
+/*      Identifiers are checked against the reserved words by a switch on    */
+/*      the identifier's length and first character, so deciding whether an  */
+/*      identifier is a keyword costs at most a handful of character         */
+/*      comparisons and never a call to a string routine.                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "global.h"
+#include "scanner.h"
+#include "line.h"
+#include "strtab.h"
+#include "sets.h"
+#include "context.h"
+
+#define  S_START            0   /* GetToken states                           */
+#define  S_SKIPSPACE        1
+#define  S_COMMENT          2
+#define  S_COLON            3
+#define  S_LESS             4
+#define  S_GREATER          5
+#define  S_INTCONST         6
+#define  S_IDENTIFIER       7
+#define  S_ILLEGALCHAR      8
+
+#define  MAX_ERRMSG_LEN   256
+
+PRIVATE char *Tokens[] =  {
+    "Scanner Error", "Illegal Character", "End of File", ";", ",", ".",
+    "(", ")", ":=", "+", "-", "*", "/", "=", "<=", ">=", "<", ">",
+    "BEGIN", "DO", "ELSE", "END", "IF", "PROCEDURE", "PROGRAM", "READ",
+    "REF", "THEN", "VAR", "WHILE", "WRITE", "Identifier", "Integer Constant"
+};
+
+#define  MAX_TOKEN_CODE  ( (int) ( sizeof( Tokens ) / sizeof( Tokens[0] ) ) - 1 )
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetToken: return the next TOKEN from the input.  "pos" is the        */
+/*      column at which the token starts; "s" is the token's text if (and    */
+/*      only if) it is an IDENTIFIER, otherwise NULL.                        */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC TOKEN GetToken( CONTEXT *ctx )
+{
+    int state = S_START, more = 1, ch, length = 0;
+    unsigned value = 0;
+    TOKEN token;
+
+    token.code = ERROR;
+    token.value = 0;
+    token.pos = 0;
+    token.s = NULL;
+    token.atom = NO_ATOM;
+
+    while ( more )  {
+        more = 0;
+        switch ( state )  {
+            case S_START:
+                NewString( ctx );
+                state = S_SKIPSPACE;  more = 1;
+                break;
+
+            case S_SKIPSPACE:
+                token.pos = CurrentCharPos( ctx );
+                switch ( ch = ReadChar( ctx ) )  {
+                    case EOF:  token.code = ENDOFINPUT;        break;
+                    case '!':  state = S_COMMENT;  more = 1;   break;
+                    case ';':  token.code = SEMICOLON;         break;
+                    case ',':  token.code = COMMA;             break;
+                    case '.':  token.code = ENDOFPROGRAM;      break;
+                    case '(':  token.code = LEFTPARENTHESIS;   break;
+                    case ')':  token.code = RIGHTPARENTHESIS;  break;
+                    case ':':  state = S_COLON;  more = 1;     break;
+                    case '+':  token.code = ADD;               break;
+                    case '-':  token.code = SUBTRACT;          break;
+                    case '*':  token.code = MULTIPLY;          break;
+                    case '/':  token.code = DIVIDE;            break;
+                    case '=':  token.code = EQUALITY;          break;
+                    case '<':  state = S_LESS;  more = 1;      break;
+                    case '>':  state = S_GREATER;  more = 1;   break;
+                    default:
+                        more = 1;
+                        if ( isspace( ch ) )  state = S_SKIPSPACE;
+                        else if ( isdigit( ch ) )  {
+                            value = ch - '0';
+                            state = S_INTCONST;
+                        }
+                        else if ( isalpha( ch ) )  {
+                            AddChar( ctx, ch );
+                            length = 1;
+                            state = S_IDENTIFIER;
+                        }
+                        else  state = S_ILLEGALCHAR;
+                        break;
+                }
+                break;
+
+            case S_COMMENT:
+                ch = ReadChar( ctx );
+                state = ( ch == '\n' || ch == EOF ) ? S_SKIPSPACE : S_COMMENT;
+                more = 1;
+                break;
+
+            case S_COLON:
+                if ( ReadChar( ctx ) == '=' )  token.code = ASSIGNMENT;
+                else  {
+                    token.code = ERROR;
+                    UnReadChar( ctx );
+                }
+                break;
+
+            case S_LESS:
+                if ( ReadChar( ctx ) == '=' )  token.code = LESSEQUAL;
+                else  {
+                    token.code = LESS;
+                    UnReadChar( ctx );
+                }
+                break;
+
+            case S_GREATER:
+                if ( ReadChar( ctx ) == '=' )  token.code = GREATEREQUAL;
+                else  {
+                    token.code = GREATER;
+                    UnReadChar( ctx );
+                }
+                break;
+
+            case S_INTCONST:
+                ch = ReadChar( ctx );
+                if ( isdigit( ch ) )  {
+                    value = 10 * value + ( ch - '0' );
+                    more = 1;
+                }
+                else  {
+                    token.code = INTCONST;
+                    token.value = (int) value;
+                    UnReadChar( ctx );
+                }
+                break;
+
+            case S_IDENTIFIER:
+                ch = ReadChar( ctx );
+                if ( isalnum( ch ) )  {
+                    AddChar( ctx, ch );
+                    length++;
+                    more = 1;
+                }
+                else  {
+                    token.code = IDENTIFIER;
+                    UnReadChar( ctx );
+                }
+                break;
+
+            case S_ILLEGALCHAR:
+                token.code = ILLEGALCHAR;
+                break;
+
+            default:
+                fprintf( stderr, "Error, GetToken, invalid state %d\n", state );
+                exit( EXIT_FAILURE );
+        }
+    }
+
+    if ( token.code == IDENTIFIER )  {
+        AddChar( ctx, '\0' );
+        token.s = GetString( ctx );
+        if ( IDENTIFIER != ( token.code = LookupKeyword( token.s, length ) ) )
+            token.s = NULL;
+        else if ( ctx->skipto != NULL && !InSet( ctx->skipto, IDENTIFIER ) )
+            token.s = NULL;                     /* skipped by GetTokenIn     */
+        else  token.s = AtomName( ctx, token.atom = InternString( ctx ) );
+    }
+    return token;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetTokenIn: read tokens until one is in "set" or is ENDOFINPUT, put  */
+/*      that one in "token", as GetToken returns it, and return how many     */
+/*      were read before it.  While it runs, "set" is in the "skipto" field  */
+/*      of the CONTEXT, and GetToken does not enter identifiers in the       */
+/*      string table unless the set holds IDENTIFIER, so error recovery can  */
+/*      pass over a stretch of source for little more than reading it.       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC long GetTokenIn( CONTEXT *ctx, SET *set, TOKEN *token )
+{
+    long skipped = 0;
+
+    ctx->skipto = set;
+    for ( *token = GetToken( ctx ); !InSet( set, token->code ) && token->code != ENDOFINPUT; skipped++ )
+        *token = GetToken( ctx );
+    ctx->skipto = NULL;
+    return skipped;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      LookupKeyword: return the TOKEN code of the reserved word "s" (of    */
+/*      "length" characters), or IDENTIFIER if it is not reserved.  The      */
+/*      switch is keyed on length and then first character, which between    */
+/*      them leave at most two candidate keywords to confirm.                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int LookupKeyword( char *s, int length )
+{
+    switch ( length )  {
+        case 2:
+            switch ( s[0] )  {
+                case 'D':  if ( s[1] == 'O' )  return DO;                break;
+                case 'I':  if ( s[1] == 'F' )  return IF;                break;
+            }
+            break;
+        case 3:
+            switch ( s[0] )  {
+                case 'E':  if ( s[1] == 'N' && s[2] == 'D' )  return END;  break;
+                case 'R':  if ( s[1] == 'E' && s[2] == 'F' )  return REF;  break;
+                case 'V':  if ( s[1] == 'A' && s[2] == 'R' )  return VAR;  break;
+            }
+            break;
+        case 4:
+            switch ( s[0] )  {
+                case 'E':
+                    if ( s[1] == 'L' && s[2] == 'S' && s[3] == 'E' )  return ELSE;
+                    break;
+                case 'R':
+                    if ( s[1] == 'E' && s[2] == 'A' && s[3] == 'D' )  return READ;
+                    break;
+                case 'T':
+                    if ( s[1] == 'H' && s[2] == 'E' && s[3] == 'N' )  return THEN;
+                    break;
+            }
+            break;
+        case 5:
+            switch ( s[0] )  {
+                case 'B':
+                    if ( s[1] == 'E' && s[2] == 'G' && s[3] == 'I' && s[4] == 'N' )
+                        return BEGIN;
+                    break;
+                case 'W':
+                    if ( s[1] == 'H' && s[2] == 'I' && s[3] == 'L' && s[4] == 'E' )
+                        return WHILE;
+                    if ( s[1] == 'R' && s[2] == 'I' && s[3] == 'T' && s[4] == 'E' )
+                        return WRITE;
+                    break;
+            }
+            break;
+        case 7:
+            if ( s[0] == 'P' && s[1] == 'R' && s[2] == 'O' && s[3] == 'G' &&
+                 s[4] == 'R' && s[5] == 'A' && s[6] == 'M' )
+                return PROGRAM;
+            break;
+        case 9:
+            if ( s[0] == 'P' && s[1] == 'R' && s[2] == 'O' && s[3] == 'C' &&
+                 s[4] == 'E' && s[5] == 'D' && s[6] == 'U' && s[7] == 'R' &&
+                 s[8] == 'E' )
+                return PROCEDURE;
+            break;
+    }
+    return IDENTIFIER;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      SyntaxError: report that "Expected" was wanted but "CurrentToken"    */
+/*      was found.                                                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void SyntaxError( CONTEXT *ctx, int Expected, TOKEN CurrentToken )
+{
+    char s[MAX_ERRMSG_LEN+2];
+
+    snprintf( s, sizeof( s ), "Syntax: Expected %s, got %s\n",
+              Tokens[Expected], Tokens[CurrentToken.code] );
+    Error( ctx, s, CurrentToken.pos );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      SyntaxError2: as SyntaxError, but for a SET of expected tokens.      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void SyntaxError2( CONTEXT *ctx, SET Expected, TOKEN CurrentToken )
+{
+    char s[2*MAX_ERRMSG_LEN+2];
+    int i, len, n, limit;
+
+    len = snprintf( s, sizeof( s ), "Syntax: Expected one of: " );
+    limit = 2*MAX_ERRMSG_LEN - (int) strlen( Tokens[CurrentToken.code] ) - 8;
+    for ( i = 0; i <= MAX_TOKEN_CODE; i++ )  {
+        if ( InSet( &Expected, i ) )  {
+            n = (int) strlen( Tokens[i] ) + 1;
+            if ( len + n > limit )  break;
+            snprintf( s + len, sizeof( s ) - len, "%s ", Tokens[i] );
+            len += n;
+        }
+    }
+    snprintf( s + len, sizeof( s ) - len, ": got %s\n", Tokens[CurrentToken.code] );
+    Error( ctx, s, CurrentToken.pos );
+}
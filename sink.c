@@ -0,0 +1,229 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      sink.c                                                               */
+/*                                                                           */
+/*      Output sinks for the CPL compiler.  A file sink writes straight      */
+/*      through to its FILE.  A buffer sink keeps everything written to it   */
+/*      in one block that doubles as needed, so a whole compilation can be   */
+/*      done in memory.  A writer sink collects its output in a block of     */
+/*      SINK_BLOCK_SIZE bytes and passes it on to the caller's routine each  */
+/*      time the block fills and when it is flushed.                         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include "global.h"
+#include "sink.h"
+
+#define  SINK_FORMAT_SIZE     1024      /* longest output of one SinkPrintf  */
+#define  SINK_BUFFER_INIT     4096      /* first block of a buffer sink      */
+
+PRIVATE void Reserve( SINK *sink, size_t length );
+PRIVATE int  PassOn( SINK *sink );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      InitFileSink / InitBufferSink / InitWriterSink: set up "sink" to     */
+/*      write to "file", to collect its output in memory (see                */
+/*      "TakeSinkBuffer"), or to hand its output to "writer" along with      */
+/*      "arg".  A file sink neither flushes nor closes its FILE.             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void InitFileSink( SINK *sink, FILE *file )
+{
+    memset( sink, 0, sizeof( SINK ) );
+    sink->File = file;
+}
+
+PUBLIC void InitBufferSink( SINK *sink )
+{
+    memset( sink, 0, sizeof( SINK ) );
+}
+
+PUBLIC void InitWriterSink( SINK *sink, SINKWRITER writer, void *arg )
+{
+    memset( sink, 0, sizeof( SINK ) );
+    sink->Writer = writer;
+    sink->Arg = arg;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      SinkWrite / SinkPutc / SinkPrintf: write "length" bytes of "data",   */
+/*      one character, or the result of formatting the arguments as          */
+/*      printf would, to "sink".  SinkPrintf writes at most                  */
+/*      SINK_FORMAT_SIZE - 1 characters to a buffer or writer sink.          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void SinkWrite( SINK *sink, const char *data, size_t length )
+{
+    size_t n;
+
+    sink->Written += (long) length;
+    if ( sink->File != NULL )  {
+        if ( length != fwrite( data, 1, length, sink->File ) )  sink->Failed = 1;
+    }
+    else if ( sink->Writer != NULL )  {
+        while ( length > 0 )  {
+            if ( sink->Length == SINK_BLOCK_SIZE && !PassOn( sink ) )  return;
+            Reserve( sink, SINK_BLOCK_SIZE );
+            n = SINK_BLOCK_SIZE - sink->Length;
+            if ( n > length )  n = length;
+            memcpy( sink->Buffer + sink->Length, data, n );
+            sink->Length += n;
+            data += n;
+            length -= n;
+        }
+    }
+    else  {
+        Reserve( sink, sink->Length + length );
+        memcpy( sink->Buffer + sink->Length, data, length );
+        sink->Length += length;
+    }
+}
+
+PUBLIC void SinkPutc( SINK *sink, int ch )
+{
+    char c = (char) ch;
+
+    if ( sink->File != NULL )  {
+        sink->Written++;
+        if ( EOF == putc( ch, sink->File ) )  sink->Failed = 1;
+    }
+    else if ( sink->Length < sink->Capacity )  {
+        sink->Written++;
+        sink->Buffer[sink->Length++] = c;
+    }
+    else  SinkWrite( sink, &c, 1 );
+}
+
+PUBLIC void SinkPrintf( SINK *sink, const char *format, ... )
+{
+    char text[SINK_FORMAT_SIZE];
+    va_list args;
+    int n;
+
+    va_start( args, format );
+    if ( sink->File != NULL )  {
+        if ( ( n = vfprintf( sink->File, format, args ) ) < 0 )  sink->Failed = 1;
+        else  sink->Written += n;
+    }
+    else if ( ( n = vsnprintf( text, sizeof( text ), format, args ) ) < 0 )  sink->Failed = 1;
+    else  SinkWrite( sink, text, (size_t) n < sizeof( text ) ? (size_t) n : sizeof( text ) - 1 );
+    va_end( args );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      FlushSink: pass on any output a writer sink is holding, or flush a   */
+/*      file sink's FILE.  Returns 0 if any output has been lost.            */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int FlushSink( SINK *sink )
+{
+    if ( sink->File != NULL )  {
+        if ( 0 != fflush( sink->File ) )  sink->Failed = 1;
+    }
+    else if ( sink->Writer != NULL && sink->Length > 0 )  PassOn( sink );
+    return !sink->Failed;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      RewindSink: discard everything written to "sink" so far, so that it  */
+/*      can be written again from the start.  A file sink's file is          */
+/*      truncated, which is not possible for pipes and terminals, and a      */
+/*      writer sink can only drop what it has not yet passed on.  Returns 0  */
+/*      if some of the output could not be discarded.                        */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int RewindSink( SINK *sink )
+{
+    int ok = 1;
+
+    if ( sink->File != NULL )  {
+        if ( 0 == fflush( sink->File ) && 0 == ftruncate( fileno( sink->File ), 0 ) )
+            rewind( sink->File );
+        else  ok = 0;
+    }
+    else if ( sink->Writer != NULL && sink->Written > (long) sink->Length )  ok = 0;
+    sink->Length = 0;
+    sink->Written = 0;
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      TakeSinkBuffer: the output collected by a buffer sink, which the     */
+/*      caller must free, and its length.  The buffer is always followed by  */
+/*      a '\0' that is not counted in "length".  The sink is left empty.     */
+/*      Returns NULL if the sink is not a buffer sink.                       */
+/*                                                                           */
+/*      FreeSink: release whatever memory "sink" holds.  A writer sink       */
+/*      should be flushed first.                                             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC char *TakeSinkBuffer( SINK *sink, size_t *length )
+{
+    char *buffer;
+
+    if ( sink->File != NULL || sink->Writer != NULL )  return NULL;
+    Reserve( sink, sink->Length + 1 );
+    sink->Buffer[sink->Length] = '\0';
+    buffer = sink->Buffer;
+    *length = sink->Length;
+    sink->Buffer = NULL;
+    sink->Length = sink->Capacity = 0;
+    return buffer;
+}
+
+PUBLIC void FreeSink( SINK *sink )
+{
+    free( sink->Buffer );
+    sink->Buffer = NULL;
+    sink->Length = sink->Capacity = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  Make room for at least "length" bytes in the sink's buffer.              */
+
+PRIVATE void Reserve( SINK *sink, size_t length )
+{
+    size_t capacity = sink->Capacity == 0 ? SINK_BUFFER_INIT : sink->Capacity;
+    char *buffer;
+
+    if ( length <= sink->Capacity )  return;
+    while ( capacity < length )  capacity *= 2;
+    if ( NULL == ( buffer = realloc( sink->Buffer, capacity ) ) )  {
+        fprintf( stderr, "Fatal Error: SinkWrite: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    sink->Buffer = buffer;
+    sink->Capacity = capacity;
+}
+
+/*  Hand a writer sink's block to its routine and empty it.                  */
+
+PRIVATE int PassOn( SINK *sink )
+{
+    if ( sink->Writer( sink->Arg, sink->Buffer, sink->Length ) != sink->Length )
+        sink->Failed = 1;
+    sink->Length = 0;
+    return !sink->Failed;
+}
@@ -0,0 +1,372 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      split.c                                                              */
+/*                                                                           */
+/*      Cutting a source into parts that can be parsed at the same time      */
+/*      (see "split.h"), and a small pool of threads to parse them.  The     */
+/*      pre-scan reads the tokens much as "GetToken" does, but without       */
+/*      the listing, the string table or any CONTEXT, and follows only       */
+/*      enough of the grammar to see where each outer procedure begins and   */
+/*      ends: PROCEDURE and BEGIN ... END nest, and a procedure is over when */
+/*      the END of its own block brings the nesting back to where it began.  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "global.h"
+#include "scanner.h"
+#include "split.h"
+
+#define  MAX_THREADS  256           /* upper limit on the pool size          */
+
+typedef struct  {                   /* the pre-scan's place in the source    */
+    const char *Next;               /* first byte not yet scanned            */
+    const char *End;
+    const char *Token;              /* start of the token just scanned       */
+    int        Line;                /* number of the line it is on           */
+}
+    PRESCAN;
+
+typedef struct  {                   /* an outer procedure                    */
+    const char *Start;              /* start of its line, NULL unless the    */
+    int        Line;                /* PROCEDURE is the first token on it    */
+    const char *Name;
+    int        NameLength;
+    int        Variables;           /* VAR and REF names declared in it      */
+}
+    OUTER;
+
+typedef struct  {
+    SOURCESPLIT     *Split;
+    PARTPARSER      Parse;
+    pthread_mutex_t Lock;           /* guards Next                           */
+    int             Next;           /* next part to be parsed                */
+}
+    PARTPOOL;
+
+PRIVATE int    Scan( PRESCAN *scan );
+PRIVATE const char *LineStart( PRESCAN *scan, const char *source );
+PRIVATE void   MakeParts( SOURCESPLIT *split, OUTER *outer, int count, const char *source,
+                          const char *block, int blockline, const char *end, int threads );
+PRIVATE void   CopyNames( SOURCESPLIT *split, OUTER *outer, int count );
+PRIVATE void   *Work( void *arg );
+PRIVATE void   *Allocate( size_t size );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      SplitSource: cut the "length" bytes of source at "source" into       */
+/*      parts for "threads" threads, filling in "split".  Returns 0, with    */
+/*      "split" empty, if the source is not worth splitting or cannot be     */
+/*      split: it is short, has fewer than two outer procedures that start   */
+/*      lines of their own, or does not nest as the grammar says.  A source  */
+/*      with errors in it may still be split; the parse of its parts will    */
+/*      find them.  The caller must see first that it has no line the        */
+/*      listing would have to break ("LongLines" in "line.h"), as that       */
+/*      numbers the lines differently.                                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int SplitSource( const char *source, size_t length, int threads, SOURCESPLIT *split )
+{
+    PRESCAN scan;
+    OUTER *outer = NULL, *op = NULL;
+    const char *block = NULL;
+    int capacity = 0, count = 0, level = 0, blocks = 0, blockline = 0;
+    int naming = 0, params = 0, ref = 0, vars = 0, ok = 1, splits = 0, code, i;
+
+    memset( split, 0, sizeof( SOURCESPLIT ) );
+    if ( threads < 2 || length < SPLIT_MIN_SOURCE )  return 0;
+
+    scan.Next = source;
+    scan.End = source + length;
+    scan.Line = 1;
+    while ( ok && ( block == NULL || blocks > 0 ) && ENDOFINPUT != ( code = Scan( &scan ) ) )  {
+        if ( naming == 2 && code != LEFTPARENTHESIS )  naming = 0;
+        switch ( code )  {
+            case PROCEDURE:
+                if ( blocks > 0 || block != NULL )  ok = 0;
+                else if ( level++ == 0 )  {
+                    if ( count == capacity )  {
+                        capacity = capacity == 0 ? 64 : 2 * capacity;
+                        if ( NULL == ( op = realloc( outer, capacity * sizeof( OUTER ) ) ) )  {
+                            fprintf( stderr, "Fatal Error: SplitSource: out of memory\n" );
+                            exit( EXIT_FAILURE );
+                        }
+                        outer = op;
+                    }
+                    op = &outer[count++];
+                    op->Start = LineStart( &scan, source );
+                    op->Line = scan.Line;
+                    op->Name = NULL;
+                    op->NameLength = 0;
+                    op->Variables = 0;
+                }
+                naming = 1;
+                break;
+            case IDENTIFIER:
+                if ( naming == 1 )  {
+                    if ( level == 1 )  {
+                        op->Name = scan.Token;
+                        op->NameLength = (int) ( scan.Next - scan.Token );
+                    }
+                    naming = 2;
+                }
+                else if ( level > 0 && ( vars || ( params && ref ) ) )  op->Variables++;
+                ref = 0;
+                break;
+            case LEFTPARENTHESIS:
+                if ( naming == 2 )  params = 1;
+                naming = 0;
+                break;
+            case REF:
+                ref = params;
+                break;
+            case RIGHTPARENTHESIS:
+                params = ref = 0;
+                break;
+            case VAR:
+                vars = 1;
+                break;
+            case SEMICOLON:
+                vars = 0;
+                break;
+            case BEGIN:
+                if ( blocks++ == 0 && level == 0 )  {
+                    block = LineStart( &scan, source );
+                    blockline = scan.Line;
+                    if ( block == NULL )  ok = 0;
+                }
+                break;
+            case END:
+                if ( blocks == 0 )  ok = 0;
+                else if ( --blocks == 0 && level > 0 )  level--;
+                break;
+        }
+    }
+
+    for ( i = 0; i < count; i++ )  {
+        if ( outer[i].Name == NULL )  ok = 0;
+        if ( i > 0 && outer[i].Start != NULL )  splits++;
+    }
+    if ( ok && block != NULL && splits > 0 )  {
+        CopyNames( split, outer, count );
+        MakeParts( split, outer, count, source, block, blockline, source + length, threads );
+    }
+    free( outer );
+    return split->Count > 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ParseParts: call "parse" for each of the parts of "split" from       */
+/*      "first" on, on a pool of (at most) "threads" threads, the calling    */
+/*      thread among them.  The parts are handed out in order, one at a      */
+/*      time, so a thread that draws short parts takes more of them.         */
+/*      Returns when all have been parsed.                                   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void ParseParts( SOURCESPLIT *split, int first, int threads, PARTPARSER parse )
+{
+    PARTPOOL pool;
+    pthread_t *workers;
+    int *started, i;
+
+    if ( threads > split->Count - first )  threads = split->Count - first;
+    if ( threads < 1 )  return;
+    pool.Split = split;
+    pool.Parse = parse;
+    pool.Next = first;
+    pthread_mutex_init( &pool.Lock, NULL );
+    workers = Allocate( threads * sizeof( pthread_t ) );
+    started = Allocate( threads * sizeof( int ) );
+    for ( i = 1; i < threads; i++ )
+        started[i] = 0 == pthread_create( &workers[i], NULL, Work, &pool );
+    Work( &pool );
+    for ( i = 1; i < threads; i++ )
+        if ( started[i] )  pthread_join( workers[i], NULL );
+    pthread_mutex_destroy( &pool.Lock );
+    free( workers );
+    free( started );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ThreadCount: "threads", or one per online core if it is less than    */
+/*      one, no more than MAX_THREADS either way.                            */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int ThreadCount( int threads )
+{
+    long n = threads;
+
+    if ( n < 1 && ( n = sysconf( _SC_NPROCESSORS_ONLN ) ) < 1 )  n = 1;
+    return n > MAX_THREADS ? MAX_THREADS : (int) n;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      FreeSplit: release what SplitSource allocated (but not the State     */
+/*      of the parts, which is the caller's).                                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void FreeSplit( SOURCESPLIT *split )
+{
+    free( split->Parts );
+    free( split->Names );
+    free( split->NameStore );
+    memset( split, 0, sizeof( SOURCESPLIT ) );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  The code of the next token, as GetToken would read it, with "Token"      */
+/*  left at its start and "Next" just after it.  Only the codes the          */
+/*  pre-scan needs are told apart; the other tokens are all ERROR.           */
+
+PRIVATE int Scan( PRESCAN *scan )
+{
+    const char *p = scan->Next, *end = scan->End;
+    int code = ERROR;
+
+    for ( ;; )  {
+        while ( p < end && isspace( (unsigned char) *p ) )
+            if ( *p++ == '\n' )  scan->Line++;
+        if ( p == end || *p != '!' )  break;
+        while ( p < end && *p != '\n' )  p++;
+    }
+    scan->Token = p;
+    if ( p == end )  code = ENDOFINPUT;
+    else if ( isalpha( (unsigned char) *p ) )  {
+        while ( ++p < end && isalnum( (unsigned char) *p ) )
+            ;
+        code = LookupKeyword( (char *) scan->Token, (int) ( p - scan->Token ) );
+    }
+    else if ( isdigit( (unsigned char) *p ) )  {
+        while ( ++p < end && isdigit( (unsigned char) *p ) )
+            ;
+        code = INTCONST;
+    }
+    else  {
+        switch ( *p++ )  {
+            case ';':  code = SEMICOLON;         break;
+            case '(':  code = LEFTPARENTHESIS;   break;
+            case ')':  code = RIGHTPARENTHESIS;  break;
+        }
+    }
+    scan->Next = p;
+    return code;
+}
+
+/*  The start of the line the token just scanned is on, or NULL if it is     */
+/*  not the first token on that line.                                        */
+
+PRIVATE const char *LineStart( PRESCAN *scan, const char *source )
+{
+    const char *p;
+
+    for ( p = scan->Token; p > source && p[-1] != '\n'; p-- )
+        if ( !isspace( (unsigned char) p[-1] ) )  return NULL;
+    return p;
+}
+
+/*  Part 0 ends where the second outer procedure that can start a part       */
+/*  begins; the rest are cut, where procedures allow, into runs of about     */
+/*  equal size, SPLIT_PARTS_THREAD of them per thread; the block is last.    */
+
+PRIVATE void MakeParts( SOURCESPLIT *split, OUTER *outer, int count, const char *source,
+                        const char *block, int blockline, const char *end, int threads )
+{
+    SOURCEPART *part;
+    size_t target;
+    int i;
+
+    split->Parts = Allocate( ( count + 1 ) * sizeof( SOURCEPART ) );
+    part = split->Parts;
+    part->Start = source;
+    part->FirstLine = 1;
+    part->FirstProcedure = 0;
+    part->Procedures = part->Variables = 0;
+    for ( i = 1; i < count && outer[i].Start == NULL; i++ )
+        ;
+    target = (size_t) ( block - outer[i].Start ) / ( (size_t) threads * SPLIT_PARTS_THREAD ) + 1;
+    for ( i = 0; i < count; i++ )  {
+        if ( i > 0 && outer[i].Start != NULL &&
+             ( part == split->Parts || (size_t) ( outer[i].Start - part->Start ) >= target ) )  {
+            part->Length = outer[i].Start - part->Start;
+            part++;
+            part->Start = outer[i].Start;
+            part->FirstLine = outer[i].Line;
+            part->FirstProcedure = i;
+            part->Procedures = part->Variables = 0;
+        }
+        part->Procedures++;
+        part->Variables += outer[i].Variables;
+    }
+    part->Length = block - part->Start;
+    part++;
+    part->Start = block;
+    part->Length = end - block;
+    part->FirstLine = blockline;
+    part->FirstProcedure = count;
+    part->Procedures = part->Variables = 0;
+    split->Count = (int) ( part - split->Parts ) + 1;
+    for ( i = 0; i < split->Count; i++ )  split->Parts[i].State = NULL;
+}
+
+PRIVATE void CopyNames( SOURCESPLIT *split, OUTER *outer, int count )
+{
+    char *p;
+    size_t size = 0;
+    int i;
+
+    for ( i = 0; i < count; i++ )  size += outer[i].NameLength + 1;
+    split->Names = Allocate( count * sizeof( char * ) );
+    split->NameStore = p = Allocate( size );
+    split->Procedures = count;
+    for ( i = 0; i < count; i++ )  {
+        split->Names[i] = p;
+        memcpy( p, outer[i].Name, outer[i].NameLength );
+        p += outer[i].NameLength;
+        *p++ = '\0';
+    }
+}
+
+PRIVATE void *Work( void *arg )
+{
+    PARTPOOL *pool = arg;
+    int part;
+
+    for ( ;; )  {
+        pthread_mutex_lock( &pool->Lock );
+        part = pool->Next < pool->Split->Count ? pool->Next++ : -1;
+        pthread_mutex_unlock( &pool->Lock );
+        if ( part < 0 )  break;
+        pool->Parse( pool->Split, part );
+    }
+    return NULL;
+}
+
+PRIVATE void *Allocate( size_t size )
+{
+    void *p;
+
+    if ( NULL == ( p = malloc( size ) ) )  {
+        fprintf( stderr, "Fatal Error: SplitSource: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    return p;
+}
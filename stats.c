@@ -0,0 +1,285 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      stats.c                                                              */
+/*                                                                           */
+/*      Phase timings and counters for one compilation (see "stats.h").      */
+/*      Reading a CPU clock costs several hundred nanoseconds, far more      */
+/*      than scanning a token, so the phases are not timed one by one: an    */
+/*      ITIMER_PROF and an ITIMER_REAL timer interrupt the compilation       */
+/*      every SAMPLE_INTERVAL of CPU and of wall time, and each interrupt    */
+/*      counts a sample against the phase the CONTEXT is in at that moment.  */
+/*      A compilation that takes only a few intervals gets few samples, so   */
+/*      its phase shares are rough (and absent if it gets none), but its     */
+/*      totals and counters are exact.                                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _XOPEN_SOURCE  600
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "global.h"
+#include "stats.h"
+#include "context.h"
+
+PRIVATE char *PhaseNames[PHASES] =  {
+    "other", "scanning", "parsing", "symbol operations", "code writing",
+    "error recovery"
+};
+
+PRIVATE char *PhaseKeys[PHASES] =  {          /* the same, in the JSON       */
+    "other", "scan", "parse", "symbols", "write", "recover"
+};
+
+PRIVATE CONTEXT      *volatile Sampled = NULL;     /* being measured, and    */
+PRIVATE COMPILESTATS *volatile Samples = NULL;     /* where the samples go   */
+PRIVATE struct sigaction OldProf, OldAlarm;
+
+PRIVATE void   Sample( int sig );
+PRIVATE void   SetTimers( long usec );
+PRIVATE double Now( clockid_t clock );
+PRIVATE void   Share( double total, long samples[], double shares[] );
+PRIVATE void   Column( FILE *fp, double t, double total, long samples );
+PRIVATE void   JSONString( FILE *fp, char *s );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      StartStats: begin measuring the compilation about to be run in       */
+/*      "ctx", into "stats".  Installs handlers for SIGPROF and SIGALRM and  */
+/*      starts the two sampling timers; the caller must not use them until   */
+/*      StopStats.  The token, recovery and skip counts of "ctx" are         */
+/*      cleared.                                                             */
+/*                                                                           */
+/*      StopStats: stop the timers, put back the old handlers, and fill in   */
+/*      "stats" with the times and with the counters of the modules of       */
+/*      "ctx".  Call it before the listing sink goes away.                   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void StartStats( CONTEXT *ctx, COMPILESTATS *stats )
+{
+    struct sigaction sample;
+
+    memset( stats, 0, sizeof( COMPILESTATS ) );
+    ctx->tokens = 0;
+    ctx->recoveries = 0;
+    ctx->skipped = 0;
+    ctx->phase = PHASE_OTHER;
+    Samples = stats;
+    Sampled = ctx;
+
+    sample.sa_handler = Sample;
+    sigemptyset( &sample.sa_mask );
+    sample.sa_flags = SA_RESTART;           /* the compiler's I/O carries on */
+    sigaction( SIGPROF, &sample, &OldProf );
+    sigaction( SIGALRM, &sample, &OldAlarm );
+
+    stats->Wall = -Now( CLOCK_MONOTONIC );  /* StopStats adds the end times  */
+    stats->Cpu = -Now( CLOCK_PROCESS_CPUTIME_ID );
+    SetTimers( SAMPLE_INTERVAL );
+}
+
+PUBLIC void StopStats( CONTEXT *ctx, COMPILESTATS *stats )
+{
+    struct rusage usage;
+
+    SetTimers( 0L );
+    stats->Wall += Now( CLOCK_MONOTONIC );
+    stats->Cpu += Now( CLOCK_PROCESS_CPUTIME_ID );
+    sigaction( SIGPROF, &OldProf, NULL );
+    sigaction( SIGALRM, &OldAlarm, NULL );
+    Sampled = NULL;
+    Samples = NULL;
+
+    Share( stats->Wall, stats->WallSamples, stats->PhaseWall );
+    Share( stats->Cpu, stats->CpuSamples, stats->PhaseCpu );
+    if ( 0 == getrusage( RUSAGE_SELF, &usage ) )  stats->PeakRSS = usage.ru_maxrss;
+    stats->Valid = ctx->ErrorFlag == 0;
+    stats->Tokens = ctx->tokens;
+    stats->Recoveries = ctx->recoveries;
+    stats->Skipped = ctx->skipped;
+    GetLineStats( ctx, &stats->Source );
+    GetAtomStats( ctx, &stats->Atoms );
+    GetSymbolStats( ctx, &stats->Symbols );
+    GetCodeStats( ctx, &stats->Code );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ReportStats: write "stats", for the source file "name", to "fp" as   */
+/*      a table for people to read.                                          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void ReportStats( COMPILESTATS *stats, char *name, FILE *fp )
+{
+    long wallsamples = 0, cpusamples = 0;
+    double seconds = stats->Wall > 0.0 ? stats->Wall : 1.0;
+    long lookups = stats->Atoms.Lookups > 0 ? stats->Atoms.Lookups : 1;
+    int p;
+
+    for ( p = 0; p < PHASES; p++ )  {
+        wallsamples += stats->WallSamples[p];
+        cpusamples += stats->CpuSamples[p];
+    }
+    fprintf( fp, "Statistics for \"%s\" (%s):\n", name, stats->Valid ? "valid" : "invalid" );
+    fprintf( fp, "  %-20s %10s %7s %10s %7s\n", "phase", "wall ms", "share", "cpu ms", "share" );
+    for ( p = PHASE_SCAN; p < PHASES + PHASE_SCAN; p++ )  {
+        fprintf( fp, "  %-20s", PhaseNames[p % PHASES] );
+        Column( fp, stats->PhaseWall[p % PHASES], stats->Wall, wallsamples );
+        Column( fp, stats->PhaseCpu[p % PHASES], stats->Cpu, cpusamples );
+        fputc( '\n', fp );
+    }
+    fprintf( fp, "  %-20s %10.3f %7s %10.3f %7s\n", "total", 1000.0 * stats->Wall, "",
+             1000.0 * stats->Cpu, "" );
+    fprintf( fp, "  %-20s %ld wall and %ld cpu samples, every %d us\n", "sampled",
+             wallsamples, cpusamples, SAMPLE_INTERVAL );
+    fprintf( fp, "  %-20s %ld lines, %ld bytes read (%.0f lines/sec)\n", "source",
+             stats->Source.Lines, stats->Source.BytesRead, stats->Source.Lines / seconds );
+    fprintf( fp, "  %-20s %ld bytes of listing, %ld bytes of code\n", "written",
+             stats->Source.ListingBytes, stats->Code.Bytes );
+    fprintf( fp, "  %-20s %ld KB\n", "peak RSS", stats->PeakRSS );
+    fprintf( fp, "  %-20s %ld (%.0f tokens/sec)\n", "tokens", stats->Tokens,
+             stats->Tokens / seconds );
+    fprintf( fp, "  %-20s %d atoms, %ld lookups\n", "names", stats->Atoms.Atoms,
+             stats->Atoms.Lookups );
+    fprintf( fp, "  %-20s %.2f slots a lookup (%ld at most), %ld name compares\n", "atom probes",
+             (double) stats->Atoms.Steps / lookups, stats->Atoms.MaxSteps, stats->Atoms.Compares );
+    fprintf( fp, "  %-20s %ld probes (%ld misses), %ld entered, deepest shadowing %d\n", "symbols",
+             stats->Symbols.Probes, stats->Symbols.Misses, stats->Symbols.Entered,
+             stats->Symbols.LongestChain );
+    fprintf( fp, "  %-20s %ld calls, %ld symbols removed\n", "RemoveSymbols",
+             stats->Symbols.Removals, stats->Symbols.Removed );
+    fprintf( fp, "  %-20s %ld emitted, %ld written, %ld back-patches\n", "instructions",
+             stats->Code.Emitted, stats->Code.Written, stats->Code.BackPatches );
+    fprintf( fp, "  %-20s %ld bytes at the peak\n", "code memory", stats->Code.MemoryPeak );
+    fprintf( fp, "  %-20s %ld bytes at the peak, %ld allocated in all\n", "symbol memory",
+             stats->Symbols.Memory.Peak, stats->Symbols.Memory.Bytes );
+    fprintf( fp, "  %-20s %ld bytes at the peak, %ld allocated in all\n", "string memory",
+             stats->Atoms.Memory.Peak, stats->Atoms.Memory.Bytes );
+    fprintf( fp, "  %-20s %ld, %ld tokens skipped", "recoveries", stats->Recoveries, stats->Skipped );
+    if ( stats->PhaseCpu[PHASE_RECOVER] > 0.0 )
+        fprintf( fp, " (%.0f tokens/sec)", stats->Skipped / stats->PhaseCpu[PHASE_RECOVER] );
+    fputc( '\n', fp );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      WriteStatsJSON: write "stats", for the source file "name", to "fp"   */
+/*      as one JSON object on one line, so a file of them, one per run, can  */
+/*      be read a line at a time.  Times are in seconds.                     */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void WriteStatsJSON( COMPILESTATS *stats, char *name, FILE *fp )
+{
+    long lookups = stats->Atoms.Lookups > 0 ? stats->Atoms.Lookups : 1;
+    int p;
+
+    fprintf( fp, "{\"file\":" );
+    JSONString( fp, name );
+    fprintf( fp, ",\"valid\":%s,\"wall_seconds\":%.6f,\"cpu_seconds\":%.6f",
+             stats->Valid ? "true" : "false", stats->Wall, stats->Cpu );
+    fprintf( fp, ",\"peak_rss_kb\":%ld,\"sample_interval_us\":%d,\"phases\":{",
+             stats->PeakRSS, SAMPLE_INTERVAL );
+    for ( p = 0; p < PHASES; p++ )  {
+        fprintf( fp, "%s\"%s\":{\"wall_seconds\":%.6f,\"cpu_seconds\":%.6f,", p > 0 ? "," : "",
+                 PhaseKeys[p], stats->PhaseWall[p], stats->PhaseCpu[p] );
+        fprintf( fp, "\"wall_samples\":%ld,\"cpu_samples\":%ld}",
+                 stats->WallSamples[p], stats->CpuSamples[p] );
+    }
+    fprintf( fp, "},\"counters\":{\"lines\":%ld,\"bytes_read\":%ld,\"listing_bytes\":%ld,",
+             stats->Source.Lines, stats->Source.BytesRead, stats->Source.ListingBytes );
+    fprintf( fp, "\"code_bytes\":%ld,\"tokens\":%ld,\"atoms\":%d,\"atom_lookups\":%ld,",
+             stats->Code.Bytes, stats->Tokens, stats->Atoms.Atoms, stats->Atoms.Lookups );
+    fprintf( fp, "\"atom_probe_steps\":%ld,\"atom_probe_steps_mean\":%.3f,\"atom_probe_steps_max\":%ld,",
+             stats->Atoms.Steps, (double) stats->Atoms.Steps / lookups, stats->Atoms.MaxSteps );
+    fprintf( fp, "\"atom_compares\":%ld,", stats->Atoms.Compares );
+    fprintf( fp, "\"probes\":%ld,\"probe_misses\":%ld,\"symbols_entered\":%ld,",
+             stats->Symbols.Probes, stats->Symbols.Misses, stats->Symbols.Entered );
+    fprintf( fp, "\"shadowing_depth\":%d,\"remove_symbols_calls\":%ld,\"symbols_removed\":%ld,",
+             stats->Symbols.LongestChain, stats->Symbols.Removals, stats->Symbols.Removed );
+    fprintf( fp, "\"instructions_emitted\":%ld,\"instructions_written\":%ld,\"code_memory_peak\":%ld,",
+             stats->Code.Emitted, stats->Code.Written, stats->Code.MemoryPeak );
+    fprintf( fp, "\"symbol_memory_peak\":%ld,\"symbol_memory_bytes\":%ld,",
+             stats->Symbols.Memory.Peak, stats->Symbols.Memory.Bytes );
+    fprintf( fp, "\"string_memory_peak\":%ld,\"string_memory_bytes\":%ld,",
+             stats->Atoms.Memory.Peak, stats->Atoms.Memory.Bytes );
+    fprintf( fp, "\"backpatches\":%ld,\"recoveries\":%ld,\"tokens_skipped\":%ld}}\n",
+             stats->Code.BackPatches, stats->Recoveries, stats->Skipped );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  The signal handler: count a sample against the current phase.            */
+
+PRIVATE void Sample( int sig )
+{
+    CONTEXT *ctx = Sampled;
+    COMPILESTATS *stats = Samples;
+    int phase;
+
+    if ( ctx == NULL || stats == NULL )  return;
+    phase = ctx->phase;
+    if ( phase < 0 || phase >= PHASES )  phase = PHASE_OTHER;
+    if ( sig == SIGPROF )  stats->CpuSamples[phase]++;
+    else  stats->WallSamples[phase]++;
+}
+
+/*  Start both timers firing every "usec" microseconds, or stop them (0).    */
+
+PRIVATE void SetTimers( long usec )
+{
+    struct itimerval timer;
+
+    timer.it_interval.tv_sec = timer.it_value.tv_sec = usec / 1000000L;
+    timer.it_interval.tv_usec = timer.it_value.tv_usec = usec % 1000000L;
+    setitimer( ITIMER_PROF, &timer, NULL );
+    setitimer( ITIMER_REAL, &timer, NULL );
+}
+
+PRIVATE double Now( clockid_t clock )
+{
+    struct timespec t;
+
+    clock_gettime( clock, &t );
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*  Share "total" seconds out between the phases by their samples.           */
+
+PRIVATE void Share( double total, long samples[], double shares[] )
+{
+    long all = 0;
+    int p;
+
+    for ( p = 0; p < PHASES; p++ )  all += samples[p];
+    for ( p = 0; p < PHASES; p++ )  shares[p] = all > 0 ? total * samples[p] / all : 0.0;
+}
+
+/*  One time column of the table, blank if there were no samples.            */
+
+PRIVATE void Column( FILE *fp, double t, double total, long samples )
+{
+    if ( samples == 0 )  fprintf( fp, " %10s %7s", "-", "-" );
+    else  fprintf( fp, " %10.3f %6.1f%%", 1000.0 * t, total > 0.0 ? 100.0 * t / total : 0.0 );
+}
+
+PRIVATE void JSONString( FILE *fp, char *s )
+{
+    fputc( '"', fp );
+    for ( ; *s != '\0'; s++ )  {
+        if ( *s == '"' || *s == '\\' )  fprintf( fp, "\\%c", *s );
+        else if ( (unsigned char) *s < 0x20 )  fprintf( fp, "\\u%04x", (unsigned char) *s );
+        else  fputc( *s, fp );
+    }
+    fputc( '"', fp );
+}
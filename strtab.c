@@ -0,0 +1,396 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      strtab.c                                                             */
+/*                                                                           */
+/*      String table for the CPL compiler.  Strings are built one character  */
+/*      at a time at the top of the current chunk.  A string that is not     */
+/*      preserved is overwritten by the next one, so only identifiers that   */
+/*      make it into the symbol table use up space.  When a chunk fills, the */
+/*      string under construction is moved to a fresh chunk; older chunks    */
+/*      stay put because preserved strings in them are still referenced.     */
+/*      Chunks come from the table's arena (see arena.h), so they are all    */
+/*      released together by FreeStringTable.                                */
+/*                                                                           */
+/*      Identifiers are also interned: "InternString" gives each distinct    */
+/*      name a dense integer "atom", 0, 1, 2, ..., preserving the first copy */
+/*      of the name and reclaiming any later ones.  Atoms are found through  */
+/*      an open-addressed table of FNV-1a hashes, doubled whenever it gets   */
+/*      half full, so the scanner hashes each identifier once and everything */
+/*      after it can compare atoms instead of strings.                       */
+/*                                                                           */
+/*      The array of names is not reallocated in place: each new one keeps   */
+/*      the one it outgrew (in the word before its first name) until the     */
+/*      table is reset.  GrowAtoms fills a new array before it publishes it  */
+/*      with release ordering, and AtomName reads it with acquire ordering   */
+/*      (or both do so under a lock, without the GNU atomic builtins).  So   */
+/*      AtomName may be called on one thread while the scanner interns on    */
+/*      another (see "tokpipe.h"), for any atom that came to that thread     */
+/*      after it was interned: the atom's name is in every array since.      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "global.h"
+#include "strtab.h"
+#include "arena.h"
+#include "context.h"
+
+#define  STRTAB_CHUNK_SIZE     1024
+#define  ARENA_BLOCK_SIZE     65536     /* chunks are carved out of these    */
+#define  INITIAL_SLOTS          256     /* atom slots; always a power of two */
+#define  FNV_OFFSET_BASIS  2166136261UL
+#define  FNV_PRIME           16777619UL
+
+struct stringtable  {
+    ARENA *Arena;                       /* where the chunks come from        */
+    char  *TopOfTable;                  /* start of string being built       */
+    char  *InsertionPoint;              /* where its next character goes     */
+    int   SpaceLeftInChunk;
+    char  **Names;                      /* name of each atom                 */
+    unsigned long *Hashes;              /* and its hash                      */
+    int   *Slots;                       /* atom + 1 in each used slot        */
+    int   SlotCount;
+    int   AtomCount;
+    ATOMSTATS Stats;
+#if !defined( __GNUC__ )
+    pthread_mutex_t Lock;               /* for LoadNames and PublishNames    */
+#endif
+};
+
+PRIVATE char *AddChunk( STRINGTABLE *st, int size );
+PRIVATE unsigned long Hash( char *s );
+PRIVATE void GrowAtoms( STRINGTABLE *st );
+PRIVATE void FreeOldNames( STRINGTABLE *st );
+PRIVATE char **LoadNames( STRINGTABLE *st );
+PRIVATE void PublishNames( STRINGTABLE *st, char **names );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      MakeStringTable / FreeStringTable: create an empty string table,     */
+/*      and release one together with every string in it.                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC STRINGTABLE *MakeStringTable( void )
+{
+    STRINGTABLE *st;
+
+    if ( NULL == ( st = calloc( 1, sizeof( STRINGTABLE ) ) ) )  {
+        fprintf( stderr, "Error, \"MakeStringTable\", malloc failure\n" );
+        exit( EXIT_FAILURE );
+    }
+    st->Arena = MakeArena( ARENA_BLOCK_SIZE );
+#if !defined( __GNUC__ )
+    pthread_mutex_init( &st->Lock, NULL );
+#endif
+    return st;
+}
+
+PUBLIC void FreeStringTable( STRINGTABLE *st )
+{
+    if ( st != NULL )  {
+        FreeArena( st->Arena );
+        FreeOldNames( st );
+        if ( st->Names != NULL )  free( st->Names - 1 );
+        free( st->Hashes );
+        free( st->Slots );
+#if !defined( __GNUC__ )
+        pthread_mutex_destroy( &st->Lock );
+#endif
+        free( st );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ResetStringTable: empty a string table for another compilation,      */
+/*      keeping the memory it has already got to use again.                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void ResetStringTable( STRINGTABLE *st )
+{
+    ArenaRelease( st->Arena, NULL );
+    st->TopOfTable = st->InsertionPoint = NULL;
+    st->SpaceLeftInChunk = 0;
+    if ( st->Slots != NULL )  memset( st->Slots, 0, st->SlotCount * sizeof( int ) );
+    FreeOldNames( st );
+    st->AtomCount = 0;
+    memset( &st->Stats, 0, sizeof( st->Stats ) );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      NewString: start a new string, reclaiming the space used by the      */
+/*      previous one unless it was preserved.                                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void NewString( CONTEXT *ctx )
+{
+    STRINGTABLE *st = ctx->strtab;
+
+    if ( st->SpaceLeftInChunk <= 0 )  {
+        if ( NULL == ( st->TopOfTable = AddChunk( st, STRTAB_CHUNK_SIZE ) ) )  {
+            fprintf( stderr, "Error, \"NewString\", malloc failure\n" );
+            exit( EXIT_FAILURE );
+        }
+        st->SpaceLeftInChunk = STRTAB_CHUNK_SIZE;
+    }
+    else  st->SpaceLeftInChunk += (int) ( st->InsertionPoint - st->TopOfTable );
+    st->InsertionPoint = st->TopOfTable;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      AddChar: append a character to the string being built, moving it to  */
+/*      a new chunk first if the current one is (nearly) full.  A string     */
+/*      too long for a chunk gets one twice its length, so a very long       */
+/*      identifier is still copied only a few times.                         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void AddChar( CONTEXT *ctx, int ch )
+{
+    STRINGTABLE *st = ctx->strtab;
+    char *newtop, *p;
+    int size;
+
+    if ( st->SpaceLeftInChunk <= 1 )  {
+        size = 2 * (int) ( st->InsertionPoint - st->TopOfTable ) + 2;
+        if ( size < STRTAB_CHUNK_SIZE )  size = STRTAB_CHUNK_SIZE;
+        if ( NULL == ( p = newtop = AddChunk( st, size ) ) )  {
+            fprintf( stderr, "Error, \"AddChar\", malloc failure\n" );
+            exit( EXIT_FAILURE );
+        }
+        st->SpaceLeftInChunk = size;
+        while ( st->TopOfTable != st->InsertionPoint )  {
+            *p++ = *st->TopOfTable++;
+            st->SpaceLeftInChunk--;
+        }
+        st->TopOfTable = newtop;
+        st->InsertionPoint = p;
+    }
+    *st->InsertionPoint++ = (char) ( ch & 0x7f );
+    st->SpaceLeftInChunk--;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetString: the string being built.  It is only NUL-terminated if     */
+/*      the caller has added the '\0' with AddChar.                          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC char *GetString( CONTEXT *ctx )
+{
+    return ctx->strtab->TopOfTable;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      PreserveString: keep the string just built; the next NewString       */
+/*      starts after it instead of on top of it.                             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void PreserveString( CONTEXT *ctx )
+{
+    ctx->strtab->TopOfTable = ctx->strtab->InsertionPoint;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      InternString: the atom of the string just built, which the caller    */
+/*      must have NUL-terminated.  A new name is preserved and given the     */
+/*      next atom; a name seen before is left to be reclaimed by the next    */
+/*      NewString.  Only the first SIGNIFICANT_LENGTH characters count.      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int InternString( CONTEXT *ctx )
+{
+    STRINGTABLE *st = ctx->strtab;
+    char *s = st->TopOfTable;
+    unsigned long h = Hash( s );
+    long steps = 0;
+    int i, atom;
+
+    if ( 2 * ( st->AtomCount + 1 ) > st->SlotCount )  GrowAtoms( st );
+    for ( i = (int) ( h & ( st->SlotCount - 1 ) ); st->Slots[i] != 0;
+          i = ( i + 1 ) & ( st->SlotCount - 1 ) )  {
+        steps++;
+        atom = st->Slots[i] - 1;
+        if ( st->Hashes[atom] == h )  {
+            st->Stats.Compares++;
+            if ( 0 == strncmp( st->Names[atom], s, SIGNIFICANT_LENGTH ) )  break;
+        }
+    }
+    st->Stats.Lookups++;
+    st->Stats.Steps += steps;
+    if ( steps > st->Stats.MaxSteps )  st->Stats.MaxSteps = steps;
+    if ( st->Slots[i] != 0 )  return st->Slots[i] - 1;
+
+    atom = st->AtomCount++;
+    st->Names[atom] = s;
+    st->Hashes[atom] = h;
+    st->Slots[i] = atom + 1;
+    PreserveString( ctx );
+    return atom;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      InternName: intern a copy of "s", for names that do not come from    */
+/*      the scanner.  Starts a new string, so must not be called while one   */
+/*      is being built.                                                      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int InternName( CONTEXT *ctx, char *s )
+{
+    NewString( ctx );
+    while ( *s != '\0' )  AddChar( ctx, *s++ );
+    AddChar( ctx, '\0' );
+    return InternString( ctx );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      AtomName: the (preserved) name of "atom".  AtomCount: how many       */
+/*      atoms there are, so every atom is less than it.                      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC char *AtomName( CONTEXT *ctx, int atom )
+{
+    return LoadNames( ctx->strtab )[atom];
+}
+
+PUBLIC int AtomCount( CONTEXT *ctx )
+{
+    return ctx->strtab->AtomCount;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetAtomStats: copy the interning and memory statistics of the        */
+/*      string table of "ctx" (see ATOMSTATS) into "stats".                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void GetAtomStats( CONTEXT *ctx, ATOMSTATS *stats )
+{
+    *stats = ctx->strtab->Stats;
+    stats->Atoms = ctx->strtab->AtomCount;
+    stats->Slots = ctx->strtab->SlotCount;
+    GetArenaStats( ctx->strtab->Arena, &stats->Memory );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PRIVATE char *AddChunk( STRINGTABLE *st, int size )
+{
+    return ArenaAlloc( st->Arena, size );
+}
+
+/*  32-bit FNV-1a over the significant characters, so names that compare     */
+/*  equal hash equal.                                                        */
+
+PRIVATE unsigned long Hash( char *s )
+{
+    unsigned long h = FNV_OFFSET_BASIS;
+    int i;
+
+    for ( i = 0; i < SIGNIFICANT_LENGTH && *s != '\0'; i++, s++ )
+        h = ( ( h ^ (unsigned char) *s ) * FNV_PRIME ) & 0xffffffffUL;
+    return h;
+}
+
+/*  Double the slots (and the room for atoms, which is half of them), and    */
+/*  put every atom back in its slot from its cached hash.                    */
+
+PRIVATE void GrowAtoms( STRINGTABLE *st )
+{
+    int size = st->SlotCount ? 2 * st->SlotCount : INITIAL_SLOTS, atom, i;
+    int *slots;
+    char **names;
+
+    if ( NULL == ( slots = calloc( size, sizeof( int ) ) ) ||
+         NULL == ( names = malloc( ( size / 2 + 1 ) * sizeof( char * ) ) ) ||
+         NULL == ( st->Hashes = realloc( st->Hashes, ( size / 2 ) * sizeof( unsigned long ) ) ) )  {
+        fprintf( stderr, "Error, \"InternString\", malloc failure\n" );
+        exit( EXIT_FAILURE );
+    }
+    names[0] = st->Names != NULL ? (char *) ( st->Names - 1 ) : NULL;
+    if ( st->AtomCount > 0 )  memcpy( names + 1, st->Names, st->AtomCount * sizeof( char * ) );
+    PublishNames( st, names + 1 );
+    for ( atom = 0; atom < st->AtomCount; atom++ )  {
+        i = (int) ( st->Hashes[atom] & ( size - 1 ) );
+        while ( slots[i] != 0 )  i = ( i + 1 ) & ( size - 1 );
+        slots[i] = atom + 1;
+    }
+    free( st->Slots );
+    st->Slots = slots;
+    if ( st->SlotCount )  st->Stats.Resizes++;
+    st->SlotCount = size;
+}
+
+/*  Free the arrays of names the current one has outgrown.                   */
+
+PRIVATE void FreeOldNames( STRINGTABLE *st )
+{
+    char **old, **next;
+
+    if ( st->Names == NULL )  return;
+    for ( old = (char **) st->Names[-1]; old != NULL; old = next )  {
+        next = (char **) old[0];
+        free( old );
+    }
+    st->Names[-1] = NULL;
+}
+
+/*  The scanner's own reads of "Names" need no ordering, as only it writes   */
+/*  them; other threads go through LoadNames.                                */
+
+#if defined( __GNUC__ )
+
+PRIVATE char **LoadNames( STRINGTABLE *st )
+{
+    return __atomic_load_n( &st->Names, __ATOMIC_ACQUIRE );
+}
+
+PRIVATE void PublishNames( STRINGTABLE *st, char **names )
+{
+    __atomic_store_n( &st->Names, names, __ATOMIC_RELEASE );
+}
+
+#else
+
+PRIVATE char **LoadNames( STRINGTABLE *st )
+{
+    char **names;
+
+    pthread_mutex_lock( &st->Lock );
+    names = st->Names;
+    pthread_mutex_unlock( &st->Lock );
+    return names;
+}
+
+PRIVATE void PublishNames( STRINGTABLE *st, char **names )
+{
+    pthread_mutex_lock( &st->Lock );
+    st->Names = names;
+    pthread_mutex_unlock( &st->Lock );
+}
+
+#endif
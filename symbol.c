@@ -0,0 +1,335 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      symbol.c                                                             */
+/*                                                                           */
+/*      Symbol table for the CPL compiler.  Names are interned by the        */
+/*      string table (see strtab.h), so the table is an array indexed by     */
+/*      atom: each entry is the chain of symbols with that name, and a       */
+/*      lookup neither hashes nor compares strings.  The array is doubled    */
+/*      (or more) whenever a symbol's atom falls beyond its end.             */
+/*                                                                           */
+/*      New symbols go on the front of their chain, so the entry found by    */
+/*      "Probe" is always the one from the innermost scope.  Every symbol    */
+/*      is also on a list of all symbols, newest first, so leaving a scope   */
+/*      only visits that scope's symbols: they are at the front of the list, */
+/*      and each is at the front of its chain.  The symbols themselves come  */
+/*      from an arena (see arena.h) in the order they are entered, so        */
+/*      leaving a scope gives back its symbols' memory in one release.       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "symbol.h"
+#include "strtab.h"
+#include "arena.h"
+#include "context.h"
+#include "stats.h"
+
+#define  INITIAL_SIZE         1024      /* chains, one per atom              */
+#define  ARENA_BLOCK_SIZE     16384     /* symbols are carved out of these   */
+#define  MAX_DUMPED_SYMBOLS    100      /* DumpSymbols lists at most this    */
+#define  NAME_WIDTH             20      /* columns for a name in a dump      */
+
+struct symboltable  {
+    SYMBOL      **Chains;               /* symbols by atom, newest first     */
+    int         Size;                   /* atoms Chains has room for         */
+    int         Count;                  /* symbols in the table              */
+    SYMBOL      *Newest;                /* all symbols, through "older"      */
+    ARENA       *Arena;                 /* where they are kept               */
+    SYMBOLSTATS Stats;
+    char        TypeBuffer[6];          /* LookupType's unknown-type text    */
+};
+
+PRIVATE void Grow( SYMBOLTABLE *symtab, int atom );
+PRIVATE void BubbleSort( SYMBOL *table[], int n );
+PRIVATE void DisplaySymbol( SYMBOLTABLE *symtab, SYMBOL *sptr );
+PRIVATE char *LookupType( SYMBOLTABLE *symtab, int type );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      MakeSymbolTable / FreeSymbolTable: create an empty symbol table,     */
+/*      and release one along with any symbols still in it.                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC SYMBOLTABLE *MakeSymbolTable( void )
+{
+    SYMBOLTABLE *symtab;
+
+    if ( NULL == ( symtab = calloc( 1, sizeof( SYMBOLTABLE ) ) ) ||
+         NULL == ( symtab->Chains = calloc( INITIAL_SIZE, sizeof( SYMBOL * ) ) ) )  {
+        fprintf( stderr, "Fatal Error: MakeSymbolTable: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    symtab->Size = INITIAL_SIZE;
+    symtab->Arena = MakeArena( ARENA_BLOCK_SIZE );
+    return symtab;
+}
+
+PUBLIC void FreeSymbolTable( SYMBOLTABLE *symtab )
+{
+    if ( symtab != NULL )  {
+        FreeArena( symtab->Arena );
+        free( symtab->Chains );
+        free( symtab );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      ResetSymbolTable: empty a symbol table for another compilation,      */
+/*      keeping the memory it has already got to use again.                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void ResetSymbolTable( SYMBOLTABLE *symtab )
+{
+    ArenaRelease( symtab->Arena, NULL );
+    memset( symtab->Chains, 0, symtab->Size * sizeof( SYMBOL * ) );
+    symtab->Newest = NULL;
+    symtab->Count = 0;
+    memset( &symtab->Stats, 0, sizeof( symtab->Stats ) );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Probe: look up the name whose atom is "atom" in the symbol table,    */
+/*      returning the most recently entered SYMBOL of that name or NULL if   */
+/*      there is none.                                                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC SYMBOL *Probe( CONTEXT *ctx, int atom )
+{
+    SYMBOLTABLE *symtab = ctx->symtab;
+    SYMBOL *sptr = NULL;
+    int was;
+
+    EnterPhase( ctx, was, PHASE_SYMBOL );
+    symtab->Stats.Probes++;
+    if ( atom < 0 || atom >= symtab->Size || symtab->Chains[atom] == NULL )
+        symtab->Stats.Misses++;
+    else  sptr = symtab->Chains[atom];
+    LeavePhase( ctx, was );
+    return sptr;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      EnterSymbol: add a new SYMBOL for the name whose atom is "atom".     */
+/*      All fields other than the name are set to -1.  Returns NULL if no    */
+/*      memory is available.                                                 */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC SYMBOL *EnterSymbol( CONTEXT *ctx, int atom )
+{
+    SYMBOLTABLE *symtab = ctx->symtab;
+    SYMBOL *sptr;
+    int was;
+
+    EnterPhase( ctx, was, PHASE_SYMBOL );
+    symtab->Stats.Entered++;
+    if ( NULL != ( sptr = ArenaAlloc( symtab->Arena, sizeof( SYMBOL ) ) ) )  {
+        if ( atom >= symtab->Size )  Grow( symtab, atom );
+        sptr->s = AtomName( ctx, atom );
+        sptr->atom = atom;
+        sptr->scope = -1;
+        sptr->type = -1;
+        sptr->pcount = -1;
+        sptr->ptypes = -1;
+        sptr->address = -1;
+        sptr->next = symtab->Chains[atom];
+        symtab->Chains[atom] = sptr;
+        sptr->older = symtab->Newest;
+        symtab->Newest = sptr;
+        symtab->Count++;
+    }
+    LeavePhase( ctx, was );
+    return sptr;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      DumpSymbols: list (on stdout, sorted by name) the symbols at scope   */
+/*      "scope" or deeper.                                                   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void DumpSymbols( CONTEXT *ctx, int scope )
+{
+    SYMBOL *table[MAX_DUMPED_SYMBOLS], *sptr;
+    int i, count = 0;
+
+    for ( sptr = ctx->symtab->Newest;
+          sptr != NULL && sptr->scope >= scope && count < MAX_DUMPED_SYMBOLS; sptr = sptr->older )
+        table[count++] = sptr;
+    BubbleSort( table, count );
+
+    printf( "           name          " );
+    printf( "|  type  | scope |  addr  | pcount | ptypes |\n" );
+    printf( "-------------------------+--------+-------+--------+--------+--------+\n" );
+    if ( count > 0 )  {
+        for ( i = 0; i < count; i++ )  {
+            printf( "%3d: ", i + 1 );
+            DisplaySymbol( ctx->symtab, table[i] );
+            putchar( '\n' );
+        }
+    }
+    else  printf( "                         |        |       |        |        |        |\n" );
+    printf( "-------------------------+--------+-------+--------+--------+--------+\n\n" );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetSymbols: store pointers to (at most "max" of) the symbols now in  */
+/*      the table in "table", newest first, and return how many symbols      */
+/*      there are in all.  "GetSymbols( ctx, NULL, 0 )" just counts them.    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int GetSymbols( CONTEXT *ctx, SYMBOL *table[], int max )
+{
+    SYMBOL *sptr;
+    int count = 0;
+
+    for ( sptr = ctx->symtab->Newest; sptr != NULL && count < max; sptr = sptr->older )
+        table[count++] = sptr;
+    return ctx->symtab->Count;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      GetSymbolStats: copy the lookup and memory statistics of the         */
+/*      symbol table of "ctx" (see SYMBOLSTATS) into "stats".                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void GetSymbolStats( CONTEXT *ctx, SYMBOLSTATS *stats )
+{
+    SYMBOLTABLE *symtab = ctx->symtab;
+    SYMBOL *sptr;
+    int i, length;
+
+    *stats = symtab->Stats;
+    stats->Symbols = symtab->Count;
+    stats->Chains = symtab->Size;
+    GetArenaStats( symtab->Arena, &stats->Memory );
+    stats->LongestChain = 0;
+    for ( i = 0; i < symtab->Size; i++ )  {
+        for ( length = 0, sptr = symtab->Chains[i]; sptr != NULL; sptr = sptr->next )
+            length++;
+        if ( length > stats->LongestChain )  stats->LongestChain = length;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      RemoveSymbols: delete every symbol at scope "scope" or deeper.       */
+/*      Scopes are entered and left in nested order, so these are the        */
+/*      newest symbols, each at the front of its chain, and the last ones    */
+/*      taken from the arena; the work done is proportional to their number. */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void RemoveSymbols( CONTEXT *ctx, int scope )
+{
+    SYMBOLTABLE *symtab = ctx->symtab;
+    SYMBOL *dead, *oldest = NULL;
+    int was;
+
+    EnterPhase( ctx, was, PHASE_SYMBOL );
+    symtab->Stats.Removals++;
+    while ( ( dead = symtab->Newest ) != NULL && dead->scope >= scope )  {
+        symtab->Chains[dead->atom] = dead->next;
+        symtab->Newest = dead->older;
+        symtab->Count--;
+        symtab->Stats.Removed++;
+        oldest = dead;
+    }
+    if ( oldest != NULL )  ArenaRelease( symtab->Arena, oldest );
+    LeavePhase( ctx, was );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  Make room in Chains for "atom" and at least as many atoms again.         */
+
+PRIVATE void Grow( SYMBOLTABLE *symtab, int atom )
+{
+    SYMBOL **chains;
+    int size = 2 * symtab->Size;
+
+    if ( size <= atom )  size = 2 * ( atom + 1 );
+    if ( NULL == ( chains = realloc( symtab->Chains, size * sizeof( SYMBOL * ) ) ) )  {
+        fprintf( stderr, "Fatal Error: symbol table: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    memset( chains + symtab->Size, 0, ( size - symtab->Size ) * sizeof( SYMBOL * ) );
+    symtab->Chains = chains;
+    symtab->Size = size;
+    symtab->Stats.Resizes++;
+}
+
+PRIVATE void BubbleSort( SYMBOL *table[], int n )
+{
+    SYMBOL *tmp;
+    int i, swapped;
+
+    do  {
+        swapped = 0;
+        for ( i = 0; i < n - 1; i++ )  {
+            if ( strncmp( table[i]->s, table[i+1]->s, SIGNIFICANT_LENGTH ) > 0 )  {
+                tmp = table[i];
+                table[i] = table[i+1];
+                table[i+1] = tmp;
+                swapped = 1;
+            }
+        }
+    }  while ( swapped );
+}
+
+PRIVATE void DisplaySymbol( SYMBOLTABLE *symtab, SYMBOL *sptr )
+{
+    char *p = sptr->s;
+    int i;
+
+    for ( i = 0; i < NAME_WIDTH; i++ )  {
+        if ( *p == '\0' )  putchar( ' ' );
+        else  putchar( *p++ );
+    }
+    printf( "|  %s  |  %3d  |", LookupType( symtab, sptr->type ), sptr->scope );
+    if ( sptr->type != STYPE_PROGRAM )  printf( " %5d  ", sptr->address );
+    else  printf( "        " );
+    if ( sptr->pcount > 0 )  printf( "|  %4d  | 0x%04x |", sptr->pcount, sptr->ptypes );
+    else  {
+        printf( "|     " );
+        putchar( sptr->pcount == 0 ? '0' : ' ' );
+        printf( "  |        |" );
+    }
+}
+
+PRIVATE char *LookupType( SYMBOLTABLE *symtab, int type )
+{
+    switch ( type )  {
+        case STYPE_PROGRAM:    return "PROG";
+        case STYPE_VARIABLE:   return " VAR";
+        case STYPE_PROCEDURE:  return "PROC";
+        case STYPE_FUNCTION:   return "FUNC";
+        case STYPE_LOCALVAR:   return "LVAR";
+        case STYPE_VALUEPAR:   return "VALP";
+        case STYPE_REFPAR:     return "REFP";
+        default:
+            snprintf( symtab->TypeBuffer, sizeof( symtab->TypeBuffer ), "%4d", type );
+            return symtab->TypeBuffer;
+    }
+}
@@ -0,0 +1,211 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      tokarray.c                                                           */
+/*                                                                           */
+/*      The tokens ahead of the parser (see "tokarray.h").  Tokens are       */
+/*      scanned only when Advance or Peek needs them, so without a pipe      */
+/*      the scanner reads the source exactly as far as it did when the       */
+/*      parser called GetToken itself.  With a pipe they are taken from the  */
+/*      scanner thread as they are needed instead.                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "global.h"
+#include "tokarray.h"
+#include "context.h"
+
+PRIVATE long Scan( TOKENARRAY *ta, SET *set );
+PRIVATE void List( TOKENARRAY *ta );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      MakeTokenArray / FreeTokenArray: create an empty token array, and    */
+/*      release one.                                                         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC TOKENARRAY *MakeTokenArray( void )
+{
+    TOKENARRAY *ta;
+
+    if ( NULL == ( ta = calloc( 1, sizeof( TOKENARRAY ) ) ) )  {
+        fprintf( stderr, "Fatal Error: MakeTokenArray: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    return ta;
+}
+
+PUBLIC void FreeTokenArray( TOKENARRAY *ta )
+{
+    free( ta );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      StartTokens: empty the token array of "ctx" for a parse of the       */
+/*      source its character processor has been given (with its tab width    */
+/*      set) that will Peek at most "lookahead" tokens past the current one. */
+/*      If that is any, or "pipelined" is set, the listing is deferred if    */
+/*      the source allows; and if it is and "pipelined" is set, the scanner  */
+/*      thread is started (see "tokpipe.h").  Nothing is scanned until the   */
+/*      first Advance.                                                       */
+/*                                                                           */
+/*      StopTokens: stop the scanner thread, if there is one.  Tokens past   */
+/*      the current one are dropped, and nothing after it is listed.         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void StartTokens( CONTEXT *ctx, int lookahead, int pipelined )
+{
+    TOKENARRAY *ta = ctx->lookahead;
+
+    if ( lookahead < 0 || lookahead >= TOKARRAY_SIZE )  {
+        fprintf( stderr, "Fatal Error: StartTokens: lookahead %d is out of reach\n", lookahead );
+        exit( EXIT_FAILURE );
+    }
+    ta->ctx = ctx;
+    ta->First = ta->End = 0;
+    ta->Reach = lookahead;
+    ta->ListedLines = 0;
+    ta->ListedLine = -1;
+    ta->Pipe = NULL;
+    ta->Deferred = ( lookahead > 0 || pipelined ) && !LongLines( ctx );
+    if ( ta->Deferred )  {
+        DeferListing( ctx );
+        if ( pipelined )  ta->Pipe = StartTokenPipe( ctx );
+    }
+}
+
+PUBLIC void StopTokens( CONTEXT *ctx )
+{
+    TOKENARRAY *ta = ctx->lookahead;
+
+    StopTokenPipe( ta->Pipe );
+    ta->Pipe = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Advance: make the next token the current one (the first, the first   */
+/*      time), and list the source up to it.  At the end of the source the   */
+/*      current token is ENDOFINPUT, which Advance then leaves current.      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void Advance( TOKENARRAY *ta )
+{
+    if ( ta->End > ta->First )  ta->First++;
+    if ( ta->End == ta->First )  Scan( ta, NULL );
+    if ( ta->Deferred )  List( ta );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      SkipTo: advance until the current token is in "set" or is            */
+/*      ENDOFINPUT, and return how many tokens that skipped (0 if it         */
+/*      already was).  This is Advance in a loop, but the tokens already in  */
+/*      the array are passed over by their codes alone, each tested with a   */
+/*      single mask; without a pipe the rest are skipped by the scanner      */
+/*      itself (see "GetTokenIn"); and the listing is written once, up to    */
+/*      the token it stops at.                                               */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC long SkipTo( TOKENARRAY *ta, SET *set )
+{
+    unsigned long first = ta->First;
+    long scanned = 0;
+    int code = ta->Code[ta->First & TOKARRAY_MASK];
+
+    while ( !InSet( set, code ) && code != ENDOFINPUT )  {
+        if ( ++ta->First == ta->End )  scanned += Scan( ta, set );
+        code = ta->Code[ta->First & TOKARRAY_MASK];
+    }
+    if ( ta->Deferred )  List( ta );
+    return (long) ( ta->First - first ) + scanned;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Peek: the code of token "k", where token 0 is the current one,       */
+/*      scanning up to it if need be.  "k" may be no more than the           */
+/*      lookahead given to StartTokens.                                      */
+/*                                                                           */
+/*      PeekToken: the same, but the whole token, as GetToken returns it.    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC int Peek( TOKENARRAY *ta, int k )
+{
+    if ( k < 0 || k > ta->Reach )  {
+        fprintf( stderr, "Fatal Error: Peek: token %d is out of reach\n", k );
+        exit( EXIT_FAILURE );
+    }
+    while ( ta->End - ta->First <= (unsigned long) k )  Scan( ta, NULL );
+    return ta->Code[( ta->First + k ) & TOKARRAY_MASK];
+}
+
+PUBLIC TOKEN PeekToken( TOKENARRAY *ta, int k )
+{
+    TOKEN token;
+    int i;
+
+    token.code = Peek( ta, k );
+    i = (int) ( ( ta->First + k ) & TOKARRAY_MASK );
+    token.value = ta->Value[i];
+    token.pos = ta->Pos[i];
+    token.atom = ta->Atom[i];
+    token.s = token.atom != NO_ATOM ? AtomName( ta->ctx, token.atom ) : NULL;
+    return token;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  Scan one more token into the array.  There is room for it as long as     */
+/*  the lookahead is less than TOKARRAY_SIZE.  Given a "set", and no pipe,   */
+/*  the scanner skips to a token in it, and the number skipped is returned.  */
+
+PRIVATE long Scan( TOKENARRAY *ta, SET *set )
+{
+    TOKEN token;
+    LISTMARK mark;
+    long skipped = 0;
+    int i = (int) ( ta->End++ & TOKARRAY_MASK );
+
+    if ( ta->Pipe != NULL )  token = PipedToken( ta->Pipe, &mark );
+    else  {
+        if ( set == NULL )  token = GetToken( ta->ctx );
+        else  skipped = GetTokenIn( ta->ctx, set, &token );
+        if ( ta->Deferred )  MarkListing( ta->ctx, &mark );
+    }
+    ta->Code[i] = token.code;
+    ta->Value[i] = token.value;
+    ta->Pos[i] = token.pos;
+    ta->Atom[i] = token.atom;
+    if ( ta->Deferred )  {
+        ta->Lines[i] = mark.Lines;
+        ta->Line[i] = mark.Current;
+    }
+    return skipped;
+}
+
+/*  Write the deferred listing up to the current token, unless it has        */
+/*  been written that far already.                                           */
+
+PRIVATE void List( TOKENARRAY *ta )
+{
+    int i = (int) ( ta->First & TOKARRAY_MASK );
+    LISTMARK mark;
+
+    if ( ta->Lines[i] != ta->ListedLines || ta->Line[i] != ta->ListedLine )  {
+        mark.Lines = ta->ListedLines = ta->Lines[i];
+        mark.Current = ta->ListedLine = ta->Line[i];
+        ListTo( ta->ctx, &mark );
+    }
+}
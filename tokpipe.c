@@ -0,0 +1,208 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      tokpipe.c                                                            */
+/*                                                                           */
+/*      The scanner on a thread of its own, feeding the parser through a     */
+/*      single-producer, single-consumer ring of tokens (see "tokpipe.h").   */
+/*                                                                           */
+/*      The scanner fills entry Made % PIPE_TOKENS and then publishes Made   */
+/*      as "Tail"; the parser empties entry Taken % PIPE_TOKENS and then     */
+/*      publishes Taken as "Head".  Each side reads the other's index with   */
+/*      acquire and writes its own with release ordering, so an entry is     */
+/*      complete before the parser can see it and free before the scanner    */
+/*      can fill it again.  Each side also keeps the last index it read of   */
+/*      the other's, and only reads it again when that says the ring is      */
+/*      full (or empty).  A side that must wait polls PIPE_SPINS times and   */
+/*      then yields its processor between polls.                             */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#define  _POSIX_C_SOURCE  200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include "global.h"
+#include "tokpipe.h"
+#include "context.h"
+
+typedef struct  {
+    TOKEN    Token;
+    LISTMARK Mark;                  /* where the listing was after it        */
+}
+    PIPEENTRY;
+
+struct tokenpipe  {
+    CONTEXT   *ctx;
+    pthread_t Scanner;
+    int       Threaded;             /* the scanner thread was started        */
+    unsigned long Stop;             /* parser to scanner: stop now           */
+
+    unsigned long Head;             /* published by the parser, ...          */
+    unsigned long Taken;            /* ... its own copy, ...                 */
+    unsigned long TailSeen;         /* ... and what it last saw of "Tail"    */
+    int       Done;                 /* it has taken ENDOFINPUT, ...          */
+    PIPEENTRY Last;                 /* ... which was this                    */
+
+    PIPEENTRY Ring[PIPE_TOKENS];
+
+    unsigned long Tail;             /* published by the scanner, ...         */
+    unsigned long Made;             /* ... its own copy, ...                 */
+    unsigned long HeadSeen;         /* ... and what it last saw of "Head"    */
+#if !defined( __GNUC__ )
+    pthread_mutex_t Lock;           /* for Load and Store                    */
+#endif
+};
+
+PRIVATE void *Scan( void *arg );
+PRIVATE void Wait( int *spins );
+PRIVATE unsigned long Load( TOKENPIPE *pipe, unsigned long *index );
+PRIVATE void Store( TOKENPIPE *pipe, unsigned long *index, unsigned long value );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      StartTokenPipe: start scanning the source of "ctx", whose listing    */
+/*      has been deferred, on a thread of its own.  If the thread cannot be  */
+/*      started the pipe still works, scanning each token as it is taken.    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC TOKENPIPE *StartTokenPipe( CONTEXT *ctx )
+{
+    TOKENPIPE *pipe;
+
+    if ( NULL == ( pipe = calloc( 1, sizeof( TOKENPIPE ) ) ) )  {
+        fprintf( stderr, "Fatal Error: StartTokenPipe: out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    pipe->ctx = ctx;
+#if !defined( __GNUC__ )
+    pthread_mutex_init( &pipe->Lock, NULL );
+#endif
+    pipe->Threaded = 0 == pthread_create( &pipe->Scanner, NULL, Scan, pipe );
+    return pipe;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      PipedToken: the next token, as GetToken would have returned it,      */
+/*      and in "mark" where the listing was after it (see "MarkListing").    */
+/*      Once ENDOFINPUT has been taken it is returned again, as GetToken     */
+/*      does at the end of the source.                                       */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC TOKEN PipedToken( TOKENPIPE *pipe, LISTMARK *mark )
+{
+    int spins = 0;
+
+    if ( !pipe->Done && !pipe->Threaded )  {
+        pipe->Last.Token = GetToken( pipe->ctx );
+        MarkListing( pipe->ctx, &pipe->Last.Mark );
+    }
+    else if ( !pipe->Done )  {
+        while ( pipe->Taken == pipe->TailSeen )  {
+            pipe->TailSeen = Load( pipe, &pipe->Tail );
+            if ( pipe->Taken == pipe->TailSeen )  Wait( &spins );
+        }
+        pipe->Last = pipe->Ring[pipe->Taken & ( PIPE_TOKENS - 1 )];
+        Store( pipe, &pipe->Head, ++pipe->Taken );
+    }
+    pipe->Done = pipe->Last.Token.code == ENDOFINPUT;
+    *mark = pipe->Last.Mark;
+    return pipe->Last.Token;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      StopTokenPipe: stop the scanner thread, which may be waiting for     */
+/*      room in the ring, wait for it to finish and free the pipe.  "pipe"   */
+/*      may be NULL.                                                         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC void StopTokenPipe( TOKENPIPE *pipe )
+{
+    if ( pipe == NULL )  return;
+    if ( pipe->Threaded )  {
+        Store( pipe, &pipe->Stop, 1 );
+        pthread_join( pipe->Scanner, NULL );
+    }
+#if !defined( __GNUC__ )
+    pthread_mutex_destroy( &pipe->Lock );
+#endif
+    free( pipe );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  The scanner thread: fill the ring until ENDOFINPUT has gone into it,     */
+/*  or the parser asks it to stop while it is waiting for room.              */
+
+PRIVATE void *Scan( void *arg )
+{
+    TOKENPIPE *pipe = arg;
+    PIPEENTRY *entry;
+    int spins = 0;
+
+    do  {
+        while ( pipe->Made - pipe->HeadSeen == PIPE_TOKENS )  {
+            pipe->HeadSeen = Load( pipe, &pipe->Head );
+            if ( pipe->Made - pipe->HeadSeen < PIPE_TOKENS )  break;
+            if ( Load( pipe, &pipe->Stop ) )  return NULL;
+            Wait( &spins );
+        }
+        spins = 0;
+        entry = &pipe->Ring[pipe->Made & ( PIPE_TOKENS - 1 )];
+        entry->Token = GetToken( pipe->ctx );
+        MarkListing( pipe->ctx, &entry->Mark );
+        Store( pipe, &pipe->Tail, ++pipe->Made );
+    }  while ( entry->Token.code != ENDOFINPUT );
+    return NULL;
+}
+
+PRIVATE void Wait( int *spins )
+{
+    if ( ++*spins > PIPE_SPINS )  sched_yield();
+}
+
+#if defined( __GNUC__ )
+
+PRIVATE unsigned long Load( TOKENPIPE *pipe, unsigned long *index )
+{
+    return __atomic_load_n( index, __ATOMIC_ACQUIRE );
+}
+
+PRIVATE void Store( TOKENPIPE *pipe, unsigned long *index, unsigned long value )
+{
+    __atomic_store_n( index, value, __ATOMIC_RELEASE );
+}
+
+#else
+
+/*  Without the GNU atomic builtins an index is read and written under a     */
+/*  lock, which orders the entries just the same.                            */
+
+PRIVATE unsigned long Load( TOKENPIPE *pipe, unsigned long *index )
+{
+    unsigned long value;
+
+    pthread_mutex_lock( &pipe->Lock );
+    value = *index;
+    pthread_mutex_unlock( &pipe->Lock );
+    return value;
+}
+
+PRIVATE void Store( TOKENPIPE *pipe, unsigned long *index, unsigned long value )
+{
+    pthread_mutex_lock( &pipe->Lock );
+    *index = value;
+    pthread_mutex_unlock( &pipe->Lock );
+}
+
+#endif
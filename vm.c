@@ -0,0 +1,372 @@
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      vm.c                                                                 */
+/*                                                                           */
+/*      Interpreter for the CPL stack machine (see "vm.h").  The code table  */
+/*      is copied into a flat array when the VM is loaded, and every         */
+/*      operand that can be checked once (branch targets, absolute           */
+/*      addresses, display indices) is checked then, so the dispatch loop    */
+/*      only has to check the stack and computed addresses.                  */
+/*                                                                           */
+/*      With GNU C the loop uses threaded dispatch: each instruction holds   */
+/*      the address of the code that executes it, and each handler jumps     */
+/*      straight to the next one ("goto *").  Other compilers, and builds    */
+/*      with -ansi, get the equivalent switch.                               */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "code.h"
+#include "vm.h"
+#include "context.h"
+
+#if defined( __GNUC__ ) && !defined( __STRICT_ANSI__ )
+#define  VM_THREADED
+#endif
+
+#define  VM_LAST_OPCODE     I_STORESP
+
+typedef struct  {
+#ifdef  VM_THREADED
+    void *Handler;                      /* label of the code that runs it    */
+#endif
+    int  Opcode;
+    int  Operand;
+}
+    VMINSTRUCTION;
+
+struct vm  {
+    VMINSTRUCTION *Code;                /* CodeLength instructions + Halt    */
+    int   CodeLength;
+    int   *Memory;
+    long  MemorySize;
+    long  StackBase;                    /* first word above absolute data    */
+    int   Display[VM_DISPLAY_SIZE];
+    long  Count;                        /* instructions executed by RunVM    */
+    int   Threaded;                     /* Handler fields have been set      */
+    int   Dirty;                        /* memory must be cleared before run */
+};
+
+PRIVATE int CheckInstruction( VM *vm, int codeaddr );
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      LoadVM: build a VM with "memsize" words of memory for the program    */
+/*      in the code table of "ctx".  Returns NULL, after reporting why on    */
+/*      stderr, if there is no program or it could never run correctly.      */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC VM *LoadVM( CONTEXT *ctx, long memsize )
+{
+    VM *vm;
+    int i, length = CurrentCodeAddress( ctx );
+
+    if ( CodeGenerationKilled( ctx ) )  {
+        fprintf( stderr, "Error, LoadVM, no code was generated\n" );
+        return NULL;
+    }
+    if ( NULL == ( vm = calloc( 1, sizeof( VM ) ) ) ||
+         NULL == ( vm->Code = malloc( ( length + 1 ) * sizeof( VMINSTRUCTION ) ) ) )  {
+        fprintf( stderr, "Error, LoadVM, malloc failure\n" );
+        exit( EXIT_FAILURE );
+    }
+    vm->CodeLength = length;
+    vm->MemorySize = memsize;
+    for ( i = 0; i < length; i++ )  {
+        vm->Code[i].Opcode = GetInstruction( ctx, i, &vm->Code[i].Operand );
+        if ( ( vm->Code[i].Opcode == I_LOADA || vm->Code[i].Opcode == I_STOREA ) &&
+             vm->Code[i].Operand >= vm->StackBase )
+            vm->StackBase = vm->Code[i].Operand + 1L;
+    }
+    vm->Code[length].Opcode = I_HALT;
+    vm->Code[length].Operand = 0;
+
+    for ( i = 0; i < length; i++ )  {
+        if ( !CheckInstruction( vm, i ) )  {
+            FreeVM( vm );
+            return NULL;
+        }
+    }
+    if ( vm->StackBase >= memsize )  {
+        fprintf( stderr, "Error, LoadVM, %ld words of memory is too small\n", memsize );
+        FreeVM( vm );
+        return NULL;
+    }
+    if ( NULL == ( vm->Memory = calloc( memsize, sizeof( int ) ) ) )  {
+        fprintf( stderr, "Error, LoadVM, malloc failure\n" );
+        exit( EXIT_FAILURE );
+    }
+    return vm;
+}
+
+PUBLIC void FreeVM( VM *vm )
+{
+    if ( vm != NULL )  {
+        free( vm->Code );
+        free( vm->Memory );
+        free( vm );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      RunVM: run the program from address 0 with a cleared memory and      */
+/*      display, reading "Read" input from "input" and writing "Write"       */
+/*      output to "output".  Returns VM_HALTED, or the run time error that   */
+/*      stopped the machine.                                                 */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+#ifdef  VM_THREADED
+#define  OP(name)       L_##name
+#define  NEXT           do { count++;  goto *ip->Handler; } while ( 0 )
+#else
+#define  OP(name)       case I_##name
+#define  NEXT           goto dispatch
+#endif
+
+#define  NEED(n)        do { if ( sp - base < (n) )  goto underflow; } while ( 0 )
+#define  PUSH(v)        do { if ( sp >= top )  goto overflow;  mem[sp++] = (v); } while ( 0 )
+#define  POP(v)         do { if ( sp <= base )  goto underflow;  (v) = mem[--sp]; } while ( 0 )
+#define  CHECK(a)       do { if ( (a) < 0 || (a) >= top )  goto badaddress; } while ( 0 )
+#define  SETSP(a)       do { if ( (a) < base )  goto underflow; \
+                             else if ( (a) > top )  goto overflow; \
+                             else  sp = (a); } while ( 0 )
+#define  BRANCH(cond)   do { v = mem[--sp]; \
+                             ip = ( cond ) ? code + ip->Operand : ip + 1; } while ( 0 )
+
+PUBLIC int RunVM( VM *vm, FILE *input, FILE *output )
+{
+#ifdef  VM_THREADED
+    static void *Handlers[VM_LAST_OPCODE + 1] = {
+        &&L_ADD,  &&L_SUB,   &&L_MULT,   &&L_DIV,    &&L_NEG,    &&L_RET,
+        &&L_BSF,  &&L_RSF,   &&L_PUSHFP, &&L_READ,   &&L_WRITE,  &&L_HALT,
+        &&L_BR,   &&L_BGZ,   &&L_BG,     &&L_BLZ,    &&L_BL,     &&L_BZ,
+        &&L_BNZ,  &&L_CALL,  &&L_LDP,    &&L_RDP,    &&L_INC,    &&L_DEC,
+        &&L_LOADI, &&L_LOADA, &&L_LOADFP, &&L_LOADSP, &&L_STOREA, &&L_STOREFP,
+        &&L_STORESP
+    };
+    int i;
+#endif
+    VMINSTRUCTION *code = vm->Code, *ip = vm->Code;
+    int  *mem = vm->Memory, *display = vm->Display;
+    long base = vm->StackBase, top = vm->MemorySize;
+    long sp = base, fp = base, a, count = 0;
+    int  v, status;
+
+#ifdef  VM_THREADED
+    if ( !vm->Threaded )  {
+        for ( i = 0; i <= vm->CodeLength; i++ )
+            code[i].Handler = Handlers[code[i].Opcode];
+        vm->Threaded = 1;
+    }
+#endif
+    if ( vm->Dirty )  {
+        memset( mem, 0, top * sizeof( int ) );
+        memset( display, 0, sizeof( vm->Display ) );
+    }
+    vm->Dirty = 1;
+
+    NEXT;
+#ifndef  VM_THREADED
+dispatch:
+    count++;
+    switch ( ip->Opcode )  {
+#endif
+
+    OP( ADD ):
+        NEED( 2 );  sp--;
+        mem[sp-1] = (int) ( (unsigned) mem[sp-1] + (unsigned) mem[sp] );
+        ip++;  NEXT;
+    OP( SUB ):
+        NEED( 2 );  sp--;
+        mem[sp-1] = (int) ( (unsigned) mem[sp-1] - (unsigned) mem[sp] );
+        ip++;  NEXT;
+    OP( MULT ):
+        NEED( 2 );  sp--;
+        mem[sp-1] = (int) ( (unsigned) mem[sp-1] * (unsigned) mem[sp] );
+        ip++;  NEXT;
+    OP( DIV ):
+        NEED( 2 );  sp--;
+        if ( mem[sp] == 0 )  goto dividebyzero;
+        if ( mem[sp] == -1 )  mem[sp-1] = (int) ( 0u - (unsigned) mem[sp-1] );
+        else  mem[sp-1] /= mem[sp];
+        ip++;  NEXT;
+    OP( NEG ):
+        NEED( 1 );
+        mem[sp-1] = (int) ( 0u - (unsigned) mem[sp-1] );
+        ip++;  NEXT;
+    OP( RET ):
+        POP( v );
+        if ( v < 0 || v > vm->CodeLength )  goto badreturn;
+        ip = code + v;  NEXT;
+    OP( BSF ):
+        fp = sp;
+        ip++;  NEXT;
+    OP( RSF ):
+        SETSP( fp );  POP( v );  fp = v;
+        ip++;  NEXT;
+    OP( PUSHFP ):
+        PUSH( (int) fp );
+        ip++;  NEXT;
+    OP( READ ):
+        if ( 1 != fscanf( input, "%d", &v ) )  goto badinput;
+        PUSH( v );
+        ip++;  NEXT;
+    OP( WRITE ):
+        POP( v );
+        fprintf( output, "%d\n", v );
+        ip++;  NEXT;
+    OP( HALT ):
+        status = VM_HALTED;
+        goto done;
+
+    OP( BR ):
+        ip = code + ip->Operand;  NEXT;
+    OP( BGZ ):
+        NEED( 1 );  BRANCH( v >= 0 );  NEXT;
+    OP( BG ):
+        NEED( 1 );  BRANCH( v > 0 );  NEXT;
+    OP( BLZ ):
+        NEED( 1 );  BRANCH( v <= 0 );  NEXT;
+    OP( BL ):
+        NEED( 1 );  BRANCH( v < 0 );  NEXT;
+    OP( BZ ):
+        NEED( 1 );  BRANCH( v == 0 );  NEXT;
+    OP( BNZ ):
+        NEED( 1 );  BRANCH( v != 0 );  NEXT;
+    OP( CALL ):
+        PUSH( (int) ( ip - code ) + 1 );
+        ip = code + ip->Operand;  NEXT;
+    OP( LDP ):
+        PUSH( display[ip->Operand] );
+        display[ip->Operand] = (int) fp;
+        ip++;  NEXT;
+    OP( RDP ):
+        POP( display[ip->Operand] );
+        ip++;  NEXT;
+    OP( INC ):
+        a = sp + ip->Operand;  SETSP( a );
+        ip++;  NEXT;
+    OP( DEC ):
+        a = sp - ip->Operand;  SETSP( a );
+        ip++;  NEXT;
+
+    OP( LOADI ):
+        PUSH( ip->Operand );
+        ip++;  NEXT;
+    OP( LOADA ):
+        PUSH( mem[ip->Operand] );
+        ip++;  NEXT;
+    OP( LOADFP ):
+        a = fp + ip->Operand;  CHECK( a );
+        PUSH( mem[a] );
+        ip++;  NEXT;
+    OP( LOADSP ):
+        NEED( 1 );
+        a = mem[sp-1] + (long) ip->Operand;  CHECK( a );
+        mem[sp-1] = mem[a];
+        ip++;  NEXT;
+    OP( STOREA ):
+        POP( mem[ip->Operand] );
+        ip++;  NEXT;
+    OP( STOREFP ):
+        a = fp + ip->Operand;  CHECK( a );
+        POP( mem[a] );
+        ip++;  NEXT;
+    OP( STORESP ):
+        POP( v );
+        a = v + (long) ip->Operand;  CHECK( a );
+        POP( mem[a] );
+        ip++;  NEXT;
+
+#ifndef  VM_THREADED
+    default:
+        status = VM_HALTED;
+        goto done;
+    }
+#endif
+
+overflow:      status = VM_STACK_OVERFLOW;   goto done;
+underflow:     status = VM_STACK_UNDERFLOW;  goto done;
+badaddress:    status = VM_BAD_ADDRESS;      goto done;
+badreturn:     status = VM_BAD_RETURN;       goto done;
+dividebyzero:  status = VM_DIVIDE_BY_ZERO;   goto done;
+badinput:      status = VM_BAD_INPUT;        goto done;
+done:
+    fflush( output );
+    vm->Count = count;
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      VMInstructionCount: instructions executed by the last RunVM.         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC long VMInstructionCount( VM *vm )
+{
+    return vm->Count;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      VMErrorString: text for a result returned by RunVM.                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+PUBLIC char *VMErrorString( int status )
+{
+    switch ( status )  {
+        case VM_HALTED:           return "halted";
+        case VM_STACK_OVERFLOW:   return "stack overflow";
+        case VM_STACK_UNDERFLOW:  return "stack underflow";
+        case VM_BAD_ADDRESS:      return "memory address out of range";
+        case VM_BAD_RETURN:       return "return address outside the code";
+        case VM_DIVIDE_BY_ZERO:   return "division by zero";
+        case VM_BAD_INPUT:        return "no integer to Read";
+        default:                  return "unknown error";
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*      Private routines.                                                    */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+
+/*  Reject, at load time, anything the dispatch loop does not check itself.  */
+
+PRIVATE int CheckInstruction( VM *vm, int codeaddr )
+{
+    VMINSTRUCTION *inst = &vm->Code[codeaddr];
+
+    if ( inst->Opcode < 0 || inst->Opcode > VM_LAST_OPCODE )  {
+        fprintf( stderr, "Error, LoadVM, unknown opcode %d at %d\n",
+                 inst->Opcode, codeaddr );
+        return 0;
+    }
+    if ( inst->Opcode >= I_BR && inst->Opcode <= I_CALL &&
+         ( inst->Operand < 0 || inst->Operand > vm->CodeLength ) )  {
+        fprintf( stderr, "Error, LoadVM, branch to %d at %d is outside the code\n",
+                 inst->Operand, codeaddr );
+        return 0;
+    }
+    if ( ( inst->Opcode == I_LOADA || inst->Opcode == I_STOREA ) && inst->Operand < 0 )  {
+        fprintf( stderr, "Error, LoadVM, negative address %d at %d\n",
+                 inst->Operand, codeaddr );
+        return 0;
+    }
+    if ( ( inst->Opcode == I_LDP || inst->Opcode == I_RDP ) &&
+         ( inst->Operand < 0 || inst->Operand >= VM_DISPLAY_SIZE ) )  {
+        fprintf( stderr, "Error, LoadVM, display index %d at %d is out of range\n",
+                 inst->Operand, codeaddr );
+        return 0;
+    }
+    return 1;
+}